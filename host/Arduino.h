@@ -0,0 +1,112 @@
+/**
+ * Minimal Arduino core shim so the driver sources build on a Linux host.
+ *
+ * Time is virtual: delay()/delayMicroseconds() advance a counter instead of
+ * sleeping, so host runs are fast and deterministic.
+ *
+ * Simulated devices (host::Device) can be attached to a chip select pin.
+ * They then see the SPI traffic framed by that pin and may drive input
+ * pins such as nIRQ.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr)           (*(const uint8_t *)(addr))
+#define memcpy_P(dest, src, n)        memcpy((dest), (src), (n))
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+
+#define INPUT_PULLUP  2
+#define FALLING       2
+
+namespace host {
+  inline uint32_t clockMicros;
+
+  class Device {
+  public:
+    virtual ~Device() {}
+
+    virtual void select() {}
+    virtual uint8_t transfer(uint8_t x) { return 0xFF; }
+    virtual void release() {}
+
+    // Returns true and sets level if the device drives the pin
+    virtual bool readPin(int pin, int &level) { return false; }
+  };
+
+  enum { 
+    kMaxDevices = 8,
+    kMaxPins    = 64
+  };
+
+  struct Attachment {
+    Device  *device;
+    int     pinCS;
+  };
+
+  inline Attachment devices[kMaxDevices];
+  inline uint8_t    deviceCount;
+  inline Device     *selected;
+  inline void       (*isrs[kMaxPins])();
+
+  inline void attach(Device *device, int pinCS) {
+    if (deviceCount < kMaxDevices) {
+      devices[deviceCount].device = device;
+      devices[deviceCount].pinCS = pinCS;
+      deviceCount++;
+    }
+  }
+
+  inline void detachAll() {
+    deviceCount = 0;
+    selected = 0;
+  }
+
+  // Called by a device to fire the ISR attached to one of its output pins
+  inline void raiseInterrupt(int pin) {
+    if (pin >= 0 && pin < kMaxPins && isrs[pin]) isrs[pin]();
+  }
+}
+
+inline uint32_t micros() { return host::clockMicros; }
+inline uint32_t millis() { return host::clockMicros / 1000; }
+
+inline void delayMicroseconds(unsigned int us) { host::clockMicros += us; }
+inline void delay(unsigned long ms) { host::clockMicros += ms * 1000; }
+
+inline void pinMode(int pin, int mode) {}
+
+inline void digitalWrite(int pin, int value) {
+  for (uint8_t idx = 0; idx < host::deviceCount; idx++) {
+    host::Attachment &attachment = host::devices[idx];
+    if (attachment.pinCS != pin) continue;
+    if (value == LOW) {
+      host::selected = attachment.device;
+      attachment.device->select();
+    }
+    else if (host::selected == attachment.device) {
+      attachment.device->release();
+      host::selected = 0;
+    }
+  }
+}
+
+inline int digitalRead(int pin) {
+  int level;
+  for (uint8_t idx = 0; idx < host::deviceCount; idx++) {
+    if (host::devices[idx].device->readPin(pin, level)) return level;
+  }
+  return HIGH;
+}
+
+inline int  digitalPinToInterrupt(int pin) { return (pin < host::kMaxPins) ? pin : -1; }
+inline void attachInterrupt(int irq, void (*isr)(), int mode) { host::isrs[irq] = isr; }
+inline void noInterrupts() {}
+inline void interrupts() {}
@@ -0,0 +1,49 @@
+/**
+ * Arduino SPI library shim for host builds. Bytes go to the host::Device
+ * currently selected by its CS pin; with no device selected every byte is
+ * answered with 0xFF (a radio that is always clear to send). The number of
+ * library calls and bytes moved is counted.
+ */
+#pragma once
+
+#include "Arduino.h"
+
+#define MSBFIRST  1
+#define SPI_MODE0 0
+
+struct SPISettings {
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {}
+};
+
+class SPIClass {
+public:
+  void begin() {}
+
+  void beginTransaction(SPISettings settings) { transactions++; }
+  void endTransaction() {}
+
+  uint8_t transfer(uint8_t x) {
+    calls++;
+    bytes++;
+    return host::selected ? host::selected->transfer(x) : 0xFF;
+  }
+
+  void transfer(void *buf, size_t count) {
+    calls++;
+    bytes += count;
+    uint8_t *p = (uint8_t *)buf;
+    for (size_t idx = 0; idx < count; idx++) {
+      p[idx] = host::selected ? host::selected->transfer(p[idx]) : 0xFF;
+    }
+  }
+
+  void resetCounters() {
+    calls = bytes = transactions = 0;
+  }
+
+  uint32_t calls;
+  uint32_t bytes;
+  uint32_t transactions;
+};
+
+inline SPIClass SPI;
@@ -0,0 +1,117 @@
+/**
+ * Message aggregation against the simulated radio with the Si4060 WDS
+ * profile and the sketch's TX settings (10 byte preamble, 2 byte sync) at
+ * 10 kbps. A sensor produces a 7 byte message every 50 ms for 20 s; it is
+ * sent alone, as the sketch does, or through Si446xAggregator with several
+ * frame size and latency bounds. Sent frames are captured from the model
+ * and unpacked to check every message arrives in order. Efficiency is
+ * message bits over on-air bits, from the framing read back from the radio
+ * and, for comparison, with a 16 bit CRC added.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_aggregate.cpp si4x6x.cpp si4x6x_irq.cpp si4x6x_stream.cpp si4x6x_aggregate.cpp -o bench_aggregate
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+#include "si4x6x_stream.h"
+#include "si4x6x_aggregate.h"
+#include "si446x_sim.h"
+#include "radio_config_Si4060.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+static const int kPinCS   = 10;
+static const int kPinIRQ  = 2;
+
+static const uint8_t  kMessageLength = 7;
+static const uint32_t kInterval      = 50;      // ms between messages
+static const uint32_t kDuration      = 20000;   // ms
+
+static Si446xSim  sim(kPinCS, kPinIRQ);
+static Si446x     radio(kPinCS, 26000000UL);
+static Si446xIRQ  irq(radio, kPinIRQ);
+
+static void run(uint8_t maxFrame, uint16_t maxDelay, const Si446xAggregator::Overhead &overhead)
+{
+  static uint8_t storage[512];
+  Si446xRing ring(storage, sizeof(storage));
+  Si446xTXQueue queue(radio, ring, 0, &irq);
+  irq.onPacketHandler(Si446xTXQueue::onEvent, &queue);
+  sim.resetCounters();
+  sim.captureTX(true);
+
+  uint8_t buffer[64];
+  Si446xAggregator aggregator(queue, buffer, maxFrame, maxDelay);
+
+  uint32_t start = millis();
+  uint32_t sent = 0, received = 0, errors = 0;
+  uint8_t next = 0;
+  while (millis() - start < kDuration || aggregator.getPending() > 0 || !queue.isIdle()) {
+    if (millis() - start < kDuration && millis() - start >= sent * kInterval) {
+      uint8_t message[kMessageLength];
+      for (uint8_t idx = 0; idx < kMessageLength; idx++) message[idx] = sent + idx;
+      if (aggregator.add(message, kMessageLength)) sent++;
+    }
+    aggregator.service();
+    if (millis() - start >= kDuration) aggregator.flush();
+
+    delay(1);
+    sim.update();
+    irq.service();
+
+    std::vector<uint8_t> frame;
+    while (sim.takeSent(frame)) {
+      Si446xAggregator::Message messages[16];
+      uint8_t count = Si446xAggregator::unpack(frame.data() + 1, frame[0], messages, 16);
+      for (uint8_t idx = 0; idx < count; idx++) {
+        const uint8_t *data = frame.data() + 1 + messages[idx].offset;
+        if (messages[idx].length != kMessageLength || data[0] != next) errors++;
+        next = data[0] + 1;
+        received++;
+      }
+    }
+  }
+
+  const Si446xAggregator::Counters &counters = aggregator.getCounters();
+  Si446xAggregator::Overhead withCRC = overhead;
+  withCRC.crcBits = 16;
+
+  uint32_t framing = overhead.preambleBits + overhead.syncBits + overhead.crcBits;
+  double airtime = (counters.frames * framing + counters.frameBytes * 8) / 10000.0;
+
+  if (maxDelay == 0) printf("%-7s %4s %6s", "single", "-", "-");
+  else printf("%-7s %4u %6u", "packed", maxFrame, maxDelay);
+  printf(" %7lu %6lu %6lu %7.1f %7.1f %8.1f%% %5.1f%% %8lu\n", (unsigned long)sent, (unsigned long)received,
+    (unsigned long)errors, (double)counters.frames * 1000 / kDuration, airtime * 100000 / kDuration,
+    aggregator.getEfficiency(overhead) * 100, aggregator.getEfficiency(withCRC) * 100,
+    (unsigned long)counters.waitMax);
+}
+
+int main()
+{
+  sim.attach();
+  irq.begin();
+
+  radio.configure_P(radioConfig);
+  sim.setDataRate(10000);
+  radio.setPreambleLength(0x0A);
+  radio.setPreambleConfig(0x31);
+  radio.setSync(0x01, 0xB42B);
+  irq.enable(Si446x::kIntPacketSent | Si446x::kIntTXFIFOAlmostEmpty);
+
+  Si446xAggregator::Overhead overhead;
+  Si446xAggregator::readOverhead(radio, overhead);
+
+  printf("%u byte messages every %lu ms for %lu s at 10 kbps\n", kMessageLength, (unsigned long)kInterval,
+    (unsigned long)(kDuration / 1000));
+  printf("Framing from the radio: %u bit preamble, %u bit sync, %u bit CRC\n\n",
+    overhead.preambleBits, overhead.syncBits, overhead.crcBits);
+  printf("mode    size  delay    sent   recv errors frame/s  air %%  efficiency +CRC16  wait ms\n");
+  run(kMessageLength + 2, 0, overhead);
+  run(32, 200, overhead);
+  run(64, 200, overhead);
+  run(64, 500, overhead);
+  run(64, 2000, overhead);
+  return 0;
+}
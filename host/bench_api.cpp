@@ -0,0 +1,175 @@
+/**
+ * Cost of every Si446x API path against the simulated radio: virtual time
+ * spent in the call, SPI bytes, CS frames and bus transactions. Each call
+ * runs once with a radio that answers at once and once with typical CTS
+ * busy times (Si446xSim::useTypicalTimes()), starting with CTS high; the
+ * difference is time the driver spent waiting on the radio. A command
+ * with no reply returns once it is sent, so its busy time lands on the
+ * next call (POWER_UP's on configure_P). Bus time is not modelled; the
+ * byte count is what a slow SPI clock adds on top.
+ *
+ * Before the table, PART_INFO is read from a model of each part the
+ * sketch tells apart.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_api.cpp si4x6x.cpp -o bench_api
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si446x_sim.h"
+#include "radio_config_Si4060.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+static const int kPinCS = 10;
+
+static Si446xSim  sim(kPinCS);
+static Si446x     radio(kPinCS, 26000000UL);
+
+static uint8_t packet[16];
+
+enum Path {
+  kPowerUp, kConfigure, kPartInfo, kFrequency, kPreamble, kSync, kProperties,
+  kGPIO, kTXSpace, kWriteTX, kStartTX, kFlushTX, kStartRX, kAvailableRX,
+  kReadRX, kPacketLength, kIntStatus, kModemStatus, kChipStatus, kFRR,
+  kState, kChangeState, kTemperature, kStartTXAsync, kPaths
+};
+
+static const char *const kNames[kPaths] = {
+  "powerUpXTAL", "configure_P", "getPartInfo", "setFrequency", "setPreambleLength",
+  "setSync", "getProperties(4)", "configureGPIO", "getTXSpace", "writeTX(16)",
+  "startTX", "flushTX", "startRX", "getAvailableRX", "readRX(16)",
+  "getPacketLength", "getIntStatus", "getModemStatus", "getChipStatus", "readFRR(4)",
+  "getState", "changeState", "getTemperature", "startTXAsync+wait"
+};
+
+// Puts the radio in the state the call expects; not measured
+static void prepare(Path path)
+{
+  switch (path) {
+    case kReadRX:
+      radio.startRX(0, sizeof(packet));
+      sim.receive(packet, sizeof(packet));
+      delay(100);
+      sim.update();
+      break;
+    case kStartTX:
+    case kStartTXAsync:
+      radio.writeTX(packet, sizeof(packet));
+      break;
+    default:
+      break;
+  }
+}
+
+static void call(Path path)
+{
+  uint8_t values[4];
+  Si446x::IRQStatus irqStatus;
+  Si446x::ModemStatus modemStatus;
+  Si446x::ChipStatus chipStatus;
+  Si446x::PartInfo info;
+
+  switch (path) {
+    case kPowerUp:      radio.powerUpXTAL(); break;
+    case kConfigure:    radio.configure_P(radioConfig); break;
+    case kPartInfo:     radio.getPartInfo(info); break;
+    case kFrequency:    radio.setFrequency(434250000UL); break;
+    case kPreamble:     radio.setPreambleLength(0x0A); break;
+    case kSync:         radio.setSync(0x01, 0x2DD4); break;
+    case kProperties:   radio.getProperties(0x1000, values, 4); break;
+    case kGPIO:         radio.configureGPIO(0, 0, 0x21, 0x20, 0, 0, 0); break;
+    case kTXSpace:      radio.getTXSpace(); break;
+    case kWriteTX:      radio.writeTX(packet, sizeof(packet)); break;
+    case kStartTX:      radio.startTX(0, sizeof(packet)); break;
+    case kFlushTX:      radio.flushTX(); break;
+    case kStartRX:      radio.startRX(0, sizeof(packet)); break;
+    case kAvailableRX:  radio.getAvailableRX(); break;
+    case kReadRX:       radio.readRX(packet, sizeof(packet)); break;
+    case kPacketLength: radio.getPacketLength(); break;
+    case kIntStatus:    radio.getIntStatus(irqStatus); break;
+    case kModemStatus:  radio.getModemStatus(modemStatus); break;
+    case kChipStatus:   radio.getChipStatus(chipStatus); break;
+    case kFRR:          radio.readFRR(values, 4); break;
+    case kState:        radio.getState(); break;
+    case kChangeState:  radio.changeState(Si446x::kStateReady); break;
+    case kTemperature:  radio.getTemperature(); break;
+    case kStartTXAsync:
+      radio.startTXAsync(0, sizeof(packet), Si446x::kStateNoChange);
+      radio.waitForIdle();
+      break;
+    default:
+      break;
+  }
+}
+
+struct Cost {
+  uint32_t  micros;
+  uint32_t  bytes;
+  uint32_t  frames;
+  uint32_t  transactions;
+};
+
+static Cost measure(Path path)
+{
+  prepare(path);
+  delay(50);      // let CTS come back and any packet finish
+  sim.update();
+
+  Cost cost;
+  uint32_t start = micros();
+  uint32_t bytes = SPI.bytes;
+  uint32_t frames = radio.getBusCounters().frames;
+  uint32_t transactions = SPI.transactions;
+  call(path);
+  cost.micros = micros() - start;
+  cost.bytes = SPI.bytes - bytes;
+  cost.frames = radio.getBusCounters().frames - frames;
+  cost.transactions = SPI.transactions - transactions;
+
+  // Back to READY with empty FIFOs for the next path
+  delay(50);
+  sim.update();
+  radio.changeState(Si446x::kStateReady);
+  radio.flushTX();
+  radio.flushRX();
+  return cost;
+}
+
+static void detect(uint16_t part)
+{
+  Si446xSim chip(kPinCS);
+  host::detachAll();
+  chip.setPart(part);
+  chip.attach();
+
+  Si446x::PartInfo info;
+  radio.getPartInfo(info);
+  printf("Model of %04X: PART_INFO reads %04X rev %02X, the sketch runs %s\n", part, info.getPartID(),
+    info.getRevision(), (info.getPartID() == 0x4362) ? "RX" : (info.getPartID() == 0x4060) ? "TX" : "nothing");
+}
+
+int main()
+{
+  for (uint8_t idx = 0; idx < sizeof(packet); idx++) packet[idx] = idx;
+
+  detect(0x4060);
+  detect(0x4362);
+  host::detachAll();
+  sim.attach();
+
+  Cost costs[2][kPaths];
+  for (uint8_t typical = 0; typical < 2; typical++) {
+    sim.useTypicalTimes(typical);
+    for (uint8_t path = 0; path < kPaths; path++) costs[typical][path] = measure((Path)path);
+  }
+
+  printf("\n%-18s %9s %9s %6s %6s %4s\n", "call", "instant", "typical", "bytes", "frames", "txn");
+  for (uint8_t path = 0; path < kPaths; path++) {
+    printf("%-18s %7lu us %7lu us %6lu %6lu %4lu\n", kNames[path], (unsigned long)costs[0][path].micros,
+      (unsigned long)costs[1][path].micros, (unsigned long)costs[1][path].bytes,
+      (unsigned long)costs[1][path].frames, (unsigned long)costs[1][path].transactions);
+  }
+  printf("\nUnknown commands seen by the model: %lu\n", (unsigned long)sim.getCounters().commandErrors);
+  return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * Main loop stalls with blocking and asynchronous radio commands. Every
+ * 5 ms the loop hops to another frequency, checks the interrupt status and
+ * sends a 16 byte packet, while it also has other work due every 20 us.
+ * The simulated radio keeps CTS low for a while after each command. The
+ * blocking calls hold the loop for every CTS wait; the async calls queue
+ * the commands and poll() sends them as CTS comes back. Reports the longest
+ * gap between two work ticks and the work done.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_async.cpp si4x6x.cpp -o bench_async
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si446x_sim.h"
+
+static const int kPinCS = 10;
+
+static const uint16_t kHops       = 200;
+static const uint32_t kHopPeriod  = 5000;   // microseconds
+static const uint32_t kWorkPeriod = 20;
+
+static Si446xSim  sim(kPinCS);
+static Si446x     radio(kPinCS, 26000000UL);
+
+struct Work {
+  uint32_t  last;
+  uint32_t  ticks;
+  uint32_t  maxGap;
+};
+
+static void work(Work &state)
+{
+  uint32_t gap = micros() - state.last;
+  if (gap > state.maxGap) state.maxGap = gap;
+  state.last = micros();
+  state.ticks++;
+}
+
+static void onSent(Si446x::CommandHandle handle, bool success, void *context)
+{
+  if (success) (*(uint16_t *)context)++;
+}
+
+static void run(bool async, uint32_t commandTime)
+{
+  sim.setCommandTime(commandTime);
+  radio.powerUpXTAL();
+  sim.setDataRate(100000);
+  delay(1);       // POWER_UP holds CTS low too
+
+  uint8_t data[16];
+  for (uint8_t idx = 0; idx < sizeof(data); idx++) data[idx] = idx;
+
+  Si446x::IRQStatus status;
+  uint16_t started = 0;
+  Work state = { micros(), 0, 0 };
+  uint32_t start = micros();
+
+  for (uint16_t hop = 0; hop < kHops; hop++) {
+    uint32_t freq = 433050000UL + (hop % 8) * 25000UL;
+    if (async) {
+      radio.setFrequencyAsync(freq);
+      radio.getIntStatusAsync(status);
+      radio.writeTXAsync(data, sizeof(data));
+      radio.startTXAsync(0, sizeof(data), Si446x::kStateReady, onSent, &started);
+    }
+    else {
+      radio.setFrequency(freq);
+      radio.getIntStatus(status);
+      radio.writeTX(data, sizeof(data));
+      radio.startTX(0, sizeof(data), Si446x::kStateReady);
+      started++;
+    }
+
+    while (micros() - start < (hop + 1) * kHopPeriod) {
+      work(state);
+      radio.poll();
+      delayMicroseconds(kWorkPeriod);
+      sim.update();
+    }
+  }
+  radio.waitForIdle();
+
+  printf("%-9s %8lu %8u %8lu %10lu %8lu %6lu\n", async ? "async" : "blocking",
+    (unsigned long)commandTime, started, (unsigned long)sim.getCounters().packetsSent,
+    (unsigned long)state.ticks, (unsigned long)state.maxGap,
+    (unsigned long)sim.getCounters().busyCommands);
+}
+
+int main()
+{
+  sim.attach();
+
+  printf("%u hops, %lu us apart, 16 byte packets at 100 kbps\n\n", kHops, (unsigned long)kHopPeriod);
+  printf("calls     CTS low  started     sent work ticks  max gap  busy\n");
+  static const uint32_t commandTimes[] = { 20, 100, 500 };
+  for (uint8_t idx = 0; idx < 3; idx++) {
+    run(false, commandTimes[idx]);
+    run(true, commandTimes[idx]);
+  }
+  return 0;
+}
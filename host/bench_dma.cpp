@@ -0,0 +1,146 @@
+/**
+ * Overlap of FIFO reads with packet processing, in wall clock time. A
+ * stub radio streams a counting pattern out of READ_RX_FIFO; each 64 byte
+ * packet is read and then "decoded" (a CRC pass repeated to take roughly
+ * as long as the read). The blocking loop reads, then decodes. The
+ * pipelined loop starts readRXAsync() into the other buffer, decodes the
+ * previous packet while ThreadSPITransport moves the bytes on its worker
+ * thread, and polls for completion. Every packet is checked.
+ *
+ *   g++ -std=c++17 -O2 -pthread -Ihost -I. host/bench_dma.cpp si4x6x.cpp -o bench_dma
+ */
+#include <stdio.h>
+
+#include <chrono>
+
+#include "si4x6x.h"
+#include "spi_thread_transport.h"
+
+static const int kPinCS = 10;
+
+static const uint16_t kPackets      = 400;
+static const uint8_t  kPacketLength = 64;
+static const uint32_t kClock        = 1000000UL;
+
+/**
+ * Answers READ_RX_FIFO with consecutive byte values, nothing else.
+ */
+class PatternFIFO : public host::Device {
+public:
+  PatternFIFO() : _next(0), _first(true), _command(0) {}
+
+  void select() { _first = true; }
+
+  uint8_t transfer(uint8_t x) {
+    if (_first) {
+      _first = false;
+      _command = x;
+      return 0xFF;
+    }
+    return (_command == 0x77) ? _next++ : 0xFF;
+  }
+
+  void rewind() { _next = 0; }
+
+private:
+  uint8_t _next;
+  bool    _first;
+  uint8_t _command;
+};
+
+static PatternFIFO        fifo;
+static ThreadSPITransport transport(kClock);
+static Si446x             radio(kPinCS, 26000000UL, &transport);
+
+static uint16_t crc16(const uint8_t *data, uint8_t length, uint16_t crc)
+{
+  for (uint8_t idx = 0; idx < length; idx++) {
+    crc ^= data[idx] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+static uint32_t decodeRounds;
+static volatile uint16_t sink;
+
+static bool decode(const uint8_t *packet, uint8_t &expected)
+{
+  uint16_t crc = 0xFFFF;
+  for (uint32_t round = 0; round < decodeRounds; round++) crc = crc16(packet, kPacketLength, crc);
+  sink = crc;
+
+  bool ok = true;
+  for (uint8_t idx = 0; idx < kPacketLength; idx++) {
+    if (packet[idx] != expected++) ok = false;
+  }
+  return ok;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void runBlocking()
+{
+  uint8_t packet[kPacketLength];
+  uint8_t expected = 0;
+  uint32_t errors = 0;
+  fifo.rewind();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint16_t idx = 0; idx < kPackets; idx++) {
+    radio.readRX(packet, kPacketLength);
+    if (!decode(packet, expected)) errors++;
+  }
+  double elapsed = seconds(start);
+  printf("%-10s %8u %7lu %10.1f\n", "blocking", kPackets, (unsigned long)errors, elapsed * 1e6 / kPackets);
+}
+
+static void runPipelined()
+{
+  uint8_t packets[2][kPacketLength];
+  uint8_t expected = 0;
+  uint32_t errors = 0;
+  fifo.rewind();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  Si446x::CommandHandle handle = radio.readRXAsync(packets[0], kPacketLength);
+  for (uint16_t idx = 0; idx < kPackets; idx++) {
+    while (radio.getCommandStatus(handle) != Si446x::kCommandDone) radio.poll();
+
+    uint8_t *ready = packets[idx & 1];
+    if (idx + 1 < kPackets) handle = radio.readRXAsync(packets[(idx + 1) & 1], kPacketLength);
+    radio.poll();
+    if (!decode(ready, expected)) errors++;
+  }
+  double elapsed = seconds(start);
+  printf("%-10s %8u %7lu %10.1f\n", "pipelined", kPackets, (unsigned long)errors, elapsed * 1e6 / kPackets);
+}
+
+int main()
+{
+  host::attach(&fifo, kPinCS);
+
+  // Size the decode step to about the bus time of one packet
+  uint8_t packet[kPacketLength] = { 0 };
+  uint32_t busTime = kPacketLength * 8000000ULL / kClock;
+  decodeRounds = 1;
+  for (;;) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint8_t expected = 0;
+    for (uint8_t idx = 0; idx < 20; idx++) decode(packet, expected);
+    if (seconds(start) * 1e6 / 20 >= busTime || decodeRounds > 100000) break;
+    decodeRounds *= 2;
+  }
+
+  printf("%u byte packets, SPI at %lu kHz (%lu us per packet), decode about as long\n\n",
+    kPacketLength, (unsigned long)(kClock / 1000), (unsigned long)busTime);
+  printf("loop        packets  errors  us/packet\n");
+  runBlocking();
+  runPipelined();
+  return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * Si446xFEC on the host: a self check with the largest correctable number
+ * of byte errors in every codeword, encode/decode throughput, and the
+ * residual packet error rate of 32 byte payloads sent over a channel with
+ * random bit errors, and with the same bit error rate in bursts of 2 to
+ * 16 bits. A packet counts as lost if it fails to decode or decodes to
+ * the wrong payload; without FEC any bit error loses it (the radio's CRC).
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_fec.cpp si4x6x.cpp si4x6x_fec.cpp -o bench_fec
+ */
+#include <stdio.h>
+
+#include <chrono>
+
+#include "si4x6x_fec.h"
+
+static const uint8_t  kPayload = 32;
+static const uint32_t kPackets = 20000;
+
+static uint32_t rngState = 1;
+
+static uint32_t rng()
+{
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+static double uniform()
+{
+  return (rng() >> 8) / 16777216.0;
+}
+
+static void fill(uint8_t *data, uint8_t length)
+{
+  for (uint8_t idx = 0; idx < length; idx++) data[idx] = rng();
+}
+
+static bool selfCheck(uint8_t parity, uint8_t depth)
+{
+  Si446xFEC fec(parity, depth);
+  uint8_t data[64], frame[255], out[255];
+  for (uint32_t round = 0; round < 2000; round++) {
+    uint8_t length = 1 + rng() % 40;
+    fill(data, length);
+    fec.encode(data, length, frame);
+    uint8_t frameLength = fec.getFrameLength(length);
+
+    // parity / 2 distinct byte errors in each codeword
+    for (uint8_t codeword = 0; codeword < depth; codeword++) {
+      uint8_t symbols = (frameLength - codeword + depth - 1) / depth;
+      uint8_t hit[255] = { 0 };
+      for (uint8_t count = 0; count < parity / 2 && count < symbols; ) {
+        uint8_t pos = rng() % symbols;
+        if (hit[pos]) continue;
+        hit[pos] = 1;
+        frame[pos * depth + codeword] ^= 1 + rng() % 255;
+        count++;
+      }
+    }
+
+    if (fec.decode(frame, frameLength, out) != length || memcmp(out, data, length) != 0) return false;
+  }
+  return true;
+}
+
+static void throughput(uint8_t parity, uint8_t depth)
+{
+  Si446xFEC fec(parity, depth);
+  uint8_t data[kPayload], frame[64], work[64];
+  fill(data, kPayload);
+  fec.encode(data, kPayload, frame);
+  uint8_t frameLength = fec.getFrameLength(kPayload);
+  const uint32_t rounds = 20000;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) fec.encode(data, kPayload, frame);
+  double encode = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    memcpy(work, frame, frameLength);
+    fec.decode(work, frameLength, work);
+  }
+  double clean = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    memcpy(work, frame, frameLength);
+    for (uint8_t err = 0; err < depth * parity / 2; err++) work[err * 2 % frameLength] ^= 0x5A;
+    fec.decode(work, frameLength, work);
+  }
+  double noisy = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("RS %2u x%u  %8.1f %10.1f %10.1f\n", parity, depth,
+    encode * 1e6 / rounds, clean * 1e6 / rounds, noisy * 1e6 / rounds);
+}
+
+/**
+ * Flips bits at the given rate, either independently or in bursts whose
+ * length is uniform in 2..16 bits, each bit of a burst flipped with
+ * probability 1/2.
+ */
+static void corrupt(uint8_t *frame, uint8_t length, double ber, bool bursty)
+{
+  uint16_t bits = length * 8;
+  if (!bursty) {
+    for (uint16_t bit = 0; bit < bits; bit++) {
+      if (uniform() < ber) frame[bit / 8] ^= 0x80 >> (bit % 8);
+    }
+    return;
+  }
+  double burstRate = ber / 4.5;   // bursts of 9 bits on average, half of them flipped
+  for (uint16_t bit = 0; bit < bits; bit++) {
+    if (uniform() >= burstRate) continue;
+    uint8_t burst = 2 + rng() % 15;
+    for (uint8_t pos = 0; pos < burst && bit + pos < bits; pos++) {
+      if (rng() & 1) frame[(bit + pos) / 8] ^= 0x80 >> ((bit + pos) % 8);
+    }
+    bit += burst;
+  }
+}
+
+static double packetErrorRate(uint8_t parity, uint8_t depth, double ber, bool bursty)
+{
+  Si446xFEC fec(parity, depth);
+  uint8_t data[kPayload], frame[64], out[64];
+  uint32_t lost = 0;
+  for (uint32_t packet = 0; packet < kPackets; packet++) {
+    fill(data, kPayload);
+    uint8_t frameLength = kPayload;
+    if (parity > 0) {
+      fec.encode(data, kPayload, frame);
+      frameLength = fec.getFrameLength(kPayload);
+    }
+    else memcpy(frame, data, kPayload);
+
+    corrupt(frame, frameLength, ber, bursty);
+
+    if (parity > 0) {
+      if (fec.decode(frame, frameLength, out) != kPayload || memcmp(out, data, kPayload) != 0) lost++;
+    }
+    else if (memcmp(frame, data, kPayload) != 0) lost++;
+  }
+  return (double)lost / kPackets;
+}
+
+int main()
+{
+  static const uint8_t codes[][2] = { { 0, 1 }, { 8, 1 }, { 8, 2 }, { 8, 4 }, { 16, 2 } };
+  static const double rates[] = { 1e-4, 1e-3, 3e-3, 1e-2, 2e-2 };
+
+  printf("Self check with parity/2 byte errors per codeword:");
+  for (uint8_t code = 1; code < 5; code++) {
+    printf(" RS %u x%u %s", codes[code][0], codes[code][1], selfCheck(codes[code][0], codes[code][1]) ? "ok" : "FAILED");
+  }
+  printf("\n\n%u byte payload, microseconds per frame on this host\n", kPayload);
+  printf("code       encode  decode ok  corrected\n");
+  for (uint8_t code = 1; code < 5; code++) throughput(codes[code][0], codes[code][1]);
+
+  for (uint8_t bursty = 0; bursty < 2; bursty++) {
+    printf("\nPacket error rate, %lu packets of %u bytes, %s bit errors\n", (unsigned long)kPackets,
+      kPayload, bursty ? "bursty" : "random");
+    printf("code      frame");
+    for (uint8_t rate = 0; rate < 5; rate++) printf("    %7.0e", rates[rate]);
+    printf("\n");
+    for (uint8_t code = 0; code < 5; code++) {
+      uint8_t parity = codes[code][0], depth = codes[code][1];
+      if (parity == 0) printf("none      %5u", kPayload);
+      else printf("RS %2u x%u  %5u", parity, depth, kPayload + parity * depth);
+      for (uint8_t rate = 0; rate < 5; rate++) {
+        printf("    %7.4f", packetErrorRate(parity, depth, rates[rate], bursty));
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,366 @@
+/**
+ * Packets per second through Si446xGateway (si446x_gateway.h) with 1 to 8
+ * simulated receivers and 1 to 4 dispatcher threads, in real time.
+ *
+ * Each radio is a Si446xSim on the wall clock behind its own SpidevBus,
+ * whose ioctl stand-in plays the messages into that model under a lock,
+ * and its own GpiochipLine fed nIRQ edges through a pipe. An air thread
+ * per radio puts a 48 byte frame (32 byte payload, RS 8 x2 parity) on the
+ * air every period; one in four arrives with two bytes corrupted and a
+ * CRC error. Dispatchers decode with Si446xFEC and the sink checks the
+ * payload and its sequence number, then spins for the given time as a
+ * stand-in for forwarding the packet. Bus time is not modelled: the ioctl
+ * returns as soon as the model has answered.
+ *
+ * Delivered packets per second grow with the radios until the sink work
+ * fills the dispatchers, and with the dispatchers while there are cores
+ * to run them on. The last run makes one radio slow to raise CTS and shows
+ * the others' latency is not affected; the slow one cannot keep up.
+ *
+ * Returns nonzero if a run delivers a packet that is not intact or out of
+ * order, or loses more than kMaxLoss per mille of the packets sent, the
+ * slow radio's aside. Service threads without SCHED_FIFO are reported,
+ * since on a busy core they are what loses packets.
+ *
+ *   g++ -std=c++17 -O2 -pthread -Ihost -I. -DSI446X_TRANSPORT_HEADER='"spidev_transport.h"' -DSI446X_TRANSPORT=SpidevTransport -DSI446X_CLOCK=LinuxClock -DSI446X_RECORD_PAYLOAD=64 host/bench_gateway.cpp si4x6x.cpp si4x6x_fec.cpp -o bench_gateway
+ *   ./bench_gateway [sink work in us, default 100] [ms per run, default 1000]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+
+#include "si4x6x.h"
+#include "si4x6x_fec.h"
+#include "si446x_gateway.h"
+#include "si446x_sim.h"
+
+static const uint8_t  kRadios     = 8;
+static const uint8_t  kPayload    = 32;
+static const uint32_t kDataRate   = 250000UL;
+static const uint32_t kPeriod     = 3000;     // us between frames on one radio
+static const uint32_t kSPIClock   = 4000000UL;
+static const uint8_t  kHeader     = 10;       // the model's preamble and sync bytes
+static const uint32_t kMaxLoss    = 2;        // per mille of the packets sent
+
+static uint32_t sinkWork = 100;
+static uint32_t runTime = 1000;
+
+static Si446xFEC  fecs[Si446xGateway::kMaxDispatchers];
+static uint8_t    frameLength;
+
+struct Rig {
+  Rig(uint8_t index)
+    : index(index), sim(10 + index, 2 + index, kDataRate), radio(10 + index, 26000000UL, SpidevTransport(&bus)),
+      selected(false), seqno(0), stop(false), sent(0), expected(0), intact(0), outOfOrder(0) {}
+
+  uint8_t       index;
+  Si446xFEC     fec;        // air thread's encoder
+  std::mutex    lock;
+  Si446xSim     sim;
+  SpidevBus     bus;
+  Si446x        radio;
+  GpiochipLine  line;
+  int           irqPipe[2];
+  bool          selected;
+  uint32_t      seqno;
+  bool          stop;
+  uint32_t      sent;
+  uint32_t      expected;   // next sequence number, dispatcher side
+  uint32_t      intact;
+  uint32_t      outOfOrder;
+  std::thread   air;
+};
+
+static Rig *rigs[kRadios];
+
+// SPI_IOC_MESSAGE into the rig's model, fd being the rig's index
+static int stubIoctl(int fd, unsigned long request, void *arg)
+{
+  Rig &rig = *rigs[fd];
+  size_t count = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+  struct spi_ioc_transfer *segments = (struct spi_ioc_transfer *)arg;
+  int total = 0;
+
+  std::lock_guard<std::mutex> lock(rig.lock);
+  for (size_t idx = 0; idx < count; idx++) {
+    struct spi_ioc_transfer &segment = segments[idx];
+    const uint8_t *tx = (const uint8_t *)(uintptr_t)segment.tx_buf;
+    uint8_t *rx = (uint8_t *)(uintptr_t)segment.rx_buf;
+
+    if (!rig.selected) {
+      rig.sim.select();
+      rig.selected = true;
+    }
+    for (uint32_t pos = 0; pos < segment.len; pos++) {
+      uint8_t x = rig.sim.transfer(tx ? tx[pos] : 0);
+      if (rx) rx[pos] = x;
+    }
+    total += segment.len;
+
+    bool last = (idx + 1 == count);
+    if (segment.cs_change != last) {
+      rig.sim.release();
+      rig.selected = false;
+    }
+  }
+  return total;
+}
+
+// Runs with the rig locked, from whichever thread moved the model
+template<int N>
+static void onEdge()
+{
+  Rig &rig = *rigs[N];
+  struct gpio_v2_line_event event;
+  memset(&event, 0, sizeof(event));
+  event.timestamp_ns = LinuxClock::micros() * 1000ULL;
+  event.id = GPIO_V2_LINE_EVENT_FALLING_EDGE;
+  event.line_seqno = ++rig.seqno;
+  if (write(rig.irqPipe[1], &event, sizeof(event)) != sizeof(event)) perror("irq pipe");
+}
+
+static void (*const edgeISRs[kRadios])() = {
+  onEdge<0>, onEdge<1>, onEdge<2>, onEdge<3>, onEdge<4>, onEdge<5>, onEdge<6>, onEdge<7>
+};
+
+static void makePayload(uint8_t radio, uint32_t seqno, uint8_t *payload)
+{
+  payload[0] = radio;
+  memcpy(payload + 1, &seqno, sizeof(seqno));
+  for (uint8_t pos = 5; pos < kPayload; pos++) payload[pos] = (uint8_t)(seqno + pos);
+}
+
+static void sleepUntil(uint32_t time)
+{
+  int32_t wait = (int32_t)(time - LinuxClock::micros());
+  if (wait > 0) LinuxClock::delayMicroseconds(wait);
+}
+
+/**
+ * Puts the next frame on the air every period and catches the model up
+ * when it has ended, so nIRQ falls on time even while the radio's service
+ * thread is asleep. The end is counted from when the frame went on the
+ * air: from the period alone, a late start would leave nIRQ for the next
+ * frame's receive() to raise, with that frame already filling the FIFO.
+ */
+static void runAir(Rig &rig)
+{
+  uint8_t payload[kPayload], frame[64];
+  uint32_t airTime = (kHeader + frameLength) * 8000000UL / kDataRate + 100;
+  uint32_t next = LinuxClock::micros();
+  while (!__atomic_load_n(&rig.stop, __ATOMIC_RELAXED)) {
+    sleepUntil(next);
+
+    makePayload(rig.index, rig.sent, payload);
+    rig.fec.encode(payload, kPayload, frame);
+    bool crcOK = (rig.sent % 4) != 3;
+    if (!crcOK) {
+      frame[3] ^= 0x5A;
+      frame[20] ^= 0xFF;
+    }
+    uint32_t start;
+    {
+      std::lock_guard<std::mutex> lock(rig.lock);
+      rig.sim.receive(frame, frameLength, crcOK);
+      start = LinuxClock::micros();
+      rig.sent++;
+    }
+
+    sleepUntil(start + airTime);
+    {
+      std::lock_guard<std::mutex> lock(rig.lock);
+      rig.sim.update();
+    }
+    next += kPeriod;
+  }
+}
+
+static bool decode(uint8_t dispatcher, uint8_t radio, Si446xPacketRecord &packet, void *context)
+{
+  int16_t length = fecs[dispatcher].decode(packet.data, packet.length, packet.data);
+  if (length < 0) return false;
+  packet.length = length;
+  return true;
+}
+
+// A radio's packets all come through the same dispatcher, so rig state needs no lock
+static void check(uint8_t dispatcher, uint8_t radio, const Si446xPacketRecord &packet, void *context)
+{
+  Rig &rig = *rigs[radio];
+  uint32_t seqno;
+  memcpy(&seqno, packet.data + 1, sizeof(seqno));
+
+  uint8_t expected[kPayload];
+  makePayload(radio, seqno, expected);
+  if (packet.length == kPayload && memcmp(packet.data, expected, kPayload) == 0) rig.intact++;
+  if (seqno < rig.expected) rig.outOfOrder++;
+  rig.expected = seqno + 1;
+
+  uint32_t start = LinuxClock::micros();
+  while (LinuxClock::micros() - start < sinkWork) {}
+}
+
+static void setupRig(Rig &rig)
+{
+  static const uint8_t fieldLength[] = {
+    0x06, 0x11, 0x12, 0x02, 0x0D, 0x00, 0x00,   // PKT_FIELD_1_LENGTH, length filled in
+    0x00
+  };
+  uint8_t config[sizeof(fieldLength)];
+  memcpy(config, fieldLength, sizeof(config));
+  config[6] = frameLength;
+
+  if (pipe(rig.irqPipe) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  rig.line.adopt(rig.irqPipe[0]);
+  attachInterrupt(digitalPinToInterrupt(2 + rig.index), edgeISRs[rig.index], FALLING);
+
+  rig.sim.setClock(LinuxClock::micros);
+  rig.sim.useTypicalTimes();
+  rig.bus.setIoctl(stubIoctl, kSPIClock, rig.index);
+
+  Si446x &radio = rig.radio;
+  radio.powerUpXTAL();
+  radio.configure(config);
+  radio.configureFastStatus();
+  radio.setPHInterrupts(Si446x::kIntPacketRX | Si446x::kIntCRCError);
+  radio.setIntControl(false, false, true);
+  radio.startRX(0, 0, Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
+  radio.getIntStatus();
+}
+
+struct Result {
+  uint32_t  offered;        // packets per second on the air
+  uint32_t  delivered;
+  uint32_t  lost;           // sent but not delivered, for whatever reason
+  uint32_t  latencyMean;
+  uint32_t  latencyMax;
+  uint32_t  cpu;            // percent of one core
+  bool      intact;
+  bool      lossOK;         // lost within kMaxLoss, the slow radio's aside
+  bool      realtime;       // every service thread got SCHED_FIFO
+};
+
+static uint64_t cpuMicros()
+{
+  struct timespec time;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return time.tv_sec * 1000000ULL + time.tv_nsec / 1000;
+}
+
+/**
+ * One run with radios receivers and dispatchers threads; slow, if set, is
+ * the CTS time of radio 0. Prints a line per radio if verbose.
+ */
+static Result run(uint8_t radios, uint8_t dispatchers, uint32_t slow = 0, bool verbose = false)
+{
+  for (uint8_t idx = 0; idx < radios; idx++) {
+    rigs[idx] = new Rig(idx);
+    setupRig(*rigs[idx]);
+  }
+  if (slow) rigs[0]->sim.setCommandTime(slow);
+
+  Si446xGateway gateway(dispatchers);
+  for (uint8_t idx = 0; idx < radios; idx++) gateway.add(rigs[idx]->radio, rigs[idx]->line);
+  gateway.setDecoder(decode);
+  gateway.addSink(check);
+
+  uint32_t start = LinuxClock::micros();
+  uint64_t cpuStart = cpuMicros();
+  if (!gateway.start()) {
+    perror("gateway");
+    exit(1);
+  }
+  for (uint8_t idx = 0; idx < radios; idx++) rigs[idx]->air = std::thread(runAir, std::ref(*rigs[idx]));
+
+  LinuxClock::delayMicroseconds(runTime * 1000);
+
+  for (uint8_t idx = 0; idx < radios; idx++) {
+    __atomic_store_n(&rigs[idx]->stop, true, __ATOMIC_RELAXED);
+    rigs[idx]->air.join();
+  }
+  // Let the last frames land before the service threads go
+  LinuxClock::delayMicroseconds(2 * kPeriod);
+  gateway.stop();
+  uint32_t elapsed = LinuxClock::micros() - start;
+  uint64_t cpu = cpuMicros() - cpuStart;
+
+  Result result;
+  memset(&result, 0, sizeof(result));
+  result.intact = result.lossOK = result.realtime = true;
+  uint32_t sent = 0;
+  uint64_t latencySum = 0;
+  for (uint8_t idx = 0; idx < radios; idx++) {
+    Rig &rig = *rigs[idx];
+    Si446xGateway::Counters counters = gateway.getCounters(idx);
+    const Si446xSim::Counters &sim = rig.sim.getCounters();
+    sent += rig.sent;
+    result.delivered += counters.delivered;
+    latencySum += counters.latencySum;
+    if (counters.latencyMax > result.latencyMax) result.latencyMax = counters.latencyMax;
+    if (!counters.delivered || rig.intact != counters.delivered || rig.outOfOrder || counters.rejected) result.intact = false;
+    if (!(slow && idx == 0) && (rig.sent - counters.delivered) * 1000 > rig.sent * kMaxLoss) result.lossOK = false;
+    if (!gateway.isRealtime(idx)) result.realtime = false;
+
+    if (verbose) {
+      printf("%5u %8lu %8lu %8lu %8lu %8lu %8lu %8lu\n", idx, (unsigned long)rig.sent,
+        (unsigned long)counters.delivered, (unsigned long)sim.rxMissed, (unsigned long)counters.fifoErrors,
+        (unsigned long)counters.queueDrops,
+        (unsigned long)(counters.delivered ? counters.latencySum / counters.delivered : 0),
+        (unsigned long)counters.latencyMax);
+    }
+  }
+  result.offered = (uint32_t)(sent * 1000000ULL / elapsed);
+  result.latencyMean = result.delivered ? (uint32_t)(latencySum / result.delivered) : 0;
+  result.cpu = (uint32_t)(cpu * 100 / elapsed);
+  result.lost = sent - result.delivered;
+  result.delivered = (uint32_t)(result.delivered * 1000000ULL / elapsed);
+
+  for (uint8_t idx = 0; idx < radios; idx++) {
+    ::close(rigs[idx]->irqPipe[1]);
+    delete rigs[idx];
+    rigs[idx] = 0;
+  }
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1) sinkWork = atol(argv[1]);
+  if (argc > 2) runTime = atol(argv[2]);
+  frameLength = fecs[0].getFrameLength(kPayload);
+
+  printf("%u byte frames every %lu us per radio at %lu kbps, %lu us sink work, %lu ms per run, %u cores\n\n",
+    frameLength, (unsigned long)kPeriod, (unsigned long)(kDataRate / 1000), (unsigned long)sinkWork,
+    (unsigned long)runTime, std::thread::hardware_concurrency());
+  printf("radios  disp  offered pkt/s  delivered pkt/s    lost  mean us   max us  cpu %%  check\n");
+
+  static const uint8_t radioCounts[] = { 1, 2, 4, 8 };
+  static const uint8_t dispatcherCounts[] = { 1, 2, 4 };
+  bool ok = true, realtime = true;
+  for (uint8_t r = 0; r < sizeof(radioCounts); r++) {
+    for (uint8_t d = 0; d < sizeof(dispatcherCounts); d++) {
+      Result result = run(radioCounts[r], dispatcherCounts[d]);
+      printf("%6u %5u %14lu %16lu %7lu %8lu %8lu %6lu  %s\n", radioCounts[r], dispatcherCounts[d],
+        (unsigned long)result.offered, (unsigned long)result.delivered, (unsigned long)result.lost,
+        (unsigned long)result.latencyMean, (unsigned long)result.latencyMax, (unsigned long)result.cpu,
+        !result.intact ? "FAILED" : !result.lossOK ? "LOSS" : "ok");
+      ok = ok && result.intact && result.lossOK;
+      realtime = realtime && result.realtime;
+    }
+  }
+
+  printf("\n4 radios, 2 dispatchers, radio 0 holding CTS low 1 ms after each command\n");
+  printf("radio     sent    recvd   missed overflow   qdrops  mean us   max us\n");
+  Result result = run(4, 2, 1000, true);
+  ok = ok && result.intact && result.lossOK;
+  realtime = realtime && result.realtime;
+
+  if (!realtime) printf("\nservice threads ran without SCHED_FIFO\n");
+  printf("\nlost at most %lu per mille, radio 0 aside in the slow run: %s\n", (unsigned long)kMaxLoss,
+    ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
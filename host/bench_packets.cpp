@@ -0,0 +1,130 @@
+/**
+ * Variable length packets from the simulated radio, configured with the
+ * Si4362 WDS profile (1 byte length field stored in the FIFO). Compares
+ * SPI frames per packet for a per-packet receive loop (FIFO_INFO, read the
+ * length byte, read the payload) and for Si446x::receivePackets(), which
+ * drains everything queued with one FIFO read. Payloads are checked.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_packets.cpp si4x6x.cpp si4x6x_irq.cpp -o bench_packets
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+#include "si446x_sim.h"
+#include "radio_config_Si4362.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+static const int kPinCS   = 10;
+static const int kPinIRQ  = 2;
+
+static const uint16_t kPackets = 200;
+
+static Si446xSim  sim(kPinCS, kPinIRQ);
+static Si446x     radio(kPinCS, 26000000UL);
+static Si446xIRQ  irq(radio, kPinIRQ);
+
+struct Result {
+  bool      burst;
+  uint32_t  packets;
+  uint32_t  errors;
+  uint32_t  expected;   // sequence number of the next packet
+};
+
+static void check(Result &result, const uint8_t *payload, uint8_t length)
+{
+  bool ok = (length >= 1 && payload[0] == (uint8_t)result.expected);
+  for (uint8_t idx = 1; ok && idx < length; idx++) {
+    if (payload[idx] != (uint8_t)(payload[0] + idx)) ok = false;
+  }
+  if (!ok) result.errors++;
+  result.expected = payload[0] + 1;
+  result.packets++;
+}
+
+static void onPacket(Si446x::IRQStatus &status, void *context)
+{
+  Result &result = *(Result *)context;
+  if (!status.isPacketRXPending()) return;
+
+  if (result.burst) {
+    static uint8_t storage[96];
+    static Si446x::RXBuffer buffer(storage, sizeof(storage));
+    Si446x::Packet packets[8];
+    uint8_t count;
+    do {
+      count = radio.receivePackets(buffer, packets, 8);
+      for (uint8_t idx = 0; idx < count; idx++) {
+        check(result, buffer.data + packets[idx].offset, packets[idx].length);
+      }
+    } while (count == 8);
+    return;
+  }
+
+  Si446x::Transaction bus(radio);
+  uint8_t available = radio.getAvailableRX();
+  while (available > 0) {
+    uint8_t length, payload[256];
+    radio.readRX(&length, 1);
+    if (length + 1 > available) {
+      // Rest of the packet still coming: wait for it, as a simple loop would
+      while (radio.getAvailableRX() < length) {
+        delayMicroseconds(100);
+      }
+      available = length + 1;
+    }
+    radio.readRX(payload, length);
+    check(result, payload, length);
+    available -= length + 1;
+  }
+}
+
+static void run(bool burst, uint32_t interval)
+{
+  radio.configure_P(radioConfig);
+  sim.setDataRate(100000);
+
+  Result result = { burst, 0, 0, 0 };
+  irq.onPacketHandler(onPacket, &result);
+  irq.enable(Si446x::kIntPacketRX);
+  radio.startRX(0, 0, Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
+
+  srand(1);
+  uint8_t frame[17];
+  for (uint16_t idx = 0; idx < kPackets; idx++) {
+    uint8_t length = 1 + rand() % 16;
+    frame[0] = length;
+    for (uint8_t pos = 0; pos < length; pos++) frame[1 + pos] = (uint8_t)(idx + pos);
+    sim.receive(frame, length + 1);
+  }
+
+  Si446x::Counters before = radio.getBusCounters();
+  while (sim.isReceiving() || result.packets < sim.getCounters().packetsReceived) {
+    delayMicroseconds(interval);
+    sim.update();
+    irq.service();
+    if (micros() > 100000000UL) break;
+  }
+  uint32_t frames = radio.getBusCounters().frames - before.frames;
+
+  printf("%-12s %8lu %8lu %7lu %9lu %8.2f\n", burst ? "burst" : "per packet",
+    (unsigned long)interval, (unsigned long)result.packets, (unsigned long)result.errors,
+    (unsigned long)frames, result.packets ? (double)frames / result.packets : 0.0);
+}
+
+int main()
+{
+  sim.attach();
+  irq.begin();
+
+  printf("%u packets, 1..16 byte payloads, 100 kbps\n\n", kPackets);
+  printf("receiver     interval  packets  errors SPI frames  per pkt\n");
+  static const uint32_t intervals[] = { 500, 2000, 5000 };
+  for (uint8_t idx = 0; idx < 3; idx++) {
+    run(false, intervals[idx]);
+    run(true, intervals[idx]);
+  }
+  return 0;
+}
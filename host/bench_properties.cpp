@@ -0,0 +1,114 @@
+/**
+ * Runs the sketch's initModem() property sequence with and without
+ * beginProperties()/flushProperties() and reports the SET_PROPERTY
+ * commands and bytes that coalescing saves, and what running it again in
+ * the same mode costs once the shadow copy knows the radio's properties (a
+ * mode switch powers the radio up and starts from scratch). The
+ * Si4362 WDS configuration stream is run through configure_P() as well,
+ * followed by the generated delta to the Si4060 profile.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_properties.cpp si4x6x.cpp -o bench_properties
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "radio_config_Si4362.h"
+#include "radio_delta_Si4362_to_Si4060.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+static const uint8_t radioDelta[] PROGMEM = RADIO_DELTA_SI4362_TO_SI4060;
+
+// Room for the whole WDS stream and the setters
+static const uint8_t kShadowSize = 255;
+static Si446x::PropertyEntry shadowTable[kShadowSize];
+
+static void initProperties(Si446x &radio, bool rx)
+{
+  radio.setGlobalConfig(0x60);
+  radio.setXOTune(28);
+  if (!rx) radio.setPreambleLength(0x0A);
+
+  radio.setFrequency(434000000UL);
+
+  radio.setPreambleConfig(0x31);
+  radio.setSync(0x01, 0xB42B);
+  radio.setPacketConfig(0x02);
+  radio.setField1Config(0x04);
+
+  radio.setModulation(Si446xBase::kMod2FSK, Si446xBase::kSourceFIFO);
+  radio.setNCOModulo(Si446xBase::kModulo10, 26000000UL);
+  radio.setDataRate(10 * 1000);
+  radio.setDeviation(20000);
+  radio.setModemParams(0x80, 0x08, 0x038000ul, 0x30, 0x20);
+  radio.setBCRParams(1625, 20649, 40, 0x02, 0xC2);
+
+  if (!rx) radio.setPAConfig(0x18, 0x10, 0xC0, 0x3D);
+  if (rx) {
+    radio.setRSSIMode(0x02);
+    radio.setRSSIThreshold(0x40);
+    radio.setRSSIComp(0x40);
+  }
+}
+
+static void run(const char *name, bool rx, bool deferred, bool again = false)
+{
+  Si446x radio(10, 26000000UL);
+  radio.setShadowTable(shadowTable, kShadowSize);
+
+  if (again) {
+    radio.beginProperties();
+    initProperties(radio, rx);
+    radio.flushProperties();
+    radio.resetPropertyCounters();
+  }
+
+  SPI.resetCounters();
+  if (deferred) radio.beginProperties();
+  initProperties(radio, rx);
+  if (deferred) radio.flushProperties();
+
+  const Si446x::PropertyCounters &counters = radio.getPropertyCounters();
+  printf("%-14s %2u/%2u commands %3u/%3u bytes, %4u SPI bytes total\n", name,
+    counters.sent, counters.requested, counters.sentBytes, counters.requestedBytes, SPI.bytes);
+}
+
+static void runConfig()
+{
+  Si446x radio(10, 26000000UL);
+  radio.setShadowTable(shadowTable, kShadowSize);
+
+  SPI.resetCounters();
+  radio.configure_P(radioConfig);
+
+  const Si446x::PropertyCounters &counters = radio.getPropertyCounters();
+  printf("%-14s %2u/%2u commands %3u/%3u bytes, %4u SPI bytes total\n", "Si4362 config",
+    counters.sent, counters.requested, counters.sentBytes, counters.requestedBytes, SPI.bytes);
+}
+
+static void runDelta()
+{
+  Si446x radio(10, 26000000UL);
+  radio.setShadowTable(shadowTable, kShadowSize);
+  radio.configure_P(radioConfig);
+  radio.resetPropertyCounters();
+
+  SPI.resetCounters();
+  radio.applyDelta(radioDelta);
+
+  const Si446x::PropertyCounters &counters = radio.getPropertyCounters();
+  printf("%-14s %2u/%2u commands %3u/%3u bytes, %4u SPI bytes total\n", "Si4362 delta",
+    counters.sent, counters.requested, counters.sentBytes, counters.requestedBytes, SPI.bytes);
+}
+
+int main()
+{
+  runConfig();
+  runDelta();
+  run("TX immediate", false, false);
+  run("TX deferred", false, true);
+  run("RX immediate", true, false);
+  run("RX deferred", true, true);
+  run("TX again", false, true, true);
+  run("RX again", true, true, true);
+  return 0;
+}
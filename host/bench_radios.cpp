@@ -0,0 +1,231 @@
+/**
+ * Three simulated receivers on one bus, configured with the Si4362 WDS
+ * profile and drained the way the sketch does it (receivePackets()).
+ * Serviced with Si446xIRQ::service() for each in turn, waiting for every
+ * CTS; through Si446xManager with the same blocking handlers; and through
+ * Si446xManager with handlers that use receivePacketsAsync(). Radio 2 is
+ * slow: every command holds CTS low for 1.5 ms. Packets are scheduled on
+ * each radio at a fixed period; latency runs from a packet's scheduled time
+ * to its payload being read, so a loop stalled on another radio shows up
+ * there. Airtime is the same in all runs.
+ *
+ * The last run repeats the async one with radio 2 at typical command times.
+ * Returns nonzero if, with the slow radio, the others' worst case latency
+ * is more than a few polls above that.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_radios.cpp si4x6x.cpp si4x6x_irq.cpp si4x6x_manager.cpp -o bench_radios
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+#include "si4x6x_manager.h"
+#include "si446x_sim.h"
+#include "radio_config_Si4362.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+static const uint8_t  kRadios     = 3;
+static const uint8_t  kSlowRadio  = 2;
+static const uint32_t kRunTime    = 2000000UL;
+static const uint32_t kSPIClock   = 1000000UL;
+static const uint32_t kTolerance  = 50;       // us over the reference worst case
+static const uint8_t  kMaxPackets = 4;        // per receivePackets() call
+
+static const int      kPinCS[kRadios]     = { 10, 9, 8 };
+static const int      kPinIRQ[kRadios]    = { 2, 3, 4 };
+static const uint8_t  kPriority[kRadios]  = { 0, 1, 2 };
+static const uint32_t kPeriod[kRadios]    = { 5000, 7000, 11000 };
+
+static Si446xSim sims[kRadios] = {
+  Si446xSim(kPinCS[0], kPinIRQ[0], 100000), Si446xSim(kPinCS[1], kPinIRQ[1], 100000), Si446xSim(kPinCS[2], kPinIRQ[2], 100000)
+};
+static Si446x radios[kRadios] = {
+  Si446x(kPinCS[0], 26000000UL), Si446x(kPinCS[1], 26000000UL), Si446x(kPinCS[2], 26000000UL)
+};
+static Si446xIRQ irqs[kRadios] = {
+  Si446xIRQ(radios[0], kPinIRQ[0]), Si446xIRQ(radios[1], kPinIRQ[1]), Si446xIRQ(radios[2], kPinIRQ[2])
+};
+
+enum Service {
+  kInTurn,          // Si446xIRQ::service(), blocking handlers
+  kManaged,         // Si446xManager::service(), blocking handlers
+  kManagedAsync     // Si446xManager::service(), receivePacketsAsync()
+};
+
+struct Receiver {
+  Receiver() : buffer(storage, sizeof(storage)) {}
+
+  uint8_t   index;
+  uint32_t  start;        // time of the first scheduled packet
+  uint32_t  scheduled;    // packets handed to the model
+  uint32_t  received;
+  uint32_t  latencySum;
+  uint32_t  latencyMax;
+
+  uint8_t           storage[64];
+  Si446x::RXBuffer  buffer;
+  bool              reading;    // receivePacketsAsync() in flight
+  bool              again;      // PACKET_RX seen meanwhile
+};
+
+static Receiver receivers[kRadios];
+static Service service;
+
+// Length byte and payload, as the WDS profile expects them
+static uint8_t packet[17];
+
+static void record(Receiver &receiver, uint8_t count)
+{
+  for (uint8_t pkt = 0; pkt < count; pkt++) {
+    uint32_t latency = micros() - (receiver.start + receiver.received * kPeriod[receiver.index]);
+    receiver.latencySum += latency;
+    if (latency > receiver.latencyMax) receiver.latencyMax = latency;
+    receiver.received++;
+  }
+}
+
+static void onRead(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Receiver &receiver = *(Receiver *)context;
+  receiver.reading = false;
+  if (success) {
+    Si446x::Packet packets[kMaxPackets];
+    uint8_t count;
+    do {
+      count = radios[receiver.index].takePackets(receiver.buffer, packets, kMaxPackets);
+      record(receiver, count);
+    } while (count == kMaxPackets);
+  }
+
+  // The FIFO count may have been taken before the last packet was in
+  if (receiver.again) {
+    receiver.again = false;
+    receiver.reading = true;
+    radios[receiver.index].receivePacketsAsync(receiver.buffer, onRead, &receiver);
+  }
+}
+
+static void onPacket(Si446x::IRQStatus &status, void *context)
+{
+  Receiver &receiver = *(Receiver *)context;
+  if (!status.isPacketRXPending()) return;
+
+  if (service != kManagedAsync) {
+    Si446x::Packet packets[kMaxPackets];
+    uint8_t count;
+    do {
+      count = radios[receiver.index].receivePackets(receiver.buffer, packets, kMaxPackets);
+      record(receiver, count);
+    } while (count == kMaxPackets);
+  }
+  else if (receiver.reading) {
+    receiver.again = true;
+  }
+  else {
+    receiver.reading = true;
+    radios[receiver.index].receivePacketsAsync(receiver.buffer, onRead, &receiver);
+  }
+}
+
+static void setup(bool slow)
+{
+  for (uint8_t idx = 0; idx < kRadios; idx++) {
+    Si446x &radio = radios[idx];
+    sims[idx].useTypicalTimes();
+    radio.configure_P(radioConfig);
+    irqs[idx].onPacketHandler(onPacket, &receivers[idx]);
+    irqs[idx].enable(Si446x::kIntPacketRX);
+    radio.startRX(0, 0, Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
+
+    if (slow && idx == kSlowRadio) sims[idx].setCommandTime(1500);
+  }
+  delay(10);
+  for (uint8_t idx = 0; idx < kRadios; idx++) {
+    Receiver &receiver = receivers[idx];
+    irqs[idx].service();
+    irqs[idx].resetLatency();
+    receiver.buffer.reset();
+    receiver.index = idx;
+    receiver.start = micros() + 1000;
+    receiver.scheduled = receiver.received = 0;
+    receiver.latencySum = receiver.latencyMax = 0;
+    receiver.reading = receiver.again = false;
+  }
+}
+
+// Hands every packet that is due to its model
+static void schedule()
+{
+  uint32_t now = micros();
+  for (uint8_t idx = 0; idx < kRadios; idx++) {
+    Receiver &receiver = receivers[idx];
+    sims[idx].update();
+    if ((int32_t)(now - (receiver.start + receiver.scheduled * kPeriod[idx])) >= 0) {
+      sims[idx].receive(packet, sizeof(packet));
+      receiver.scheduled++;
+    }
+  }
+}
+
+// Reports bus use in every run, services the radios only in the managed ones
+static Si446xManager manager(kSPIClock);
+
+// Returns the worst case latency of the radios other than the slow one
+static uint32_t run(Service mode, bool slow)
+{
+  service = mode;
+  setup(slow);
+  manager.resetCounters();
+  uint32_t start = micros();
+  while (micros() - start < kRunTime) {
+    delayMicroseconds(20);    // rest of the main loop
+    schedule();
+    if (mode == kInTurn) {
+      for (uint8_t idx = 0; idx < kRadios; idx++) irqs[idx].service();
+    }
+    else {
+      manager.service();
+    }
+  }
+
+  static const char *names[] = {
+    "Si446xIRQ::service() in turn", "Si446xManager::service(), blocking handlers",
+    "Si446xManager::service(), receivePacketsAsync()"
+  };
+  printf("%s%s\n", names[mode], slow ? "" : ", no slow radio");
+  printf("radio  prio  period   sent  recvd  pkt/s  mean us   max us  bus %%o\n");
+  uint32_t othersMax = 0;
+  for (uint8_t idx = 0; idx < kRadios; idx++) {
+    const Receiver &receiver = receivers[idx];
+    printf("%5u %5u %7lu %6lu %6lu %6lu %8lu %8lu %7u\n", idx, kPriority[idx], (unsigned long)kPeriod[idx],
+      (unsigned long)receiver.scheduled, (unsigned long)receiver.received,
+      (unsigned long)(mode != kInTurn ? manager.getPacketsPerSecond(idx) : receiver.received * 1000000ULL / kRunTime),
+      (unsigned long)(receiver.received ? receiver.latencySum / receiver.received : 0),
+      (unsigned long)receiver.latencyMax, manager.getBusUtilisation(idx));
+    if (idx != kSlowRadio && receiver.latencyMax > othersMax) othersMax = receiver.latencyMax;
+  }
+  printf("\n");
+  return othersMax;
+}
+
+int main()
+{
+  packet[0] = sizeof(packet) - 1;
+  for (uint8_t idx = 1; idx < sizeof(packet); idx++) packet[idx] = idx;
+  for (uint8_t idx = 0; idx < kRadios; idx++) {
+    sims[idx].attach();
+  }
+  for (uint8_t idx = 0; idx < kRadios; idx++) manager.add(irqs[idx], kPriority[idx]);
+  manager.begin();
+
+  run(kInTurn, true);
+  run(kManaged, true);
+  uint32_t withSlow = run(kManagedAsync, true);
+  uint32_t reference = run(kManagedAsync, false);
+
+  bool ok = withSlow <= reference + kTolerance;
+  printf("worst case of radios 0-1: %lu us, %lu us without the slow radio: %s\n",
+    (unsigned long)withSlow, (unsigned long)reference, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+/**
+ * Receives frames longer than the RX FIFO through Si446xRXStream from the
+ * simulated radio and sweeps how often the main loop calls
+ * Si446xIRQ::service(). Bytes the radio had to drop because the FIFO was
+ * not drained in time show up as FIFO errors and as the model's RX
+ * overflows; a consumer that reads the ring too rarely shows up as ring
+ * overflows. The received byte stream is checked against what was sent.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_rx_stream.cpp si4x6x.cpp si4x6x_irq.cpp si4x6x_stream.cpp -o bench_rx_stream
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+#include "si4x6x_stream.h"
+#include "si446x_sim.h"
+
+static const int kPinCS   = 10;
+static const int kPinIRQ  = 2;
+
+static const uint16_t kFrameLength  = 500;
+static const uint8_t  kFrames       = 4;
+
+static Si446xSim  sim(kPinCS, kPinIRQ);
+static Si446x     radio(kPinCS, 26000000UL);
+static Si446xIRQ  irq(radio, kPinIRQ);
+
+static void run(uint32_t dataRate, uint8_t threshold, uint32_t interval, uint32_t consumeInterval)
+{
+  static uint8_t storage[1024];
+  Si446xRing ring(storage, sizeof(storage));
+
+  radio.powerUpXTAL();
+  sim.setDataRate(dataRate);
+
+  Si446xRXStream stream(radio, ring, threshold);
+  irq.onPacketHandler(Si446xRXStream::onEvent, &stream);
+  irq.onChip(Si446xRXStream::onChipEvent, &stream);
+  irq.enable(Si446x::kIntRXFIFOAlmostFull | Si446x::kIntPacketRX, 0, Si446x::kIntFIFOError);
+  stream.begin();
+
+  uint8_t frame[kFrameLength];
+  for (uint8_t idx = 0; idx < kFrames; idx++) {
+    for (uint16_t pos = 0; pos < kFrameLength; pos++) frame[pos] = (uint8_t)(pos * 7 + idx);
+    sim.receive(frame, kFrameLength);
+  }
+
+  // Bytes must come out in order; dropped ones just shorten the stream
+  uint32_t received = 0, mismatches = 0;
+  uint32_t lastConsume = micros();
+  while (sim.isReceiving() || stream.getCounters().frames + stream.getCounters().crcErrors < sim.getCounters().packetsReceived) {
+    delayMicroseconds(interval);
+    sim.update();
+    irq.service();
+
+    if (micros() - lastConsume >= consumeInterval) {
+      lastConsume = micros();
+      uint16_t run;
+      const uint8_t *data;
+      while ((data = ring.readRun(run)), run > 0) {
+        for (uint16_t idx = 0; idx < run; idx++, received++) {
+          uint16_t pos = received % kFrameLength;
+          if (data[idx] != (uint8_t)(pos * 7 + received / kFrameLength)) mismatches++;
+        }
+        ring.consume(run);
+      }
+    }
+  }
+  stream.end();
+
+  const Si446xRXStream::Counters &counters = stream.getCounters();
+  printf("%7lu %9u %8lu %8lu %6lu %6lu %6lu %9lu %8lu %10lu\n",
+    (unsigned long)dataRate, threshold, (unsigned long)interval, (unsigned long)consumeInterval,
+    (unsigned long)counters.frames, (unsigned long)counters.drains, (unsigned long)counters.bytes,
+    (unsigned long)counters.overflows, (unsigned long)counters.fifoErrors,
+    (unsigned long)(counters.overflows == 0 && counters.fifoErrors == 0 ? mismatches : 0));
+}
+
+int main()
+{
+  sim.attach();
+  irq.begin();
+
+  printf("%u frames of %u bytes, FIFO %u bytes, ring 1024 bytes\n\n", kFrames, kFrameLength, Si446x::kFIFOSize);
+  printf("   rate threshold interval  consume frames drains  bytes ring over fifo err mismatches\n");
+
+  static const uint32_t intervals[] = { 500, 2000, 5000, 10000, 15000, 20000 };
+  for (uint8_t idx = 0; idx < sizeof(intervals) / sizeof(intervals[0]); idx++) {
+    run(10000, 48, intervals[idx], 0);
+  }
+  printf("\n");
+  for (uint8_t idx = 0; idx < 4; idx++) {
+    run(100000, 48, intervals[idx], 0);
+  }
+  printf("\n");
+  run(10000, 32, 10000, 0);
+  run(10000, 56, 10000, 0);
+  printf("\n");
+  run(100000, 48, 500, 50000);
+  run(100000, 48, 500, 200000);
+  return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * Counts SPI library calls against bytes moved for the FIFO and command
+ * paths, comparing burst transfers with the old one-call-per-byte loop, and
+ * bus arbitrations (SPI transactions) with and without a Transaction scope.
+ * Bus time is estimated from the counts as calls * overhead + bytes * 8 / clock.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_spi.cpp si4x6x.cpp -o bench_spi
+ *   ./bench_spi [per-call overhead in us, default 2.0]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "si4x6x.h"
+
+static const double kClockMHz = 1.0;
+
+static double callOverheadUs = 2.0;
+
+template<typename F>
+static void measure(const char *name, F op)
+{
+  SPI.resetCounters();
+  op();
+
+  double us = SPI.calls * callOverheadUs + SPI.bytes * 8 / kClockMHz;
+  printf("%-24s %4u calls %4u bytes %6.2f bytes/call %3u txns %8.1f us\n",
+    name, SPI.calls, SPI.bytes, (double)SPI.bytes / SPI.calls, SPI.transactions, us);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1) callOverheadUs = atof(argv[1]);
+
+  Si446x radio(10, 26000000UL);
+  SPIDevice dev(10);
+  uint8_t buf[64] = { 0 };
+  Si446x::IRQStatus status;
+
+  measure("readRX(64) per-byte", [&] {
+    dev.select();
+    dev.write(0x77);
+    for (uint8_t i = 0; i < sizeof(buf); i++) buf[i] = dev.read();
+    dev.release();
+  });
+  measure("readRX(64) burst", [&] {
+    radio.readRX(buf, sizeof(buf));
+  });
+
+  measure("writeTX(64) per-byte", [&] {
+    dev.select();
+    dev.write(0x66);
+    for (uint8_t i = 0; i < sizeof(buf); i++) dev.write(buf[i]);
+    dev.release();
+  });
+  measure("writeTX(64) burst", [&] {
+    radio.writeTX(buf, sizeof(buf));
+  });
+
+  measure("getIntStatus() burst", [&] {
+    radio.getIntStatus(status);
+  });
+
+  // Status poll, FIFO level and FIFO read as done by the sketch's RX branch
+  measure("RX service pass", [&] {
+    radio.getIntStatus(status);
+    radio.getAvailableRX();
+    radio.readRX(buf, sizeof(buf));
+  });
+  measure("RX service pass scoped", [&] {
+    Si446x::Transaction bus(radio);
+    radio.getIntStatus(status);
+    radio.getAvailableRX();
+    radio.readRX(buf, sizeof(buf));
+  });
+  return 0;
+}
@@ -0,0 +1,299 @@
+/**
+ * Syscalls and latency per packet with the Linux spidev backend
+ * (spidev_transport.h), one CS frame per ioctl against frames batched
+ * until a read or the end of the bus transaction.
+ *
+ * Without a device the driver talks to a stand-in for the kernel that
+ * plays every SPI_IOC_MESSAGE into the simulated radio, charging a fixed
+ * cost per syscall and the bus time at 4 MHz to the virtual clock. nIRQ
+ * edges reach a GpiochipLine through a pipe as gpio_v2_line_events. A TX
+ * packet is a FIFO write and START_TX, then nIRQ and GET_INT_STATUS; an RX
+ * packet is nIRQ, GET_INT_STATUS and the FIFO read. Latency runs from the
+ * nIRQ edge to the status (TX) or the payload (RX) being in hand.
+ *
+ * Given a spidev node with MOSI wired to MISO, the TX sequence runs on the
+ * real bus instead: the loopback answers every CTS poll with 0xFF, so the
+ * driver never waits, and wall clock time per packet is reported.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. -DSI446X_TRANSPORT_HEADER='"spidev_transport.h"' -DSI446X_TRANSPORT=SpidevTransport host/bench_spidev.cpp si4x6x.cpp -o bench_spidev
+ *   ./bench_spidev [syscall cost in us, default 20]
+ *   ./bench_spidev /dev/spidevX.Y [packets, default 1000]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "si4x6x.h"
+#include "si446x_sim.h"
+
+static const int      kPinCS      = 10;
+static const int      kPinIRQ     = 2;
+static const uint32_t kSPIClock   = 4000000UL;
+static const uint8_t  kPackets    = 20;
+
+static SpidevBus    bus;
+static Si446xSim    sim(kPinCS, kPinIRQ);
+static Si446x       radio(kPinCS, 26000000UL, SpidevTransport(&bus));
+static GpiochipLine line;
+
+static uint32_t syscallCost = 20;
+static int      irqPipe[2];
+static uint32_t irqSeqno;
+static bool     irqPending;
+static bool     selected;
+
+static uint8_t  packet[16];
+
+/**
+ * The kernel's side of SPI_IOC_MESSAGE: CS low at the start of a frame,
+ * high after a segment with cs_change that is not the last one and after
+ * the last one without it.
+ */
+static int stubIoctl(int fd, unsigned long request, void *arg)
+{
+  if (_IOC_TYPE(request) != SPI_IOC_MAGIC || _IOC_NR(request) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  size_t count = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+  struct spi_ioc_transfer *segments = (struct spi_ioc_transfer *)arg;
+  int total = 0;
+
+  host::clockMicros += syscallCost;
+  for (size_t idx = 0; idx < count; idx++) {
+    struct spi_ioc_transfer &segment = segments[idx];
+    const uint8_t *tx = (const uint8_t *)(uintptr_t)segment.tx_buf;
+    uint8_t *rx = (uint8_t *)(uintptr_t)segment.rx_buf;
+
+    if (!selected) {
+      digitalWrite(kPinCS, LOW);
+      selected = true;
+    }
+    for (uint32_t pos = 0; pos < segment.len; pos++) {
+      uint8_t x = SPI.transfer(tx ? tx[pos] : 0);
+      if (rx) rx[pos] = x;
+    }
+    host::clockMicros += (uint32_t)(segment.len * 8000000ULL / segment.speed_hz);
+    total += segment.len;
+
+    bool last = (idx + 1 == count);
+    if (segment.cs_change != last) {
+      digitalWrite(kPinCS, HIGH);
+      selected = false;
+    }
+    host::clockMicros += segment.delay_usecs;
+  }
+  return total;
+}
+
+// The simulated nIRQ pin as the kernel would report it on a line request fd
+static void onIRQEdge()
+{
+  struct gpio_v2_line_event event;
+  memset(&event, 0, sizeof(event));
+  event.timestamp_ns = host::clockMicros * 1000ULL;
+  event.id = GPIO_V2_LINE_EVENT_FALLING_EDGE;
+  event.offset = kPinIRQ;
+  event.line_seqno = ++irqSeqno;
+  if (write(irqPipe[1], &event, sizeof(event)) != sizeof(event)) perror("irq pipe");
+  irqPending = true;
+}
+
+/**
+ * Lets the model run until nIRQ falls, then reads the edge as a blocking
+ * wait() would have woken up to it. The line's syscalls cost like the bus's.
+ */
+static uint32_t waitForIRQ()
+{
+  while (!irqPending) {
+    delayMicroseconds(10);
+    sim.update();
+  }
+  irqPending = false;
+
+  uint32_t edge = 0;
+  uint32_t syscalls = line.getCounters().syscalls;
+  if (line.wait(0, edge) <= 0) perror("irq line");
+  host::clockMicros += (line.getCounters().syscalls - syscalls) * syscallCost;
+  return edge;
+}
+
+static void sendPacket()
+{
+  Si446x::Transaction transaction(radio);
+  radio.writeTX(packet, sizeof(packet));
+  radio.startTX(0, sizeof(packet));
+}
+
+struct Cost {
+  uint32_t  ioctls;
+  uint32_t  segments;
+  uint32_t  calls;
+  uint32_t  bytes;
+  uint32_t  lineSyscalls;
+  uint32_t  latency;
+  uint32_t  maxLatency;
+};
+
+static void startCost(Cost &cost)
+{
+  memset(&cost, 0, sizeof(cost));
+  bus.resetCounters();
+  cost.lineSyscalls = line.getCounters().syscalls;
+}
+
+static void endCost(Cost &cost)
+{
+  const SpidevBus::Counters &counters = bus.getCounters();
+  cost.ioctls = counters.ioctls;
+  cost.segments = counters.segments;
+  cost.calls = counters.calls;
+  cost.bytes = counters.bytes;
+  cost.lineSyscalls = line.getCounters().syscalls - cost.lineSyscalls;
+}
+
+static Cost runTX()
+{
+  Cost cost;
+  startCost(cost);
+  for (uint8_t idx = 0; idx < kPackets; idx++) {
+    sendPacket();
+    uint32_t edge = waitForIRQ();
+    Si446x::IRQStatus status;
+    radio.getIntStatus(status);
+    uint32_t latency = micros() - edge;
+    cost.latency += latency;
+    if (latency > cost.maxLatency) cost.maxLatency = latency;
+  }
+  endCost(cost);
+  return cost;
+}
+
+static Cost runRX()
+{
+  radio.startRX(0, sizeof(packet), Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
+  delay(1);
+
+  Cost cost;
+  uint32_t received = 0;
+  startCost(cost);
+  for (uint8_t idx = 0; idx < kPackets; idx++) {
+    sim.receive(packet, sizeof(packet));
+    uint32_t edge = waitForIRQ();
+
+    Si446x::Transaction transaction(radio);
+    Si446x::IRQStatus status;
+    radio.getIntStatus(status);
+    if (status.getPHPending() & Si446x::kIntPacketRX) {
+      uint8_t data[sizeof(packet)];
+      radio.readRX(data, sizeof(data));
+      if (memcmp(data, packet, sizeof(packet)) == 0) received++;
+    }
+    uint32_t latency = micros() - edge;
+    cost.latency += latency;
+    if (latency > cost.maxLatency) cost.maxLatency = latency;
+  }
+  endCost(cost);
+
+  radio.changeState(Si446x::kStateReady);
+  if (received != kPackets) printf("RX: %lu of %u packets intact\n", (unsigned long)received, kPackets);
+  return cost;
+}
+
+static void print(const char *name, const Cost &cost)
+{
+  printf("%-24s %6.1f %6.1f %6.1f %6.1f %6.1f %7.1f %6lu\n", name, (double)cost.calls / kPackets,
+    (double)cost.ioctls / kPackets, (double)cost.segments / kPackets, (double)cost.lineSyscalls / kPackets,
+    (double)cost.bytes / kPackets, (double)cost.latency / kPackets, (unsigned long)cost.maxLatency);
+}
+
+static void simulate()
+{
+  if (pipe(irqPipe) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  line.adopt(irqPipe[0]);
+  attachInterrupt(digitalPinToInterrupt(kPinIRQ), onIRQEdge, FALLING);
+
+  bus.setIoctl(stubIoctl, kSPIClock);
+  sim.attach();
+  sim.useTypicalTimes();
+
+  radio.powerUpXTAL();
+  radio.setPHInterrupts(Si446x::kIntPacketSent | Si446x::kIntPacketRX);
+  radio.setIntControl(false, false, true);
+  radio.getIntStatus();
+
+  printf("%u packets of %u bytes each way, %lu us per syscall, SPI at %lu MHz\n\n", kPackets,
+    (unsigned)sizeof(packet), (unsigned long)syscallCost, (unsigned long)(kSPIClock / 1000000));
+  printf("%-24s %6s %6s %6s %6s %6s %7s %6s\n", "per packet", "calls", "ioctls", "segs", "irq", "bytes",
+    "lat us", "max");
+
+  static const struct {
+    const char          *name;
+    SpidevBus::Batching batching;
+    uint16_t            gap;
+  } modes[] = {
+    { "frame per ioctl",        SpidevBus::kBatchFrames,        0 },
+    { "batched",                SpidevBus::kBatchTransactions,  0 },
+    { "batched, 30 us gap",     SpidevBus::kBatchTransactions,  30 },
+  };
+  for (uint8_t idx = 0; idx < sizeof(modes) / sizeof(modes[0]); idx++) {
+    char name[40];
+    bus.setBatching(modes[idx].batching);
+    bus.setFrameGap(modes[idx].gap);
+    snprintf(name, sizeof(name), "TX %s", modes[idx].name);
+    print(name, runTX());
+    snprintf(name, sizeof(name), "RX %s", modes[idx].name);
+    print(name, runRX());
+  }
+  printf("\nSplit frames: %lu, failed ioctls: %lu, commands the model did not know: %lu\n",
+    (unsigned long)bus.getCounters().splitFrames, (unsigned long)bus.getCounters().errors,
+    (unsigned long)sim.getCounters().commandErrors);
+}
+
+static int loopback(const char *path, uint32_t packets)
+{
+  if (!bus.open(path, kSPIClock)) {
+    perror(path);
+    return 1;
+  }
+
+  printf("%s, %lu packets of %u bytes, SPI at %lu MHz\n\n", path, (unsigned long)packets,
+    (unsigned)sizeof(packet), (unsigned long)(kSPIClock / 1000000));
+  printf("%-16s %6s %6s %8s %8s\n", "per packet", "ioctls", "bytes", "mean us", "max us");
+
+  for (uint8_t batched = 0; batched < 2; batched++) {
+    bus.setBatching(batched ? SpidevBus::kBatchTransactions : SpidevBus::kBatchFrames);
+    bus.resetCounters();
+    uint32_t total = 0, worst = 0;
+    for (uint32_t idx = 0; idx < packets; idx++) {
+      uint32_t start = LinuxClock::micros();
+      sendPacket();
+      Si446x::IRQStatus status;
+      radio.getIntStatus(status);
+      uint32_t elapsed = LinuxClock::micros() - start;
+      total += elapsed;
+      if (elapsed > worst) worst = elapsed;
+    }
+    const SpidevBus::Counters &counters = bus.getCounters();
+    printf("%-16s %6.1f %6.1f %8.1f %8lu\n", batched ? "batched" : "frame per ioctl", (double)counters.ioctls / packets,
+      (double)counters.bytes / packets, (double)total / packets, (unsigned long)worst);
+    if (counters.errors) printf("%lu ioctls failed\n", (unsigned long)counters.errors);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  for (uint8_t idx = 0; idx < sizeof(packet); idx++) packet[idx] = idx;
+
+  if (argc > 1 && argv[1][0] == '/') {
+    return loopback(argv[1], (argc > 2) ? atol(argv[2]) : 1000);
+  }
+  if (argc > 1) syscallCost = atol(argv[1]);
+  simulate();
+  return 0;
+}
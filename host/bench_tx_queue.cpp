@@ -0,0 +1,113 @@
+/**
+ * Back-to-back transmission against the simulated radio. The sketch's old
+ * loop (poll GET_INT_STATUS every 10 ms, then WRITE_TX_FIFO and START_TX
+ * from READY) is compared with Si446xTXQueue, which preloads the next
+ * packet while the current one is on air and chains START_TX through
+ * TX_TUNE, at several main loop service intervals. The model reports the
+ * dead air between frames; the queue reports its own view of the gap
+ * (PACKET_SENT nIRQ edge to next START_TX) and packets per second. The
+ * model only raises nIRQ when the loop touches it, so here the driver's
+ * gap misses the service interval and the tuning time.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_tx_queue.cpp si4x6x.cpp si4x6x_irq.cpp si4x6x_stream.cpp -o bench_tx_queue
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+#include "si4x6x_stream.h"
+#include "si446x_sim.h"
+
+static const int kPinCS   = 10;
+static const int kPinIRQ  = 2;
+
+static const uint8_t kPackets = 50;
+
+static Si446xSim  sim(kPinCS, kPinIRQ);
+static Si446x     radio(kPinCS, 26000000UL);
+static Si446xIRQ  irq(radio, kPinIRQ);
+
+static void report(const char *name, uint32_t interval, uint8_t length, uint32_t elapsed, uint32_t driverGap)
+{
+  const Si446xSim::Counters &counters = sim.getCounters();
+  printf("%-10s %8lu %6u %7lu %8.1f %8lu %8lu %10lu\n", name, (unsigned long)interval, length,
+    (unsigned long)counters.packetsSent, counters.packetsSent * 1e6 / elapsed,
+    (unsigned long)(counters.txGaps ? counters.txGapSum / counters.txGaps : 0),
+    (unsigned long)counters.txGapMax, (unsigned long)driverGap);
+}
+
+static void runPolling(uint8_t length)
+{
+  radio.powerUpXTAL();
+  sim.setDataRate(10000);
+
+  uint8_t data[64];
+  for (uint8_t idx = 0; idx < length; idx++) data[idx] = idx;
+
+  uint32_t start = micros();
+  for (uint8_t packet = 0; packet < kPackets; packet++) {
+    if (packet > 0) {
+      for (uint16_t nTry = 100; nTry > 0; nTry--) {
+        Si446x::IRQStatus status;
+        radio.getIntStatus(status);
+        if (status.isPacketSentPending()) break;
+        delay(10);
+        sim.update();
+      }
+    }
+    radio.getIntStatus();
+    radio.writeTX(data, length);
+    radio.startTX(0, length);
+  }
+  while (sim.getCounters().packetsSent < kPackets) {
+    delayMicroseconds(100);
+    sim.update();
+  }
+  report("polling", 10000, length, micros() - start, 0);
+}
+
+static void runQueue(uint8_t length, uint32_t interval)
+{
+  static uint8_t storage[512];
+  Si446xRing ring(storage, sizeof(storage));
+
+  radio.powerUpXTAL();
+  sim.setDataRate(10000);
+
+  Si446xTXQueue queue(radio, ring, 0, &irq);
+  irq.onPacketHandler(Si446xTXQueue::onEvent, &queue);
+  irq.enable(Si446x::kIntPacketSent | Si446x::kIntTXFIFOAlmostEmpty);
+
+  uint8_t data[64];
+  for (uint8_t idx = 0; idx < length; idx++) data[idx] = idx;
+
+  uint32_t start = micros();
+  uint8_t queued = 0;
+  while (queued < kPackets || !queue.isIdle()) {
+    while (queued < kPackets && queue.send(data, length)) queued++;
+    delayMicroseconds(interval);
+    sim.update();
+    irq.service();
+  }
+  report("queue", interval, length, micros() - start, queue.getMeanGap());
+  printf("%-10s %8s %6s %7s %8lu (queue's own estimate, %lu preloaded)\n", "", "", "", "",
+    (unsigned long)queue.getPacketsPerSecond(), (unsigned long)queue.getCounters().preloaded);
+}
+
+int main()
+{
+  sim.attach();
+  irq.begin();
+
+  printf("%u packets per run, 10 kbps, 8 byte preamble\n\n", kPackets);
+  printf("mode       interval length packets  pkt/s  gap us  max gap driver gap\n");
+  static const uint8_t lengths[] = { 7, 32 };
+  for (uint8_t idx = 0; idx < 2; idx++) {
+    runPolling(lengths[idx]);
+    runQueue(lengths[idx], 100);
+    runQueue(lengths[idx], 1000);
+    runQueue(lengths[idx], 5000);
+    printf("\n");
+  }
+  return 0;
+}
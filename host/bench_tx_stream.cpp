@@ -0,0 +1,90 @@
+/**
+ * Sends long packets through Si446xTXStream against the simulated radio
+ * and sweeps how often the main loop gets to call Si446xIRQ::service().
+ * The FIFO drains at the air data rate while the loop is away, so long
+ * service intervals show up as underruns: counted by the stream from the
+ * chip's FIFO underflow interrupt, and by the simulator as packets and
+ * bytes the modulator missed. Returns nonzero if the stream's count and
+ * the simulator's disagree.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/bench_tx_stream.cpp si4x6x.cpp si4x6x_irq.cpp si4x6x_stream.cpp -o bench_tx_stream
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+#include "si4x6x_stream.h"
+#include "si446x_sim.h"
+
+static const int kPinCS   = 10;
+static const int kPinIRQ  = 2;
+
+static const uint16_t kPacketLength = 1000;
+static const uint8_t  kPackets      = 4;
+
+static Si446xSim  sim(kPinCS, kPinIRQ);
+static Si446x     radio(kPinCS, 26000000UL);
+static Si446xIRQ  irq(radio, kPinIRQ);
+
+// False if the stream's underruns disagree with the model's
+static bool run(uint32_t dataRate, uint8_t threshold, uint32_t interval)
+{
+  static uint8_t data[kPacketLength];
+  for (uint16_t idx = 0; idx < kPacketLength; idx++) data[idx] = idx;
+
+  radio.powerUpXTAL();     // resets the model and the driver's shadow copy
+  sim.setDataRate(dataRate);
+  irq.resetLatency();
+
+  Si446xTXStream stream(radio, threshold);
+  irq.onPacketHandler(Si446xTXStream::onEvent, &stream);
+  irq.onChip(Si446xTXStream::onChipEvent, &stream);
+  irq.enable(Si446x::kIntPacketSent | Si446x::kIntTXFIFOAlmostEmpty, 0, Si446x::kIntFIFOError);
+
+  uint32_t start = micros();
+  for (uint8_t packet = 0; packet < kPackets; packet++) {
+    if (!stream.begin(data, kPacketLength)) {
+      printf("begin failed\n");
+      return false;
+    }
+    while (stream.isBusy()) {
+      delayMicroseconds(interval);
+      sim.update();
+      irq.service();
+    }
+  }
+  uint32_t elapsed = micros() - start;
+
+  const Si446xTXStream::Counters &counters = stream.getCounters();
+  const Si446xSim::Counters &simCounters = sim.getCounters();
+  bool ok = counters.underruns == simCounters.txUnderruns;
+  printf("%7lu %9u %8lu %7lu %7lu %9lu %7lu %9lu %8lu  %s\n",
+    (unsigned long)dataRate, threshold, (unsigned long)interval,
+    (unsigned long)counters.packets, (unsigned long)counters.refills,
+    (unsigned long)counters.underruns, (unsigned long)simCounters.txUnderruns,
+    (unsigned long)simCounters.txUnderflows, (unsigned long)(elapsed / 1000), ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main()
+{
+  sim.attach();
+  irq.begin();
+
+  printf("%u packets of %u bytes, FIFO %u bytes\n\n", kPackets, kPacketLength, Si446x::kFIFOSize);
+  printf("   rate threshold interval packets refills underruns    sim sim bytes  time ms  check\n");
+
+  bool ok = true;
+  static const uint32_t intervals[] = { 500, 2000, 5000, 10000, 15000, 20000, 40000 };
+  for (uint8_t idx = 0; idx < sizeof(intervals) / sizeof(intervals[0]); idx++) {
+    ok = run(10000, 48, intervals[idx]) && ok;
+  }
+  printf("\n");
+  for (uint8_t idx = 0; idx < 4; idx++) {
+    ok = run(100000, 48, intervals[idx]) && ok;
+  }
+  printf("\n");
+  ok = run(10000, 32, 10000) && ok;
+  ok = run(10000, 56, 10000) && ok;
+  return ok ? 0 : 1;
+}
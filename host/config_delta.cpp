@@ -0,0 +1,280 @@
+/**
+ * Config delta compiler. Reads two WDS generated radio_config headers,
+ * replays their RADIO_CONFIGURATION_DATA_ARRAY streams into property maps
+ * and writes a header with the command stream that takes a powered radio
+ * from the first configuration to the second: no POWER_UP, only properties
+ * that change, merged into SET_PROPERTY runs of up to 12. Properties the
+ * first profile set but the second leaves alone are put back to the
+ * defaults listed in the headers. The stream is meant for
+ * Si446x::applyDelta().
+ *
+ *   g++ -std=c++17 -O2 host/config_delta.cpp -o config_delta
+ *   ./config_delta radio_config_Si4060.h radio_config_Si4362.h \
+ *       RADIO_DELTA_SI4060_TO_SI4362 > radio_delta_Si4060_to_Si4362.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> Command;
+typedef std::map<uint16_t, uint8_t> PropertyMap;
+
+enum {
+  kCmdPowerUp     = 0x02,
+  kCmdSetProperty = 0x11,
+  kMaxPropertyRun = 12,
+  kMaxBridge      = 3     // known values written to join two runs
+};
+
+struct Profile {
+  std::map<std::string, std::string>  defines;
+  std::vector<Command>  commands;
+  PropertyMap           properties;
+  PropertyMap           defaults;
+};
+
+static void fail(const std::string &message)
+{
+  fprintf(stderr, "config_delta: %s\n", message.c_str());
+  exit(1);
+}
+
+static std::string trim(const std::string &s)
+{
+  size_t a = s.find_first_not_of(" \t\r\n");
+  size_t b = s.find_last_not_of(" \t\r\n");
+  return (a == std::string::npos) ? std::string() : s.substr(a, b - a + 1);
+}
+
+static std::vector<std::string> splitList(const std::string &s)
+{
+  std::vector<std::string> items;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    item = trim(item);
+    if (!item.empty()) items.push_back(item);
+  }
+  return items;
+}
+
+static uint16_t parseHex(const std::string &line)
+{
+  return (uint16_t)strtoul(trim(line.substr(line.find(':') + 1)).c_str(), 0, 0);
+}
+
+// Expands macro names and appends the resulting bytes
+static void expand(const Profile &profile, const std::string &token, std::vector<uint8_t> &bytes, int depth = 0)
+{
+  if (isdigit((unsigned char)token[0])) {
+    bytes.push_back((uint8_t)strtoul(token.c_str(), 0, 0));
+    return;
+  }
+  std::map<std::string, std::string>::const_iterator it = profile.defines.find(token);
+  if (it == profile.defines.end() || depth > 8) fail("cannot expand " + token);
+  std::vector<std::string> items = splitList(it->second);
+  for (size_t idx = 0; idx < items.size(); idx++) {
+    expand(profile, items[idx], bytes, depth + 1);
+  }
+}
+
+static void applyProperties(const Command &cmd, PropertyMap &properties)
+{
+  uint16_t id = (cmd[1] << 8) | cmd[3];
+  for (size_t idx = 0; idx < cmd[2] && 4 + idx < cmd.size(); idx++) {
+    properties[id + idx] = cmd[4 + idx];
+  }
+}
+
+static Profile parseHeader(const char *path)
+{
+  std::ifstream in(path);
+  if (!in) fail(std::string("cannot open ") + path);
+
+  Profile profile;
+  std::string line, array;
+  uint16_t group = 0, start = 0;
+  bool inArray = false;
+
+  while (std::getline(in, line)) {
+    if (inArray) {
+      array += line;
+      if (line.find('}') != std::string::npos) inArray = false;
+      continue;
+    }
+    if (line.compare(0, 12, "// Group ID:") == 0) group = parseHex(line);
+    else if (line.compare(0, 12, "// Start ID:") == 0) start = parseHex(line);
+    else if (line.compare(0, 18, "// Default values:") == 0) {
+      std::vector<std::string> values = splitList(line.substr(line.find(':') + 1));
+      for (size_t idx = 0; idx < values.size(); idx++) {
+        profile.defaults[(group << 8) + start + idx] = (uint8_t)strtoul(values[idx].c_str(), 0, 0);
+      }
+    }
+    else if (line.compare(0, 8, "#define ") == 0) {
+      std::istringstream ss(line.substr(8));
+      std::string name;
+      ss >> name;
+      std::string value;
+      std::getline(ss, value);
+      if (name == "RADIO_CONFIGURATION_DATA_ARRAY") {
+        // The first definition is the real one, a later { 0 } is the fallback
+        if (array.empty()) {
+          array = value;
+          inArray = (value.find('}') == std::string::npos);
+        }
+      }
+      else profile.defines[name] = trim(value);
+    }
+  }
+
+  for (size_t pos; (pos = array.find_first_of("{}\\")) != std::string::npos; ) array[pos] = ' ';
+
+  std::vector<uint8_t> bytes;
+  std::vector<std::string> items = splitList(array);
+  for (size_t idx = 0; idx < items.size(); idx++) expand(profile, items[idx], bytes);
+
+  for (size_t pos = 0; pos < bytes.size() && bytes[pos] != 0; pos += bytes[pos] + 1) {
+    if (pos + 1 + bytes[pos] > bytes.size()) fail(std::string("truncated stream in ") + path);
+    Command cmd(bytes.begin() + pos + 1, bytes.begin() + pos + 1 + bytes[pos]);
+    if (cmd[0] == kCmdSetProperty) applyProperties(cmd, profile.properties);
+    profile.commands.push_back(cmd);
+  }
+  return profile;
+}
+
+/**
+ * Turns a set of property writes into SET_PROPERTY commands. Runs are joined
+ * over short gaps whose current value is known, as long as that is cheaper
+ * than the 4 byte header of another command.
+ */
+static void emitProperties(PropertyMap &writes, const PropertyMap &current, std::vector<Command> &out)
+{
+  PropertyMap::iterator it = writes.begin();
+  while (it != writes.end()) {
+    uint16_t id = it->first;
+    Command cmd;
+    cmd.push_back(kCmdSetProperty);
+    cmd.push_back(id >> 8);
+    cmd.push_back(0);
+    cmd.push_back(id & 0xFF);
+
+    uint16_t next = id;
+    while (it != writes.end() && cmd.size() - 4 < kMaxPropertyRun) {
+      uint16_t gap = it->first - next;
+      if ((it->first >> 8) != (id >> 8) || gap > kMaxBridge || cmd.size() - 4 + gap + 1 > kMaxPropertyRun) break;
+
+      bool known = true;
+      for (uint16_t fill = next; fill < it->first; fill++) {
+        if (current.find(fill) == current.end()) known = false;
+      }
+      if (!known) break;
+
+      for (uint16_t fill = next; fill < it->first; fill++) cmd.push_back(current.find(fill)->second);
+      cmd.push_back(it->second);
+      next = it->first + 1;
+      ++it;
+    }
+    cmd[2] = cmd.size() - 4;
+    out.push_back(cmd);
+  }
+  writes.clear();
+}
+
+static size_t streamBytes(const std::vector<Command> &commands)
+{
+  size_t total = 1;
+  for (size_t idx = 0; idx < commands.size(); idx++) total += 1 + commands[idx].size();
+  return total;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s <from.h> <to.h> <MACRO_NAME>\n", argv[0]);
+    return 2;
+  }
+
+  Profile from = parseHeader(argv[1]);
+  Profile to = parseHeader(argv[2]);
+
+  PropertyMap defaults = from.defaults;
+  for (PropertyMap::iterator it = to.defaults.begin(); it != to.defaults.end(); ++it) {
+    defaults[it->first] = it->second;
+  }
+
+  // Replay the target stream on top of the source state, in order, so that
+  // commands like IRCAL still see the properties they were generated for.
+  PropertyMap current = from.properties;
+  PropertyMap written, writes;
+  std::vector<Command> delta;
+
+  for (size_t idx = 0; idx < to.commands.size(); idx++) {
+    const Command &cmd = to.commands[idx];
+    if (cmd[0] == kCmdPowerUp) continue;
+
+    if (cmd[0] == kCmdSetProperty) {
+      PropertyMap values;
+      applyProperties(cmd, values);
+      for (PropertyMap::iterator it = values.begin(); it != values.end(); ++it) {
+        written[it->first] = it->second;
+        PropertyMap::iterator old = current.find(it->first);
+        if (old == current.end() || old->second != it->second) writes[it->first] = it->second;
+        current[it->first] = it->second;
+      }
+      continue;
+    }
+
+    bool shared = false;
+    for (size_t other = 0; other < from.commands.size(); other++) {
+      if (from.commands[other] == cmd) shared = true;
+    }
+    if (shared) continue;
+
+    emitProperties(writes, current, delta);
+    delta.push_back(cmd);
+  }
+
+  // Whatever only the source profile touched goes back to its default
+  std::vector<uint16_t> unknown;
+  for (PropertyMap::iterator it = from.properties.begin(); it != from.properties.end(); ++it) {
+    if (written.count(it->first)) continue;
+    PropertyMap::iterator def = defaults.find(it->first);
+    if (def == defaults.end()) {
+      unknown.push_back(it->first);
+      continue;
+    }
+    if (current[it->first] != def->second) {
+      writes[it->first] = def->second;
+      current[it->first] = def->second;
+    }
+  }
+  emitProperties(writes, current, delta);
+
+  std::string name = argv[3];
+  printf("/*! @file\n");
+  printf(" * Delta command stream from %s to %s, for Si446x::applyDelta().\n", argv[1], argv[2]);
+  printf(" * Generated by host/config_delta.cpp, do not edit.\n");
+  printf(" *\n");
+  printf(" * %zu commands, %zu bytes (full stream: %zu commands, %zu bytes)\n",
+    delta.size(), streamBytes(delta), to.commands.size(), streamBytes(to.commands));
+  for (size_t idx = 0; idx < unknown.size(); idx++) {
+    printf(" * WARNING: no default known for property 0x%04X, left unchanged\n", unknown[idx]);
+  }
+  printf(" */\n\n");
+  printf("#ifndef %s_H_\n#define %s_H_\n\n", name.c_str(), name.c_str());
+  printf("#define %s { \\\n", name.c_str());
+  for (size_t idx = 0; idx < delta.size(); idx++) {
+    printf("        0x%02X,", (unsigned)delta[idx].size());
+    for (size_t pos = 0; pos < delta[idx].size(); pos++) printf(" 0x%02X,", delta[idx][pos]);
+    printf(" \\\n");
+  }
+  printf("        0x00 \\\n }\n\n#endif\n");
+  return 0;
+}
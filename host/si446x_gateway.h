@@ -0,0 +1,404 @@
+/**
+ * Receive runtime for a Linux gateway with several radios, each on its own
+ * SpidevBus and GpiochipLine (spidev_transport.h).
+ *
+ * Every radio gets a service thread that sleeps in poll() on its nIRQ line.
+ * On an edge it reads the status and drains the RX FIFO with
+ * receivePackets(), as the sketch does, into the radio's Si446xQueue with
+ * the edge timestamp. With 64 bytes of FIFO a radio has to be read within
+ * a packet time or two, so service threads ask for SCHED_FIFO; without
+ * CAP_SYS_NICE they stay at normal priority and a busy core can make them
+ * late enough to overflow. CRC_ERROR does not say which packet failed, so the
+ * packets of a pass that saw it all go out with crcOK false; where the
+ * sketch flushes them, the decoder here can still check and repair them.
+ * A radio that is slow to raise CTS only holds up its own thread. A pool of dispatcher threads takes the packets off the
+ * queues, runs the decoder and hands what it accepts to every sink.
+ *
+ * Radio i is drained by dispatcher i % dispatchers, so each queue keeps one
+ * producer and one consumer and a radio's packets stay in order. A
+ * dispatcher with nothing to do sleeps on an eventfd, which a service
+ * thread only writes after the dispatcher has said it is going to sleep.
+ *
+ * Set the radios up (packet format, configureFastStatus() for the latched
+ * RSSI, startRX()) before start(); nothing else may touch them until
+ * stop(). Decoders and sinks are told which dispatcher calls them, so they
+ * can keep state per thread. Build with -pthread and the spidev options,
+ * with SI446X_RECORD_PAYLOAD covering the longest packet.
+ */
+#pragma once
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "si4x6x.h"
+#include "si4x6x_queue.h"
+#include "spidev_transport.h"
+
+class Si446xGateway {
+public:
+  enum {
+    kMaxRadios      = 16,
+    kMaxDispatchers = 8,
+    kMaxSinks       = 4,
+    kQueueSize      = 64,
+    kMaxPackets     = 8,    // per receivePackets() call
+    kDispatcherNice = 5,
+    kServicePriority = 10   // SCHED_FIFO
+  };
+
+  // May rewrite the packet in place, e.g. correct it; false drops it
+  typedef bool (*Decoder)(uint8_t dispatcher, uint8_t radio, Si446xPacketRecord &packet, void *context);
+  typedef void (*Sink)(uint8_t dispatcher, uint8_t radio, const Si446xPacketRecord &packet, void *context);
+
+  struct Counters {
+    uint32_t  events;       // nIRQ edges serviced
+    uint32_t  packets;      // read from the RX FIFO
+    uint32_t  crcErrors;    // of those, read in a pass that saw CRC_ERROR
+    uint32_t  fifoErrors;   // RX FIFO overflows, each costing what it held
+    uint32_t  queueDrops;   // read while the queue was full
+    uint32_t  rejected;     // dropped by the decoder
+    uint32_t  delivered;    // handed to the sinks
+    uint64_t  latencySum;   // nIRQ edge to the sinks being done, microseconds
+    uint32_t  latencyMax;
+  };
+
+  Si446xGateway(uint8_t dispatchers = 1)
+    : _radioCount(0), _dispatcherCount(dispatchers), _decoder(0), _decoderContext(0), _sinkCount(0),
+      _stopFD(-1), _running(false), _stopping(false)
+  {
+    if (_dispatcherCount < 1) _dispatcherCount = 1;
+    if (_dispatcherCount > kMaxDispatchers) _dispatcherCount = kMaxDispatchers;
+  }
+
+  ~Si446xGateway() {
+    stop();
+  }
+
+  // Returns the radio's index, -1 if full or running
+  int8_t add(Si446x &radio, GpiochipLine &line) {
+    if (_radioCount == kMaxRadios || _running) return -1;
+    Radio &entry = _radios[_radioCount];
+    entry.radio = &radio;
+    entry.line = &line;
+    entry.realtime = false;
+    entry.buffer.reset();
+    memset(&entry.counters, 0, sizeof(entry.counters));
+    return _radioCount++;
+  }
+
+  void setDecoder(Decoder decoder, void *context = 0) {
+    _decoder = decoder;
+    _decoderContext = context;
+  }
+
+  bool addSink(Sink sink, void *context = 0) {
+    if (_sinkCount == kMaxSinks) return false;
+    _sinks[_sinkCount].sink = sink;
+    _sinks[_sinkCount].context = context;
+    _sinkCount++;
+    return true;
+  }
+
+  uint8_t getCount() const { return _radioCount; }
+  uint8_t getDispatcherCount() const { return _dispatcherCount; }
+
+  /**
+   * Starts a service thread per radio and the dispatchers. False, with
+   * errno set, if an eventfd could not be made.
+   */
+  bool start() {
+    if (_running) return true;
+
+    _stopFD = eventfd(0, EFD_CLOEXEC);
+    if (_stopFD < 0) return false;
+    for (uint8_t idx = 0; idx < _dispatcherCount; idx++) {
+      _dispatchers[idx].wakeFD = eventfd(0, EFD_CLOEXEC);
+      _dispatchers[idx].sleeping = false;
+      if (_dispatchers[idx].wakeFD < 0) {
+        int error = errno;
+        closeFDs(idx);
+        errno = error;
+        return false;
+      }
+    }
+
+    _stopping = false;
+    _running = true;
+    for (uint8_t idx = 0; idx < _dispatcherCount; idx++) {
+      _dispatchers[idx].thread = std::thread(&Si446xGateway::dispatch, this, idx);
+    }
+    for (uint8_t idx = 0; idx < _radioCount; idx++) {
+      _radios[idx].thread = std::thread(&Si446xGateway::serviceRadio, this, idx);
+    }
+    return true;
+  }
+
+  // Stops the service threads, lets the dispatchers empty the queues and joins all
+  void stop() {
+    if (!_running) return;
+
+    __atomic_store_n(&_stopping, true, __ATOMIC_SEQ_CST);
+    signal(_stopFD);
+    for (uint8_t idx = 0; idx < _radioCount; idx++) _radios[idx].thread.join();
+    for (uint8_t idx = 0; idx < _dispatcherCount; idx++) signal(_dispatchers[idx].wakeFD);
+    for (uint8_t idx = 0; idx < _dispatcherCount; idx++) _dispatchers[idx].thread.join();
+
+    closeFDs(_dispatcherCount);
+    _running = false;
+  }
+
+  bool isRunning() const { return _running; }
+
+  // Whether the radio's service thread got SCHED_FIFO; valid once it has started
+  bool isRealtime(uint8_t index) const { return load(_radios[index].realtime); }
+
+  // A snapshot, consistent per field, that may be taken while running
+  Counters getCounters(uint8_t index) const {
+    const Counters &counters = _radios[index].counters;
+    Counters result;
+    result.events = load(counters.events);
+    result.packets = load(counters.packets);
+    result.crcErrors = load(counters.crcErrors);
+    result.fifoErrors = load(counters.fifoErrors);
+    result.queueDrops = load(counters.queueDrops);
+    result.rejected = load(counters.rejected);
+    result.delivered = load(counters.delivered);
+    result.latencySum = load(counters.latencySum);
+    result.latencyMax = load(counters.latencyMax);
+    return result;
+  }
+
+  // Only while stopped
+  void resetCounters() {
+    if (_running) return;
+    for (uint8_t idx = 0; idx < _radioCount; idx++) {
+      memset(&_radios[idx].counters, 0, sizeof(_radios[idx].counters));
+    }
+  }
+
+private:
+  // Each on its own cache lines: written by its threads only
+  struct alignas(64) Radio {
+    Radio() : radio(0), line(0), buffer(storage, sizeof(storage)) {}
+
+    Si446x            *radio;
+    GpiochipLine      *line;
+    uint8_t           storage[128];
+    Si446x::RXBuffer  buffer;
+    Si446xQueue<Si446xPacketRecord, kQueueSize> queue;
+    Counters          counters;
+    bool              realtime;
+    std::thread       thread;
+  };
+
+  struct alignas(64) Dispatcher {
+    int           wakeFD;
+    bool          sleeping;
+    std::thread   thread;
+  };
+
+  struct SinkEntry {
+    Sink  sink;
+    void  *context;
+  };
+
+  template<typename T>
+  static T load(const T &value) {
+    return __atomic_load_n(&value, __ATOMIC_RELAXED);
+  }
+
+  template<typename T>
+  static void add(T &value, T amount) {
+    __atomic_fetch_add(&value, amount, __ATOMIC_RELAXED);
+  }
+
+  static void signal(int fd) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) != sizeof(one)) perror("eventfd");
+  }
+
+  void closeFDs(uint8_t dispatchers) {
+    for (uint8_t idx = 0; idx < dispatchers; idx++) {
+      ::close(_dispatchers[idx].wakeFD);
+      _dispatchers[idx].wakeFD = -1;
+    }
+    ::close(_stopFD);
+    _stopFD = -1;
+  }
+
+  /**
+   * Service thread. nIRQ may already be low when it starts, with no edge to
+   * come, so the radio is serviced once before the first wait. CTS backoff
+   * sleeps are short; the default timer slack would stretch them.
+   */
+  void serviceRadio(uint8_t index) {
+    Radio &radio = _radios[index];
+    prctl(PR_SET_TIMERSLACK, 1UL);
+    struct sched_param param;
+    param.sched_priority = kServicePriority;
+    __atomic_store_n(&radio.realtime, pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0, __ATOMIC_RELAXED);
+    readPackets(index, LinuxClock::micros());
+
+    struct pollfd fds[2] = { { radio.line->getFD(), POLLIN, 0 }, { _stopFD, POLLIN, 0 } };
+    for (;;) {
+      int ready = poll(fds, 2, -1);
+      if (ready < 0 && errno == EINTR) continue;
+      if (ready < 0 || fds[1].revents) break;
+      if (!(fds[0].revents & POLLIN)) break;    // line gone
+
+      uint32_t edge;
+      if (radio.line->readEvents(edge) <= 0) break;
+      add(radio.counters.events, 1u);
+      readPackets(index, edge);
+    }
+  }
+
+  void readPackets(uint8_t index, uint32_t edge) {
+    Radio &radio = _radios[index];
+    Si446x &si = *radio.radio;
+    Si446x::Transaction transaction(si);
+
+    Si446x::IRQStatus status;
+    si.getIntStatus(status);
+    bool crcError = status.isCRCErrorPending();
+
+    /**
+     * Bytes lost to an overflow put fixed length packets out of step. Leaving
+     * RX drops the packet coming in, so after the flush the FIFO starts
+     * with the next one; CHANGE_STATE back to RX keeps the START_RX setup.
+     */
+    if (status.getChipPending() & Si446x::kIntFIFOError) {
+      add(radio.counters.fifoErrors, 1u);
+      si.changeState(Si446x::kStateReady);
+      si.flushRX();
+      si.changeState(Si446x::kStateRX);
+      radio.buffer.reset();
+      return;
+    }
+    if (!status.isPacketRXPending() && !crcError) return;
+
+    Si446x::FastStatus fastStatus;
+    si.getFastStatus(fastStatus);
+
+    Si446x::Packet packets[kMaxPackets];
+    uint8_t count;
+    bool queued = false;
+    do {
+      count = si.receivePackets(radio.buffer, packets, kMaxPackets);
+      add(radio.counters.packets, (uint32_t)count);
+
+      for (uint8_t pkt = 0; pkt < count; pkt++) {
+        // CRC_ERROR does not say which packet failed, so none of this pass
+        // is vouched for; the decoder gets to check each one
+        bool crcOK = !crcError;
+        if (!crcOK) add(radio.counters.crcErrors, 1u);
+
+        Si446xPacketRecord *record = radio.queue.reserve();
+        if (!record) {
+          add(radio.counters.queueDrops, 1u);
+          continue;
+        }
+        record->timestamp = edge;
+        record->rssi = fastStatus.getLatchedRSSI();
+        record->length = packets[pkt].length;
+        record->crcOK = crcOK;
+        memcpy(record->data, radio.buffer.data + packets[pkt].offset, record->getStoredLength());
+        radio.queue.commit();
+        queued = true;
+      }
+    } while (count == kMaxPackets);
+
+    if (queued) wake(_dispatchers[index % _dispatcherCount]);
+  }
+
+  // Pairs with the fence in dispatch(): either it sees the packet or we see it asleep
+  void wake(Dispatcher &dispatcher) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&dispatcher.sleeping, false, __ATOMIC_SEQ_CST)) signal(dispatcher.wakeFD);
+  }
+
+  /**
+   * Dispatcher thread, niced below the service threads: with fewer cores
+   * than threads, emptying a radio's FIFO before the next packet overflows
+   * it matters more than decoding the last one.
+   */
+  void dispatch(uint8_t index) {
+    Dispatcher &dispatcher = _dispatchers[index];
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), kDispatcherNice);
+    for (;;) {
+      if (drain(index)) continue;
+
+      __atomic_store_n(&dispatcher.sleeping, true, __ATOMIC_SEQ_CST);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (hasPackets(index)) {
+        __atomic_store_n(&dispatcher.sleeping, false, __ATOMIC_RELAXED);
+        continue;
+      }
+      if (__atomic_load_n(&_stopping, __ATOMIC_SEQ_CST)) break;
+
+      uint64_t count;
+      if (read(dispatcher.wakeFD, &count, sizeof(count)) < 0 && errno != EINTR) break;
+      __atomic_store_n(&dispatcher.sleeping, false, __ATOMIC_RELAXED);
+    }
+  }
+
+  bool hasPackets(uint8_t index) {
+    for (uint8_t idx = index; idx < _radioCount; idx += _dispatcherCount) {
+      if (!_radios[idx].queue.isEmpty()) return true;
+    }
+    return false;
+  }
+
+  // One pass over the dispatcher's radios, a few packets each so none waits long
+  bool drain(uint8_t index) {
+    bool any = false;
+    for (uint8_t idx = index; idx < _radioCount; idx += _dispatcherCount) {
+      Radio &radio = _radios[idx];
+      Si446xPacketRecord *record;
+      for (uint8_t taken = 0; taken < kMaxPackets && (record = radio.queue.front()) != 0; taken++) {
+        deliver(index, idx, *record);
+        radio.queue.release();
+        any = true;
+      }
+    }
+    return any;
+  }
+
+  void deliver(uint8_t index, uint8_t radio, Si446xPacketRecord &packet) {
+    Counters &counters = _radios[radio].counters;
+    if (_decoder && !_decoder(index, radio, packet, _decoderContext)) {
+      add(counters.rejected, 1u);
+      return;
+    }
+    for (uint8_t idx = 0; idx < _sinkCount; idx++) {
+      _sinks[idx].sink(index, radio, packet, _sinks[idx].context);
+    }
+
+    // Only this dispatcher writes the radio's latency
+    uint32_t latency = LinuxClock::micros() - packet.timestamp;
+    add(counters.delivered, 1u);
+    add(counters.latencySum, (uint64_t)latency);
+    if (latency > load(counters.latencyMax)) __atomic_store_n(&counters.latencyMax, latency, __ATOMIC_RELAXED);
+  }
+
+  Radio       _radios[kMaxRadios];
+  Dispatcher  _dispatchers[kMaxDispatchers];
+  SinkEntry   _sinks[kMaxSinks];
+  uint8_t     _radioCount;
+  uint8_t     _dispatcherCount;
+  Decoder     _decoder;
+  void        *_decoderContext;
+  uint8_t     _sinkCount;
+  int         _stopFD;
+  bool        _running;
+  bool        _stopping;
+};
@@ -0,0 +1,730 @@
+/**
+ * Behavioural model of an Si446x for host builds. Attached to the host SPI
+ * shim by its CS pin, it answers the command protocol the driver speaks
+ * and moves FIFO data on and off the air as virtual time advances.
+ *
+ * Time only moves when the model is touched: call update() from the host
+ * loop to let it catch up with host::clockMicros and fire nIRQ edges.
+ * setClock() gives it another time source, e.g. the wall clock for a
+ * model driven from its own thread.
+ * Frames handed to receive() go on the air back to back and reach the RX
+ * FIFO only while the model is in RX, from their first byte to the last.
+ *
+ * Preamble, sync and CRC take the air time PREAMBLE_TX_LENGTH,
+ * PREAMBLE_CONFIG, SYNC_CONFIG and PKT_CRC_CONFIG give them. PART_INFO
+ * answers with the part set by setPart(); the model does not refuse TX on
+ * a receive-only part or RX on a transmit-only one. Commands it does not
+ * know raise CMD_ERROR in the chip status.
+ */
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "Arduino.h"
+
+class Si446xSim : public host::Device {
+public:
+  enum {
+    kFIFOSize = 64
+  };
+
+  struct Counters {
+    uint32_t  packetsSent;
+    uint32_t  txUnderflows;     // bytes the modulator found missing
+    uint32_t  txUnderruns;      // packets that missed at least one
+    uint32_t  txOverflows;      // bytes written to a full TX FIFO
+    uint32_t  txGaps;           // packets started after an earlier one ended
+    uint32_t  txGapSum;         // dead air between them, microseconds
+    uint32_t  txGapMax;
+    uint32_t  packetsReceived;
+    uint32_t  rxMissed;         // frames that started while not in RX
+    uint32_t  rxOverflows;      // bytes that found the RX FIFO full
+    uint32_t  busyCommands;     // commands sent while CTS was low
+    uint32_t  commandErrors;    // unknown commands
+  };
+
+  Si446xSim(int pinCS, int pinIRQ = -1, uint32_t dataRate = 10000)
+    : _pinCS(pinCS), _pinIRQ(pinIRQ), _properties(0x10000, 0), _captureTX(false), _irqLevel(HIGH),
+      _commandTime(0), _typicalTimes(false), _ctsHeld(false), _part(0x4060), _clock(0)
+  {
+    setDataRate(dataRate);
+    reset();
+  }
+
+  void attach() {
+    host::attach(this, _pinCS);
+  }
+
+  // Where the model's time comes from, host::clockMicros if null. Times
+  // kept from the old clock mean nothing on the new one.
+  void setClock(uint32_t (*clock)()) {
+    _clock = clock;
+    _ctsTime = getTime();
+  }
+
+  void setDataRate(uint32_t dataRate) {
+    _byteTime = 8000000UL / dataRate;
+  }
+
+  /**
+   * Time CTS stays low after each command, microseconds. 0 (the default)
+   * answers every command at once.
+   */
+  void setCommandTime(uint32_t commandTime) {
+    _commandTime = commandTime;
+    _typicalTimes = false;
+  }
+
+  /**
+   * Holds CTS low for a per-command time in the range the datasheet and
+   * AN633 give (POWER_UP milliseconds, property access tens of
+   * microseconds), instead of setCommandTime()'s fixed one.
+   */
+  void useTypicalTimes(bool enable = true) {
+    _typicalTimes = enable;
+  }
+
+  /**
+   * Keeps CTS low until released, whatever was sent, so that the driver
+   * runs into its CTS timeout.
+   */
+  void holdCTS(bool hold) {
+    _ctsHeld = hold;
+  }
+
+  // Part number PART_INFO reports, 0x4060 by default
+  void setPart(uint16_t part) {
+    _part = part;
+  }
+
+  void reset() {
+    std::fill(_properties.begin(), _properties.end(), 0);
+    _properties[0x120B] = 0x30;   // PKT_TX_THRESHOLD
+    _properties[0x120C] = 0x30;   // PKT_RX_THRESHOLD
+    _properties[0x1000] = 0x08;   // PREAMBLE_TX_LENGTH
+    _properties[0x1004] = 0x21;   // PREAMBLE_CONFIG: length in bytes, 1010
+    _properties[0x1100] = 0x01;   // SYNC_CONFIG: 2 bytes
+    _properties[0x1101] = 0x2D;   // SYNC_BITS
+    _properties[0x1102] = 0xD4;
+    _txFIFO.clear();
+    _txFrame.clear();
+    _rxFIFO.clear();
+    _rxFrames.clear();
+    _phPend = _modemPend = _chipPend = 0;
+    _cmdError = _cmdErrorCommand = 0;
+    _state = kReady;
+    _txRemaining = 0;
+    _txTrailer = 0;
+    _txAlmostEmpty = true;
+    _rxAlmostFull = false;
+    _rxValidState = _rxInvalidState = 0;
+    _lastPacketLength = 0;
+    _frame = 0;
+    _replyLength = 0;
+    _txEnded = false;
+    _txStarved = false;
+    _ctsTime = getTime();
+    resetCounters();
+    updateIRQ();
+  }
+
+  void resetCounters() {
+    memset(&_counters, 0, sizeof(_counters));
+    _txEnded = false;
+  }
+
+  const Counters &getCounters() const { return _counters; }
+
+  uint8_t getProperty(uint16_t id) const { return _properties[id]; }
+
+  /**
+   * Puts a frame on the air after the ones already queued. data is what the
+   * RX FIFO will see, i.e. including a length field if PKT_LEN stores it
+   * there; preamble and sync just take their air time.
+   */
+  void receive(const uint8_t *data, uint16_t length, bool crcOK = true) {
+    update();
+    Frame frame;
+    frame.data.assign(data, data + length);
+    frame.crcOK = crcOK;
+    _rxFrames.push_back(frame);
+    if (_rxFrames.size() == 1) startFrame(getTime());
+  }
+
+  bool isReceiving() const { return !_rxFrames.empty(); }
+
+  // Keeps every transmitted frame for takeSent() while enabled
+  void captureTX(bool enable) {
+    _captureTX = enable;
+    _sentFrames.clear();
+  }
+
+  bool takeSent(std::vector<uint8_t> &frame) {
+    if (_sentFrames.empty()) return false;
+    frame = _sentFrames.front();
+    _sentFrames.pop_front();
+    return true;
+  }
+
+  /**
+   * Catches up with the virtual clock: clocks TX bytes out of the FIFO and
+   * RX bytes into it.
+   */
+  void update() {
+    uint32_t now = getTime();
+    updateRX(now);
+    while (_state == kTX && (int32_t)(now - _nextByteTime) >= 0) {
+      if (_txRemaining == 0) _txTrailer--;
+      else if (_txFIFO.empty()) {
+        _counters.txUnderflows++;
+        if (!_txStarved) _counters.txUnderruns++;
+        _txStarved = true;
+        _chipPend |= kChipFIFOError;
+        _txRemaining--;
+      }
+      else {
+        if (_captureTX) _txFrame.push_back(_txFIFO.front());
+        _txFIFO.pop_front();
+        _txRemaining--;
+      }
+      _nextByteTime += _byteTime;
+      checkTXThreshold();
+
+      if (_txRemaining == 0 && _txTrailer == 0) {
+        _counters.packetsSent++;
+        if (_captureTX) {
+          _sentFrames.push_back(_txFrame);
+          _txFrame.clear();
+        }
+        _lastTXEnd = _nextByteTime - _byteTime;
+        _txEnded = true;
+        _phPend |= kPHPacketSent;
+        _state = (_txCompleteState != 0) ? _txCompleteState : kReady;
+      }
+    }
+    updateIRQ();
+  }
+
+  // host::Device
+
+  void select() {
+    update();
+    _frame = 0;
+    _readPos = 0;
+    _cmdLength = 0;
+  }
+
+  uint8_t transfer(uint8_t x) {
+    uint8_t out = 0xFF;
+    if (_frame == 0) {
+      _cmd[_cmdLength++] = x;
+    }
+    else {
+      switch (_cmd[0]) {
+        case kCmdReadCmdBuff:
+          if (_frame == 1) out = isCTS() ? 0xFF : 0x00;
+          else if (!isCTS()) out = 0;
+          else out = (_readPos < _replyLength) ? _reply[_readPos++] : 0;
+          break;
+        case kCmdWriteTXFIFO:
+          if (_txFIFO.size() < kFIFOSize) {
+            _txFIFO.push_back(x);
+            checkTXThreshold();
+          }
+          else {
+            _counters.txOverflows++;
+            _chipPend |= kChipFIFOError;
+          }
+          break;
+        case kCmdFRRA:
+        case kCmdFRRB:
+        case kCmdFRRC:
+        case kCmdFRRD:
+          out = readFRR(frrIndex(_cmd[0]) + _frame - 1);
+          break;
+        case kCmdReadRXFIFO:
+          if (!_rxFIFO.empty()) {
+            out = _rxFIFO.front();
+            _rxFIFO.pop_front();
+            checkRXThreshold();
+          }
+          else {
+            out = 0;
+            _chipPend |= kChipFIFOError;
+          }
+          break;
+        default:
+          if (_cmdLength < sizeof(_cmd)) _cmd[_cmdLength++] = x;
+          break;
+      }
+    }
+    _frame++;
+    return out;
+  }
+
+  void release() {
+    switch (_cmd[0]) {
+      case kCmdReadCmdBuff:
+      case kCmdWriteTXFIFO:
+      case kCmdReadRXFIFO:
+      case kCmdFRRA:
+      case kCmdFRRB:
+      case kCmdFRRC:
+      case kCmdFRRD:
+        break;
+      default:
+        execute();
+        break;
+    }
+    updateIRQ();
+  }
+
+  bool readPin(int pin, int &level) {
+    if (pin != _pinIRQ) return false;
+    update();
+    level = _irqLevel;
+    return true;
+  }
+
+private:
+  enum {
+    kCmdNop           = 0x00,
+    kCmdPartInfo      = 0x01,
+    kCmdPowerUp       = 0x02,
+    kCmdFuncInfo      = 0x10,
+    kCmdSetProperty   = 0x11,
+    kCmdGetProperty   = 0x12,
+    kCmdGPIOPinCfg    = 0x13,
+    kCmdGetADCReading = 0x14,
+    kCmdFIFOInfo      = 0x15,
+    kCmdPacketInfo    = 0x16,
+    kCmdIRCal         = 0x17,
+    kCmdProtocolCfg   = 0x18,
+    kCmdGetIntStatus  = 0x20,
+    kCmdGetPHStatus   = 0x21,
+    kCmdGetModemStatus = 0x22,
+    kCmdGetChipStatus = 0x23,
+    kCmdStartTX       = 0x31,
+    kCmdStartRX       = 0x32,
+    kCmdRequestState  = 0x33,
+    kCmdChangeState   = 0x34,
+    kCmdReadCmdBuff   = 0x44,
+    kCmdFRRA          = 0x50,
+    kCmdFRRB          = 0x51,
+    kCmdFRRC          = 0x53,
+    kCmdFRRD          = 0x57,
+    kCmdWriteTXFIFO   = 0x66,
+    kCmdReadRXFIFO    = 0x77
+  };
+
+  enum {
+    kPHPacketSent       = 0x20,
+    kPHPacketRX         = 0x10,
+    kPHCRCError         = 0x08,
+    kPHTXAlmostEmpty    = 0x02,
+    kPHRXAlmostFull     = 0x01,
+    kChipFIFOError      = 0x20,
+    kChipCmdError       = 0x08
+  };
+
+  enum {
+    kReady  = 3,
+    kTXTune = 5,
+    kTX     = 7,
+    kRX     = 8
+  };
+
+  enum {
+    kTuneFromReady  = 120,    // START_TX to first preamble bit, microseconds
+    kTuneFromTXTune = 40
+  };
+
+  // ADC reading GET_ADC_READING returns for 25.0 C (the driver's scaling)
+  enum {
+    kTemperatureADC = (250 + 2970) * 256 / 568
+  };
+
+  /**
+   * CTS busy time in microseconds for useTypicalTimes(). Orders of
+   * magnitude rather than datasheet limits; a host that keeps up with
+   * these keeps up with the part.
+   */
+  static uint32_t typicalTime(uint8_t cmd) {
+    switch (cmd) {
+      case kCmdNop:             return 5;
+      case kCmdPowerUp:         return 15000;
+      case kCmdIRCal:           return 20000;
+      case kCmdGetADCReading:   return 700;
+      case kCmdGPIOPinCfg:      return 40;
+      case kCmdStartTX:         return 60;
+      case kCmdStartRX:         return 70;
+      case kCmdChangeState:     return 50;
+      case kCmdGetIntStatus:    return 30;
+      case kCmdRequestState:    return 15;
+      default:                  return 20;
+    }
+  }
+
+  static uint8_t frrIndex(uint8_t cmd) {
+    switch (cmd) {
+      case kCmdFRRB:  return 1;
+      case kCmdFRRC:  return 2;
+      case kCmdFRRD:  return 3;
+      default:        return 0;
+    }
+  }
+
+  struct Frame {
+    std::vector<uint8_t>  data;
+    bool  crcOK;
+  };
+
+  void setReply(const uint8_t *data, uint8_t length) {
+    memcpy(_reply, data, length);
+    _replyLength = length;
+  }
+
+  bool isCTS() const {
+    return !_ctsHeld && (int32_t)(getTime() - _ctsTime) >= 0;
+  }
+
+  void execute() {
+    const uint8_t *args = _cmd + 1;
+    uint8_t argsLength = _cmdLength - 1;
+    _replyLength = 0;
+    if (!isCTS()) _counters.busyCommands++;
+
+    switch (_cmd[0]) {
+      case kCmdNop:
+      case kCmdIRCal:
+      case kCmdProtocolCfg:
+        break;
+
+      case kCmdPowerUp:
+        reset();
+        break;
+
+      case kCmdPartInfo: {
+        uint8_t reply[8] = { 0x11, (uint8_t)(_part >> 8), (uint8_t)_part, 0x00, 0x00, 0x00, 0x00, 0x00 };
+        setReply(reply, sizeof(reply));
+        break;
+      }
+
+      case kCmdFuncInfo: {
+        uint8_t reply[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 };
+        setReply(reply, sizeof(reply));
+        break;
+      }
+
+      case kCmdGPIOPinCfg: {
+        // Echoes the pin settings; a 0 (no change) reads back as 0
+        uint8_t reply[7] = { 0 };
+        for (uint8_t idx = 0; idx < 7 && idx < argsLength; idx++) reply[idx] = args[idx];
+        setReply(reply, sizeof(reply));
+        break;
+      }
+
+      case kCmdGetADCReading: {
+        uint8_t reply[8] = { 0x00, 0x00, 0x00, 0x00, (uint8_t)(kTemperatureADC >> 8), (uint8_t)kTemperatureADC, 0x00, 0x00 };
+        setReply(reply, sizeof(reply));
+        break;
+      }
+
+      case kCmdSetProperty: {
+        uint16_t id = (args[0] << 8) | args[2];
+        for (uint8_t idx = 0; idx < args[1] && 3 + idx < argsLength; idx++) {
+          _properties[(uint16_t)(id + idx)] = args[3 + idx];
+        }
+        break;
+      }
+
+      case kCmdGetProperty: {
+        uint16_t id = (args[0] << 8) | args[2];
+        uint8_t reply[16];
+        for (uint8_t idx = 0; idx < args[1] && idx < sizeof(reply); idx++) {
+          reply[idx] = _properties[(uint16_t)(id + idx)];
+        }
+        setReply(reply, args[1]);
+        break;
+      }
+
+      case kCmdFIFOInfo: {
+        if (argsLength > 0 && (args[0] & 0x01)) {
+          _txFIFO.clear();
+          checkTXThreshold();
+        }
+        if (argsLength > 0 && (args[0] & 0x02)) {
+          _rxFIFO.clear();
+          checkRXThreshold();
+        }
+        uint8_t reply[2] = { (uint8_t)_rxFIFO.size(), (uint8_t)(kFIFOSize - _txFIFO.size()) };
+        setReply(reply, sizeof(reply));
+        break;
+      }
+
+      case kCmdPacketInfo: {
+        uint8_t reply[2] = { (uint8_t)(_lastPacketLength >> 8), (uint8_t)_lastPacketLength };
+        setReply(reply, sizeof(reply));
+        break;
+      }
+
+      case kCmdGetIntStatus: {
+        uint8_t reply[8];
+        fillIntStatus(reply);
+        setReply(reply, sizeof(reply));
+        // A zero bit in the argument clears that pending flag
+        _phPend    &= (argsLength > 0) ? args[0] : 0;
+        _modemPend &= (argsLength > 1) ? args[1] : 0;
+        _chipPend  &= (argsLength > 2) ? args[2] : 0;
+        break;
+      }
+
+      case kCmdGetPHStatus: {
+        uint8_t status[8];
+        fillIntStatus(status);
+        setReply(status + 2, 2);
+        _phPend &= (argsLength > 0) ? args[0] : 0;
+        break;
+      }
+
+      case kCmdGetModemStatus: {
+        uint8_t reply[8] = { _modemPend, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+        setReply(reply, sizeof(reply));
+        _modemPend &= (argsLength > 0) ? args[0] : 0;
+        break;
+      }
+
+      case kCmdGetChipStatus: {
+        uint8_t reply[4] = { _chipPend, _chipPend, _cmdError, _cmdErrorCommand };
+        setReply(reply, sizeof(reply));
+        _chipPend &= (argsLength > 0) ? args[0] : 0;
+        break;
+      }
+
+      case kCmdStartTX: {
+        _txCompleteState = (argsLength > 1) ? (args[1] >> 4) : 0;
+        _txRemaining = (argsLength > 3) ? ((args[2] << 8) | args[3]) & 0x1FFF : 0;
+        if (_txRemaining == 0) {
+          // Fixed length: field 1 length
+          _txRemaining = ((_properties[0x120D] & 0x1F) << 8) | _properties[0x120E];
+        }
+        if (_txRemaining == 0) break;
+
+        // Tuning from TX_TUNE skips the synthesizer lock
+        uint32_t airStart = getTime() + ((_state == kTXTune) ? kTuneFromTXTune : kTuneFromReady);
+        if (_txEnded) {
+          uint32_t gap = airStart - _lastTXEnd;
+          _counters.txGapSum += gap;
+          if (gap > _counters.txGapMax) _counters.txGapMax = gap;
+          _counters.txGaps++;
+        }
+        _state = kTX;
+        _txStarved = false;
+        _txTrailer = getCRCBytes();
+        _nextByteTime = airStart + getHeaderTime();
+        break;
+      }
+
+      case kCmdStartRX:
+        _rxValidState = (argsLength > 5) ? args[5] : 0;
+        _rxInvalidState = (argsLength > 6) ? args[6] : 0;
+        _state = kRX;
+        break;
+
+      case kCmdRequestState: {
+        uint8_t reply[2] = { _state, 0 };
+        setReply(reply, sizeof(reply));
+        break;
+      }
+
+      case kCmdChangeState:
+        if (argsLength > 0 && args[0] != 0) _state = (args[0] == kTX) ? _state : args[0];
+        break;
+
+      default:
+        _counters.commandErrors++;
+        _cmdError = 0x10;         // BAD_COMMAND
+        _cmdErrorCommand = _cmd[0];
+        _chipPend |= kChipCmdError;
+        break;
+    }
+
+    // After the switch, since POWER_UP resets the model
+    _ctsTime = getTime() + (_typicalTimes ? typicalTime(_cmd[0]) : _commandTime);
+  }
+
+  // Air time of preamble and sync word, microseconds
+  uint32_t getHeaderTime() const {
+    uint8_t preamble = _properties[0x1000];
+    uint32_t bits = preamble * ((_properties[0x1004] & 0x20) ? 8 : 4);
+    if (!(_properties[0x1100] & 0x80)) bits += ((_properties[0x1100] & 0x03) + 1) * 8;
+    return bits * _byteTime / 8;
+  }
+
+  uint8_t getCRCBytes() const {
+    switch (_properties[0x1200] & 0x0F) {
+      case 0:   return 0;
+      case 1:   return 1;
+      case 6:
+      case 7:
+      case 8:   return 4;
+      default:  return 2;
+    }
+  }
+
+  void fillIntStatus(uint8_t *reply) {
+    uint8_t phEnable    = (_properties[0x0100] & 0x01) ? _properties[0x0101] : 0;
+    uint8_t modemEnable = (_properties[0x0100] & 0x02) ? _properties[0x0102] : 0;
+    uint8_t chipEnable  = (_properties[0x0100] & 0x04) ? _properties[0x0103] : 0;
+
+    reply[0] = ((_phPend & phEnable) ? 0x01 : 0) | ((_modemPend & modemEnable) ? 0x02 : 0) |
+               ((_chipPend & chipEnable) ? 0x04 : 0);
+    reply[1] = reply[0];
+    reply[2] = _phPend;
+    reply[3] = ((kFIFOSize - _txFIFO.size() >= _properties[0x120B]) ? kPHTXAlmostEmpty : 0) |
+               ((_rxFIFO.size() >= _properties[0x120C]) ? kPHRXAlmostFull : 0);
+    reply[4] = _modemPend;
+    reply[5] = 0;
+    reply[6] = _chipPend;
+    reply[7] = 0;
+  }
+
+  uint8_t readFRR(uint8_t index) {
+    uint8_t status[8];
+    fillIntStatus(status);
+    switch (_properties[0x0200 + (index & 3)]) {
+      case 1:   return status[1];
+      case 2:   return status[0];
+      case 3:   return status[3];
+      case 4:   return status[2];
+      case 5:   return status[5];
+      case 6:   return status[4];
+      case 7:   return status[7];
+      case 8:   return status[6];
+      case 9:   return _state;
+      default:  return 0;
+    }
+  }
+
+  // TX FIFO almost empty latches when the free space reaches the threshold
+  void checkTXThreshold() {
+    bool almostEmpty = (kFIFOSize - _txFIFO.size() >= _properties[0x120B]);
+    if (almostEmpty && !_txAlmostEmpty) _phPend |= kPHTXAlmostEmpty;
+    _txAlmostEmpty = almostEmpty;
+  }
+
+  // RX FIFO almost full latches when the byte count reaches the threshold
+  void checkRXThreshold() {
+    bool almostFull = (_rxFIFO.size() >= _properties[0x120C]);
+    if (almostFull && !_rxAlmostFull) _phPend |= kPHRXAlmostFull;
+    _rxAlmostFull = almostFull;
+  }
+
+  void startFrame(uint32_t start) {
+    _rxPos = 0;
+    _rxLost = false;
+    _nextRXByteTime = start + getHeaderTime();
+  }
+
+  void updateRX(uint32_t now) {
+    while (!_rxFrames.empty() && (int32_t)(now - _nextRXByteTime) >= 0) {
+      Frame &frame = _rxFrames.front();
+      // Leaving RX drops the frame, as far as it got
+      if (_state != kRX) _rxLost = true;
+
+      if (!_rxLost) {
+        if (_rxFIFO.size() < kFIFOSize) {
+          _rxFIFO.push_back(frame.data[_rxPos]);
+          checkRXThreshold();
+        }
+        else {
+          _counters.rxOverflows++;
+          _chipPend |= kChipFIFOError;
+        }
+      }
+      _nextRXByteTime += _byteTime;
+
+      if (++_rxPos >= frame.data.size()) {
+        if (_rxLost) _counters.rxMissed++;
+        else {
+          _counters.packetsReceived++;
+          _lastPacketLength = frame.data.size();
+          uint8_t lengthConfig = _properties[0x1208];
+          if ((lengthConfig & 0x07) && (lengthConfig & 0x08)) {
+            _lastPacketLength -= (lengthConfig & 0x10) ? 2 : 1;
+          }
+          _phPend |= frame.crcOK ? kPHPacketRX : kPHCRCError;
+          uint8_t next = frame.crcOK ? _rxValidState : _rxInvalidState;
+          _state = (next != 0) ? next : kReady;
+        }
+        uint32_t end = _nextRXByteTime;
+        _rxFrames.pop_front();
+        if (!_rxFrames.empty()) startFrame(end);
+      }
+    }
+  }
+
+  uint32_t getTime() const {
+    return _clock ? _clock() : host::clockMicros;
+  }
+
+  void updateIRQ() {
+    uint8_t status[8];
+    fillIntStatus(status);
+    int level = (status[0] != 0) ? LOW : HIGH;
+    if (level == LOW && _irqLevel == HIGH) {
+      _irqLevel = level;
+      host::raiseInterrupt(_pinIRQ);
+    }
+    _irqLevel = level;
+  }
+
+  int       _pinCS;
+  int       _pinIRQ;
+
+  std::vector<uint8_t>  _properties;
+  std::deque<uint8_t>   _txFIFO;
+  std::deque<uint8_t>   _rxFIFO;
+  std::deque<Frame>     _rxFrames;
+  std::vector<uint8_t>  _txFrame;
+  std::deque<std::vector<uint8_t> > _sentFrames;
+  bool                  _captureTX;
+
+  uint8_t   _phPend, _modemPend, _chipPend;
+  uint8_t   _state;
+  uint8_t   _txCompleteState;
+  uint16_t  _txRemaining;
+  uint8_t   _txTrailer;       // CRC bytes still to go after the payload
+  uint32_t  _nextByteTime;
+  uint32_t  _byteTime;
+  bool      _txAlmostEmpty;
+  bool      _txEnded;
+  bool      _txStarved;       // current packet has underflowed
+  uint32_t  _lastTXEnd;
+  uint8_t   _rxValidState;
+  uint8_t   _rxInvalidState;
+  uint16_t  _rxPos;
+  uint16_t  _lastPacketLength;
+  uint32_t  _nextRXByteTime;
+  bool      _rxLost;
+  bool      _rxAlmostFull;
+  int       _irqLevel;
+  uint32_t  _commandTime;
+  bool      _typicalTimes;
+  bool      _ctsHeld;
+  uint32_t  _ctsTime;
+  uint16_t  _part;
+  uint8_t   _cmdError;
+  uint8_t   _cmdErrorCommand;
+
+  uint8_t   _cmd[16];
+  uint8_t   _cmdLength;
+  uint8_t   _frame;
+  uint8_t   _reply[16];
+  uint8_t   _replyLength;
+  uint8_t   _readPos;
+
+  Counters  _counters;
+  uint32_t  (*_clock)();
+};
@@ -0,0 +1,100 @@
+/**
+ * Host stand-in for a DMA SPI transport. transferAsync() hands the burst to
+ * a worker thread and returns; the worker moves the bytes through the SPI
+ * shim and sleeps out the bus time at the configured clock before calling
+ * back, leaving the CPU to the caller the way a DMA channel would. Bursts
+ * started with the synchronous transfer() take the same bus time on the
+ * calling thread. Single byte transfers are not timed.
+ *
+ * The caller must not touch the bus while a burst is in flight, as with
+ * real DMA; Si446x keeps CS low and its command queue blocked until then.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "si4x6x.h"
+
+class ThreadSPITransport : public SPITransport {
+public:
+  ThreadSPITransport(uint32_t clock = 1000000UL)
+    : _clock(clock), _pending(false), _stop(false), _worker(&ThreadSPITransport::run, this) {}
+
+  ~ThreadSPITransport() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _wake.notify_one();
+    _worker.join();
+  }
+
+  void transfer(uint8_t *buf, size_t n) {
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + getBusTime(n);
+    SPI.transfer(buf, n);
+    std::this_thread::sleep_until(end);
+  }
+
+  using SPITransport::transfer;
+
+  void transferAsync(const uint8_t *tx, uint8_t *rx, size_t n, Callback callback, void *context) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job.tx = tx;
+    _job.rx = rx;
+    _job.n = n;
+    _job.callback = callback;
+    _job.context = context;
+    _pending = true;
+    _wake.notify_one();
+  }
+
+private:
+  struct Job {
+    const uint8_t *tx;
+    uint8_t       *rx;
+    size_t        n;
+    Callback      callback;
+    void          *context;
+  };
+
+  std::chrono::microseconds getBusTime(size_t n) const {
+    return std::chrono::microseconds(n * 8000000ULL / _clock);
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+      _wake.wait(lock, [this]() { return _pending || _stop; });
+      if (_stop) break;
+      Job job = _job;
+      _pending = false;
+      lock.unlock();
+
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + getBusTime(job.n);
+      uint8_t chunk[64];
+      for (size_t done = 0; done < job.n; ) {
+        size_t len = (job.n - done < sizeof(chunk)) ? job.n - done : sizeof(chunk);
+        if (job.tx) memcpy(chunk, job.tx + done, len);
+        else memset(chunk, 0xFF, len);
+        SPI.transfer(chunk, len);
+        if (job.rx) memcpy(job.rx + done, chunk, len);
+        done += len;
+      }
+      std::this_thread::sleep_until(end);
+      job.callback(job.context);
+
+      lock.lock();
+    }
+  }
+
+  uint32_t                _clock;
+  std::mutex              _mutex;
+  std::condition_variable _wake;
+  Job                     _job;
+  bool                    _pending;
+  bool                    _stop;
+  std::thread             _worker;
+};
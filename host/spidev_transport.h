@@ -0,0 +1,465 @@
+/**
+ * Linux backend for gateways: the radio on /dev/spidevX.Y, nIRQ on a
+ * gpiochip line, time from CLOCK_MONOTONIC.
+ *
+ * SpidevBus collects CS frames as spi_ioc_transfer segments and sends as
+ * many as it can in one SPI_IOC_MESSAGE ioctl, letting the kernel toggle
+ * CS between them (cs_change). Writes are held back; a frame with reads is
+ * sent when it is released, so its buffers are filled by the time
+ * release() returns. read() and readStatus() need their byte at once: they
+ * send everything held so far together with their own frame, which they
+ * end. That makes a command frame and the CTS poll after it one ioctl, and
+ * a FIFO read with its opcode another. Held frames also go out when the
+ * bus transaction ends (Si446x::Transaction, or every API call).
+ *
+ * readStatus() always clocks in the n bytes after the status byte and
+ * drops them when the status is not ready; the Si446x ignores the extra
+ * clocks after a zero CTS byte. Traces (SI446X_TRACE) log the data of held
+ * reads before it has arrived.
+ *
+ * Build the driver against it with
+ *   -DSI446X_TRANSPORT_HEADER='"spidev_transport.h"' -DSI446X_TRANSPORT=SpidevTransport
+ *   -DSI446X_CLOCK=LinuxClock
+ * and open SpidevBus::getDefault(), or hand each radio its own bus.
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/gpio.h>
+#include <linux/spi/spidev.h>
+
+#include "si4x6x.h"
+
+class SpidevBus {
+public:
+  enum Batching {
+    kBatchFrames,         // one ioctl per CS frame
+    kBatchTransactions    // frames held until a read or the transaction end
+  };
+
+  struct Counters {
+    uint32_t  calls;        // transport calls that moved bytes
+    uint32_t  frames;       // CS frames
+    uint32_t  ioctls;       // SPI_IOC_MESSAGE calls
+    uint32_t  segments;     // spi_ioc_transfer entries sent
+    uint32_t  bytes;
+    uint32_t  splitFrames;  // frames that went on after read()/readStatus()
+    uint32_t  errors;       // failed ioctls, their reads return zeros
+  };
+
+  // Stand-in for ioctl(2), for running without a spidev device
+  typedef int (*IoctlFunction)(int fd, unsigned long request, void *arg);
+
+  SpidevBus()
+    : _fd(-1), _speed(0), _ioctl(&SpidevBus::systemIoctl), _batching(kBatchTransactions), _frameGap(0) {
+    reset();
+    resetCounters();
+  }
+
+  ~SpidevBus() {
+    close();
+  }
+
+  /**
+   * Opens a spidev node and sets mode 0, 8 bit words and the clock. Returns
+   * false, with errno set, if any of it fails.
+   */
+  bool open(const char *path, uint32_t speed = 1000000UL) {
+    close();
+    _fd = ::open(path, O_RDWR | O_CLOEXEC);
+    if (_fd < 0) return false;
+
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    if (ioctl(_fd, SPI_IOC_WR_MODE, &mode) < 0 || ioctl(_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+      ioctl(_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+      close();
+      return false;
+    }
+    _speed = speed;
+    return true;
+  }
+
+  // A stand-in's fd is not the bus's to close
+  void close() {
+    if (_fd >= 0 && _ioctl == &SpidevBus::systemIoctl) ::close(_fd);
+    _fd = -1;
+  }
+
+  /**
+   * Sends messages through fn instead of the kernel; speed is for the
+   * segments, fd is what fn is handed (e.g. to tell several stand-ins apart).
+   */
+  void setIoctl(IoctlFunction fn, uint32_t speed = 1000000UL, int fd = -1) {
+    close();
+    _ioctl = fn ? fn : &SpidevBus::systemIoctl;
+    _speed = speed;
+    _fd = fd;
+  }
+
+  void setBatching(Batching batching) {
+    flush();
+    _batching = batching;
+  }
+
+  /**
+   * Microseconds CS stays high between two frames of one message, e.g. to
+   * give the radio time to raise CTS before the poll batched behind a
+   * command.
+   */
+  void setFrameGap(uint16_t us) {
+    _frameGap = us;
+  }
+
+  const Counters &getCounters() const { return _counters; }
+
+  void resetCounters() {
+    memset(&_counters, 0, sizeof(_counters));
+  }
+
+  void select() {
+    _open = true;
+    _closed = false;
+    _frameReads = false;
+    _frameStart = _segmentCount;
+    _counters.frames++;
+  }
+
+  void release() {
+    if (_closed) {
+      _closed = false;
+      return;
+    }
+    _open = false;
+    if (_segmentCount > _frameStart) {
+      _segments[_segmentCount - 1].cs_change = 1;
+    }
+    if (_frameReads || _batching == kBatchFrames) flush();
+  }
+
+  /**
+   * Queues n bytes of the open frame. tx is copied, a null one sends 0xFF;
+   * rx, if not null, is filled by the time the frame is released.
+   */
+  void transfer(const uint8_t *tx, uint8_t *rx, size_t n) {
+    _counters.calls++;
+    reopen();
+    if (rx) _frameReads = true;
+    while (n > 0) {
+      size_t len = append(tx, rx, n);
+      if (tx) tx += len;
+      if (rx) rx += len;
+      n -= len;
+    }
+  }
+
+  uint8_t transfer(uint8_t x) {
+    return readStatus(x, 0, 0, x);
+  }
+
+  /**
+   * Clocks a status byte and n more, sends the message and ends the frame.
+   * rx gets the n bytes if the status byte equals ready.
+   */
+  uint8_t readStatus(uint8_t ready, uint8_t *rx, size_t n, uint8_t out = 0xFF) {
+    _counters.calls++;
+    reopen();
+    if (_bufferUsed + 1 + n > kBufferSize || _segmentCount == kMaxSegments) flush();
+    if (1 + n > kBufferSize) n = kBufferSize - 1;
+
+    size_t offset = _bufferUsed;
+    spi_ioc_transfer &segment = addSegment(1 + n);
+    _buffer[offset] = out;
+    memset(_buffer + offset + 1, 0xFF, n);
+    segment.rx_buf = segment.tx_buf;
+
+    _open = false;
+    flush();
+    _closed = true;
+
+    uint8_t status = _buffer[offset];
+    if (status == ready && n > 0) memcpy(rx, _buffer + offset + 1, n);
+    return status;
+  }
+
+  /**
+   * Sends every held segment in one ioctl. A frame still open keeps CS low
+   * into the next message.
+   */
+  void flush() {
+    if (_segmentCount == 0) return;
+
+    for (uint8_t idx = 0; idx + 1 < _segmentCount; idx++) {
+      if (_segments[idx].cs_change) _segments[idx].delay_usecs = _frameGap;
+    }
+    _segments[_segmentCount - 1].cs_change = _open ? 1 : 0;
+    _segments[_segmentCount - 1].delay_usecs = 0;
+
+    _counters.ioctls++;
+    _counters.segments += _segmentCount;
+    _counters.bytes += _bufferUsed;
+    if (_ioctl(_fd, SPI_IOC_MESSAGE(_segmentCount), _segments) < 0) {
+      _counters.errors++;
+      for (uint8_t idx = 0; idx < _segmentCount; idx++) {
+        if (_segments[idx].rx_buf) memset((void *)(uintptr_t)_segments[idx].rx_buf, 0, _segments[idx].len);
+      }
+    }
+    reset();
+  }
+
+  static SpidevBus &getDefault() {
+    static SpidevBus bus;
+    return bus;
+  }
+
+private:
+  enum {
+    kMaxSegments  = 32,
+    kBufferSize   = 512
+  };
+
+  static int systemIoctl(int fd, unsigned long request, void *arg) {
+    return ioctl(fd, request, arg);
+  }
+
+  void reset() {
+    _segmentCount = 0;
+    _frameStart = 0;
+    _bufferUsed = 0;
+  }
+
+  // Bytes after read()/readStatus() in the same frame start a new one
+  void reopen() {
+    if (!_closed) return;
+    _counters.splitFrames++;
+    select();
+    _counters.frames--;
+  }
+
+  spi_ioc_transfer &addSegment(size_t len) {
+    spi_ioc_transfer &segment = _segments[_segmentCount++];
+    memset(&segment, 0, sizeof(segment));
+    segment.tx_buf = (uintptr_t)(_buffer + _bufferUsed);
+    segment.len = len;
+    segment.speed_hz = _speed;
+    segment.bits_per_word = 8;
+    _bufferUsed += len;
+    return segment;
+  }
+
+  /**
+   * Adds up to n bytes to the message, extending the last segment when it is
+   * a write of the same frame. Returns how many fitted.
+   */
+  size_t append(const uint8_t *tx, uint8_t *rx, size_t n) {
+    if (_bufferUsed == kBufferSize || (_segmentCount == kMaxSegments && (rx || !canExtend()))) {
+      flush();
+      _frameStart = 0;
+    }
+    size_t len = (n < kBufferSize - _bufferUsed) ? n : kBufferSize - _bufferUsed;
+
+    uint8_t *data = _buffer + _bufferUsed;
+    if (tx) memcpy(data, tx, len);
+    else memset(data, 0xFF, len);
+
+    if (!rx && canExtend()) {
+      _segments[_segmentCount - 1].len += len;
+      _bufferUsed += len;
+    }
+    else {
+      addSegment(len).rx_buf = (uintptr_t)rx;
+    }
+    return len;
+  }
+
+  bool canExtend() const {
+    if (_segmentCount <= _frameStart) return false;
+    const spi_ioc_transfer &last = _segments[_segmentCount - 1];
+    return last.rx_buf == 0 && last.tx_buf + last.len == (uintptr_t)(_buffer + _bufferUsed);
+  }
+
+  int               _fd;
+  uint32_t          _speed;
+  IoctlFunction     _ioctl;
+  Batching          _batching;
+  uint16_t          _frameGap;
+
+  spi_ioc_transfer  _segments[kMaxSegments];
+  uint8_t           _segmentCount;
+  uint8_t           _frameStart;    // first segment of the open frame
+  uint8_t           _buffer[kBufferSize];
+  size_t            _bufferUsed;
+  bool              _open;          // between select() and release()
+  bool              _closed;        // frame ended early by read()/readStatus()
+  bool              _frameReads;
+  Counters          _counters;
+};
+
+/**
+ * Transport policy over a SpidevBus; the chip select pin is the bus's own.
+ * A null bus means SpidevBus::getDefault(). transferAsync() only queues
+ * the burst and calls back, its reply arrives at release() like any other.
+ */
+class SpidevTransport {
+public:
+  typedef void (*Callback)(void *context);
+
+  SpidevTransport(SpidevBus *bus = 0)
+    : _bus(bus ? bus : &SpidevBus::getDefault()) {}
+
+  void beginTransaction() {}
+  void endTransaction() { _bus->flush(); }
+  void select(int pinCS) { _bus->select(); }
+  void release(int pinCS) { _bus->release(); }
+
+  uint8_t transfer(uint8_t x) { return _bus->transfer(x); }
+  void transfer(uint8_t *buf, size_t n) { _bus->transfer(buf, buf, n); }
+  void transferStaged(const uint8_t *tx, uint8_t *rx, size_t n) { _bus->transfer(tx, rx, n); }
+  void transfer_P(const uint8_t *tx, size_t n) { _bus->transfer(tx, 0, n); }
+  void write(uint8_t x) { _bus->transfer(&x, 0, 1); }
+  uint8_t readStatus(uint8_t ready, uint8_t *rx, size_t n) { return _bus->readStatus(ready, rx, n); }
+
+  void transferAsync(const uint8_t *tx, uint8_t *rx, size_t n, Callback callback, void *context) {
+    _bus->transfer(tx, rx, n);
+    callback(context);
+  }
+
+  SpidevBus &getBus() const { return *_bus; }
+
+private:
+  SpidevBus *_bus;
+};
+
+/**
+ * CLOCK_MONOTONIC, the clock gpiochip edge timestamps use by default.
+ * Short delays (the driver's CS hold times, early CTS backoff) spin: a
+ * nanosleep() would add the thread's timer slack, 50 us by default.
+ */
+struct LinuxClock {
+  enum { kSpinLimit = 20 };
+
+  static uint32_t micros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000000ULL + now.tv_nsec / 1000);
+  }
+
+  static void delayMicroseconds(unsigned int us) {
+    if (us <= kSpinLimit) {
+      uint32_t start = micros();
+      while (micros() - start < us) {}
+      return;
+    }
+    struct timespec pause = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&pause, 0);
+  }
+};
+
+/**
+ * nIRQ as a gpiochip line requested for falling edge events (GPIO uAPI v2).
+ * wait() blocks in poll() and returns the kernel's timestamp of the first
+ * edge, in LinuxClock microseconds; edges that queued up meanwhile are
+ * read in the same call and counted.
+ */
+class GpiochipLine {
+public:
+  struct Counters {
+    uint32_t  syscalls;   // poll() and read() calls
+    uint32_t  events;     // edges read
+  };
+
+  GpiochipLine() : _fd(-1) {
+    memset(&_counters, 0, sizeof(_counters));
+  }
+
+  ~GpiochipLine() {
+    close();
+  }
+
+  // Requests line offset of a chip such as /dev/gpiochip0, pulled up
+  bool open(const char *chip, uint32_t offset, const char *consumer = "si446x") {
+    close();
+    int chipFD = ::open(chip, O_RDONLY | O_CLOEXEC);
+    if (chipFD < 0) return false;
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = offset;
+    request.num_lines = 1;
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+    snprintf(request.consumer, sizeof(request.consumer), "%s", consumer);
+
+    int result = ioctl(chipFD, GPIO_V2_GET_LINE_IOCTL, &request);
+    ::close(chipFD);
+    if (result < 0) return false;
+    _fd = request.fd;
+    return true;
+  }
+
+  // Takes over a line request fd, or anything that delivers gpio_v2_line_events
+  void adopt(int fd) {
+    close();
+    _fd = fd;
+  }
+
+  void close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+  }
+
+  // For callers that poll several lines themselves
+  int getFD() const { return _fd; }
+
+  /**
+   * Waits up to timeout ms (-1 forever, 0 not at all) for a falling edge.
+   * Returns 1 with eventTime set, 0 on timeout, -1 on error.
+   */
+  int wait(int timeout, uint32_t &eventTime) {
+    struct pollfd fds = { _fd, POLLIN, 0 };
+    _counters.syscalls++;
+    int ready = poll(&fds, 1, timeout);
+    if (ready <= 0) return ready;
+    return readEvents(eventTime);
+  }
+
+  /**
+   * Reads the edges queued on the line, for callers that polled getFD()
+   * themselves; blocks if there are none. Returns 1 with eventTime set to
+   * the first, -1 on error.
+   */
+  int readEvents(uint32_t &eventTime) {
+    struct gpio_v2_line_event events[kMaxEvents];
+    _counters.syscalls++;
+    ssize_t length = read(_fd, events, sizeof(events));
+    if (length < (ssize_t)sizeof(events[0])) return -1;
+
+    _counters.events += length / sizeof(events[0]);
+    eventTime = (uint32_t)(events[0].timestamp_ns / 1000);
+    return 1;
+  }
+
+  // Current level, HIGH or LOW; -1 on error
+  int getLevel() {
+    struct gpio_v2_line_values values;
+    values.mask = 1;
+    values.bits = 0;
+    _counters.syscalls++;
+    if (ioctl(_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) return -1;
+    return (values.bits & 1) ? HIGH : LOW;
+  }
+
+  const Counters &getCounters() const { return _counters; }
+
+private:
+  enum { kMaxEvents = 16 };
+
+  int       _fd;
+  Counters  _counters;
+};
@@ -0,0 +1,116 @@
+/**
+ * Decoder for the binary counters the sketch's "stats" console command
+ * sends (Si446x::packStatsHeader()/packStats()). Given a file captured
+ * from the serial port it prints that; without one it runs a short TX
+ * workload against the simulated radio with typical CTS times, dumps the
+ * driver's counters the same way and decodes them, checking that the
+ * per-opcode byte counts add up to the bytes on the bus.
+ *
+ *   g++ -std=c++17 -O2 -DSI446X_STATS=1 -Ihost -I. host/stats_dump.cpp si4x6x.cpp -o stats_dump
+ */
+#include <stdio.h>
+
+#include <vector>
+
+#include "si4x6x.h"
+#include "si446x_sim.h"
+#include "radio_config_Si4060.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+static const int kPinCS = 10;
+
+static uint32_t readLE(const uint8_t *data, uint8_t size)
+{
+  uint32_t value = 0;
+  for (uint8_t idx = 0; idx < size; idx++) value |= (uint32_t)data[idx] << (8 * idx);
+  return value;
+}
+
+/**
+ * Prints one dump; returns the total bytes it accounts for, or -1 if it
+ * is not a dump this decoder knows.
+ */
+static long decode(const uint8_t *data, size_t length)
+{
+  if (length < 5 || data[0] != 'S' || data[1] != 'I' || data[2] != Si446x::Stats::kVersion) return -1;
+  uint8_t buckets = data[3];
+  uint8_t records = data[4];
+  size_t recordSize = 17 + 2 * buckets;
+  if (length < 5 + records * recordSize) return -1;
+
+  printf("op  calls tmo    polls      out       in  CTS wait, log2 us buckets\n");
+  long total = 0;
+  for (uint8_t record = 0; record < records; record++) {
+    const uint8_t *p = data + 5 + record * recordSize;
+    uint32_t bytesOut = readLE(p + 9, 4), bytesIn = readLE(p + 13, 4);
+    printf("%02X %6lu %3lu %8lu %8lu %8lu ", p[0], (unsigned long)readLE(p + 1, 2), (unsigned long)readLE(p + 3, 2),
+      (unsigned long)readLE(p + 5, 4), (unsigned long)bytesOut, (unsigned long)bytesIn);
+    for (uint8_t bucket = 0; bucket < buckets; bucket++) printf(" %lu", (unsigned long)readLE(p + 17 + 2 * bucket, 2));
+    printf("\n");
+    total += bytesOut + bytesIn;
+  }
+  return total;
+}
+
+static void workload(Si446x &radio, Si446xSim &sim)
+{
+  radio.configure_P(radioConfig);
+  radio.setPreambleLength(0x0A);
+
+  uint8_t packet[16];
+  for (uint8_t idx = 0; idx < sizeof(packet); idx++) packet[idx] = idx;
+
+  for (uint8_t round = 0; round < 20; round++) {
+    Si446x::IRQStatus status;
+    radio.getIntStatus(status);
+    radio.writeTX(packet, sizeof(packet));
+    radio.startTX(0, sizeof(packet));
+    while (radio.getState() == Si446x::kStateTX) {
+      delay(1);
+      sim.update();
+    }
+  }
+  radio.getTemperature();
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<uint8_t> dump;
+
+  if (argc > 1) {
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+      perror(argv[1]);
+      return 1;
+    }
+    int c;
+    while ((c = fgetc(file)) != EOF) dump.push_back(c);
+    fclose(file);
+    if (decode(dump.data(), dump.size()) < 0) {
+      fprintf(stderr, "%s: not a stats dump\n", argv[1]);
+      return 1;
+    }
+    return 0;
+  }
+
+  Si446xSim sim(kPinCS);
+  Si446x radio(kPinCS, 26000000UL);
+  sim.attach();
+  sim.useTypicalTimes();
+
+  SPI.resetCounters();
+  workload(radio, sim);
+
+  uint8_t record[Si446x::Stats::kRecordSize];
+  dump.insert(dump.end(), record, record + radio.packStatsHeader(record));
+  for (uint8_t idx = 0; idx < Si446x::Stats::kCommands; idx++) {
+    uint8_t length = radio.packStats(idx, record);
+    dump.insert(dump.end(), record, record + length);
+  }
+
+  printf("%lu byte dump\n\n", (unsigned long)dump.size());
+  long total = decode(dump.data(), dump.size());
+  printf("\nBytes accounted for: %ld of %lu on the bus\n", total, (unsigned long)SPI.bytes);
+  return (total == (long)SPI.bytes) ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/**
+ * Command queue checks against the simulated radio. A completion callback
+ * that queues another command gets the slot it is called from once the
+ * queue has wrapped; the caller blocked on the first command must still
+ * see it succeed. With a variable packet length that is not stored in the
+ * FIFO, receivePackets() must return a lone packet whole, and refuse two
+ * packets of different lengths drained together rather than cut them at
+ * the last one's length. A FIFO burst whose transport never calls back
+ * must fail after the CTS timeout and give CS back. Returns nonzero if a
+ * check fails.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/test_commands.cpp si4x6x.cpp -o test_commands
+ */
+#include <stdio.h>
+
+#include "si4x6x.h"
+#include "si446x_sim.h"
+
+static const int      kPinCS      = 10;
+static const uint32_t kCTSTimeout = 200000UL;   // the driver's, microseconds
+
+static Si446xSim  sim(kPinCS);
+static Si446x     radio(kPinCS, 26000000UL);
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+  printf("%-48s %s\n", what, condition ? "ok" : "FAILED");
+  if (!condition) failures++;
+}
+
+struct Chain {
+  Si446x::IRQStatus     status;
+  Si446x::CommandHandle next;
+  bool                  called;
+};
+
+// PKT_LEN: variable length into field 2, not stored in the FIFO
+static uint8_t lengthNotInFIFO[] = { 5, 0x11, 0x12, 0x01, 0x08, 0x02, 0 };
+
+static uint8_t frameA[5] = { 0xA0, 0xA1, 0xA2, 0xA3, 0xA4 };
+static uint8_t frameB[9] = { 0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8 };
+
+// Starts bursts and never reports them done, like a DMA channel that hung
+class StuckTransport : public SPITransport {
+public:
+  void transferAsync(const uint8_t *tx, uint8_t *rx, size_t n, Callback callback, void *context) {}
+};
+
+static StuckTransport stuckTransport;
+
+// Lets the model take every frame handed to it
+static void airtime()
+{
+  while (sim.isReceiving()) {
+    delayMicroseconds(100);
+    sim.update();
+  }
+}
+
+static void onFirst(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Chain &chain = *(Chain *)context;
+  chain.called = true;
+  chain.next = radio.getIntStatusAsync(chain.status);
+}
+
+int main()
+{
+  sim.attach();
+  sim.setCommandTime(200);
+  radio.powerUpXTAL();
+  delay(1);
+
+  Chain chain = { {}, 0, false };
+  Si446x::IRQStatus status[3];
+  // Fill the queue so the chained command wraps into the first slot
+  Si446x::CommandHandle first = radio.changeStateAsync(Si446x::kStateReady, onFirst, &chain);
+  for (uint8_t idx = 0; idx < 3; idx++) radio.getIntStatusAsync(status[idx]);
+
+  check(radio.waitForCommand(first), "waiter sees the first command succeed");
+  check(chain.called && chain.next != 0, "callback queued a command");
+  check(radio.waitForCommand(chain.next), "chained command succeeds");
+
+  radio.configure(lengthNotInFIFO);
+  radio.startRX(0, 0, Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
+  uint8_t storage[32];
+  Si446x::RXBuffer buffer(storage, sizeof(storage));
+  Si446x::Packet packets[4];
+
+  sim.receive(frameA, sizeof(frameA));
+  airtime();
+  uint8_t count = radio.receivePackets(buffer, packets, 4);
+  check(count == 1 && packets[0].length == sizeof(frameA) &&
+    memcmp(buffer.data + packets[0].offset, frameA, sizeof(frameA)) == 0, "lone packet comes out whole");
+
+  sim.receive(frameA, sizeof(frameA));
+  sim.receive(frameB, sizeof(frameB));
+  airtime();
+  check(radio.receivePackets(buffer, packets, 4) == 0, "two packets of different lengths are refused");
+  radio.waitForIdle();
+  check(radio.getAvailableRX() == 0, "and flushed from the FIFO");
+
+  sim.receive(frameB, sizeof(frameB));
+  airtime();
+  count = radio.receivePackets(buffer, packets, 4);
+  check(count == 1 && packets[0].length == sizeof(frameB) &&
+    memcmp(buffer.data + packets[0].offset, frameB, sizeof(frameB)) == 0, "the next one comes out whole");
+
+  Si446x stuck(kPinCS, 26000000UL, &stuckTransport);
+  uint32_t start = micros();
+  Si446x::CommandHandle burst = stuck.writeTXAsync(frameA, sizeof(frameA));
+  check(!stuck.waitForCommand(burst), "burst that never completes fails");
+  check(micros() - start >= kCTSTimeout, "after the CTS timeout");
+  check(digitalRead(kPinCS) == HIGH, "with CS released");
+  check(radio.getState() == Si446x::kStateRX, "and the bus usable again");
+
+  if (failures) printf("%d check(s) failed\n", failures);
+  else printf("All checks passed\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * Property cache checks against the simulated radio: a commit() that runs
+ * into a CTS timeout must leave every write it could not send for the next
+ * commit(), for blocking writes as well as queued ones, and for properties
+ * that did not fit in the shadow table. The sketch's WDS configuration,
+ * replayed with a shadow table sized for it, must not write any property
+ * the second time, except the ones the stream itself sets to one value for
+ * IR calibration and to another after it. Returns nonzero if a check fails.
+ *
+ *   g++ -std=c++17 -O2 -Ihost -I. host/test_properties.cpp si4x6x.cpp -o test_properties
+ */
+#include <stdio.h>
+#include <set>
+
+#include "si4x6x.h"
+#include "si446x_sim.h"
+#include "radio_config_Si4362.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+static const int kPinCS = 10;
+
+// More than the small shadow table holds, so the rest goes to the pending list
+static const uint16_t kFirst  = 0x2000;
+static const uint8_t  kCount  = 90;
+static const uint8_t  kRun    = 12;
+
+static const uint8_t kSmallTable = 64;
+static const uint8_t kLargeTable = 255;
+static Si446x::PropertyEntry shadowTable[kLargeTable];
+
+// The simulated radio, noting the first and last property of every
+// SET_PROPERTY frame
+class PropertyLog : public Si446xSim {
+public:
+  PropertyLog(int pinCS) : Si446xSim(pinCS) {}
+
+  std::vector<std::pair<uint16_t, uint16_t> > runs;
+
+  void select() {
+    _frame.clear();
+    Si446xSim::select();
+  }
+
+  uint8_t transfer(uint8_t x) {
+    _frame.push_back(x);
+    return Si446xSim::transfer(x);
+  }
+
+  void release() {
+    if (_frame.size() >= 4 && _frame[0] == 0x11 && _frame[2] > 0) {
+      uint16_t id = (_frame[1] << 8) | _frame[3];
+      runs.push_back(std::make_pair(id, id + _frame[2] - 1));
+    }
+    Si446xSim::release();
+  }
+
+private:
+  std::vector<uint8_t> _frame;
+};
+
+static PropertyLog  sim(kPinCS);
+static Si446x     radio(kPinCS, 26000000UL);
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+  printf("%-48s %s\n", what, condition ? "ok" : "FAILED");
+  if (!condition) failures++;
+}
+
+static uint8_t valueOf(uint16_t id)
+{
+  return (uint8_t)(id * 2 + 1);
+}
+
+// SET_PROPERTY commands for kFirst.. in configure() format
+static void buildStream(uint8_t *stream)
+{
+  for (uint8_t start = 0; start < kCount; start += kRun) {
+    uint8_t count = (kCount - start < kRun) ? kCount - start : kRun;
+    *stream++ = 4 + count;
+    *stream++ = 0x11;     // SET_PROPERTY
+    *stream++ = (uint8_t)(kFirst >> 8);
+    *stream++ = count;
+    *stream++ = (uint8_t)(kFirst + start);
+    for (uint8_t idx = 0; idx < count; idx++) *stream++ = valueOf(kFirst + start + idx);
+  }
+  *stream = 0;
+}
+
+// Properties the stream sets more than once, to different values
+static std::set<uint16_t> findRewritten(const uint8_t *stream)
+{
+  std::set<uint16_t> rewritten;
+  std::vector<int> values(0x10000, -1);
+  for (; *stream; stream += 1 + *stream) {
+    if (stream[1] != 0x11) continue;
+    uint16_t id = (stream[2] << 8) | stream[4];
+    for (uint8_t idx = 0; idx < stream[3]; idx++) {
+      uint8_t value = stream[5 + idx];
+      if (values[id + idx] >= 0 && values[id + idx] != value) rewritten.insert(id + idx);
+      values[id + idx] = value;
+    }
+  }
+  return rewritten;
+}
+
+static uint8_t countWritten()
+{
+  uint8_t written = 0;
+  for (uint8_t idx = 0; idx < kCount; idx++) {
+    if (sim.getProperty(kFirst + idx) == valueOf(kFirst + idx)) written++;
+  }
+  return written;
+}
+
+static bool frequencyWritten()
+{
+  for (uint16_t id = 0x4000; id < 0x4004; id++) {
+    uint8_t value;
+    if (!radio.getShadowProperty(id, value) || sim.getProperty(id) != value) return false;
+  }
+  return true;
+}
+
+int main()
+{
+  sim.attach();
+  radio.setShadowTable(shadowTable, kSmallTable);
+  radio.powerUpXTAL();
+  delay(1);
+
+  uint8_t stream[kCount + 8 * ((kCount + kRun - 1) / kRun)];
+  buildStream(stream);
+
+  // Blocking writes: the first run times out, so does everything after it
+  radio.beginProperties();
+  radio.configure(stream);
+  sim.holdCTS(true);
+  check(!radio.flushProperties(), "commit reports the timeout");
+  sim.holdCTS(false);
+  check(countWritten() == 0, "nothing reached the radio");
+  check(radio.commit(), "next commit succeeds");
+  check(countWritten() == kCount, "next commit writes every property");
+
+  radio.resetPropertyCounters();
+  check(radio.commit() && radio.getPropertyCounters().sent == 0, "then nothing is left to write");
+
+  // Queued writes: commit() returns at once, the timeout comes later. The
+  // shadow table is still full, so these go through the pending list.
+  radio.setFrequencyAsync(433920000UL);
+  sim.holdCTS(true);
+  radio.waitForIdle();
+  sim.holdCTS(false);
+  check(sim.getProperty(0x4000) == 0, "queued pending write timed out");
+  check(radio.commit() && sim.getProperty(0x4000) != 0, "next commit writes it");
+
+  // The same with room in the shadow table
+  radio.invalidateProperties();
+  radio.setFrequencyAsync(868300000UL);
+  sim.holdCTS(true);
+  radio.waitForIdle();
+  sim.holdCTS(false);
+  check(!frequencyWritten(), "queued shadow write timed out");
+  check(radio.commit() && frequencyWritten(), "next commit writes it");
+
+  // The WDS stream again, as a delta so that POWER_UP does not clear the table
+  radio.setShadowTable(shadowTable, kLargeTable);
+  check(radio.configure_P(radioConfig), "WDS configuration applies");
+  sim.runs.clear();
+  check(radio.applyDelta(radioConfig), "WDS configuration applies again");
+  // Runs may bridge gaps with known values, but start and end at a change
+  std::set<uint16_t> rewritten = findRewritten(radioConfig);
+  bool others = false;
+  for (size_t idx = 0; idx < sim.runs.size(); idx++) {
+    if (!rewritten.count(sim.runs[idx].first) || !rewritten.count(sim.runs[idx].second)) others = true;
+  }
+  check(!sim.runs.empty() && !others, "second pass writes only calibration values");
+
+  if (failures) printf("%d check(s) failed\n", failures);
+  else printf("All checks passed\n");
+  return failures ? 1 : 0;
+}
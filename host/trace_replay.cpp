@@ -0,0 +1,357 @@
+/**
+ * Replays an SPITrace through the driver. The trace is parsed into CS
+ * frames and split into phases at POWER_UP, START_TX and START_RX; then
+ * the scenario below runs again with a device on the bus that answers
+ * from the trace instead of a radio:
+ *
+ *  - command frames must match the recorded ones byte for byte, and get
+ *    the recorded replies, FIFO and FRR data;
+ *  - READ_CMD_BUFF polls are answered by time: CTS comes back as long
+ *    after the command as it did in the recording, however often the
+ *    driver polls. A driver with another polling strategy still replays.
+ *
+ * Reports the first command that differs and, per phase, the bus traffic
+ * and the recorded and replayed duration.
+ *
+ *   trace_replay                 record the scenario on the simulated radio, then replay it
+ *   trace_replay -r trace.bin    record it to a file only
+ *   trace_replay trace.bin       replay a file, e.g. the sketch's "trace" console dump
+ *
+ * A trace to replay must hold the whole scenario: start it with an empty
+ * ring large enough that no frame was dropped.
+ *
+ *   g++ -std=c++17 -O2 -DSI446X_TRACE=1 -Ihost -I. host/trace_replay.cpp si4x6x.cpp si4x6x_trace.cpp -o trace_replay
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "si4x6x.h"
+#include "si4x6x_trace.h"
+#include "si446x_sim.h"
+#include "radio_config_Si4060.h"
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+static const int      kPinCS    = 10;
+static const uint8_t  kPackets  = 4;
+
+static const uint8_t kCmdPowerUp      = 0x02;
+static const uint8_t kCmdStartTX      = 0x31;
+static const uint8_t kCmdStartRX      = 0x32;
+static const uint8_t kCmdReadCmdBuff  = 0x44;
+
+/**
+ * What si4060test does in TX mode: configure, then send packets one by
+ * one, polling the interrupt status for PACKET_SENT.
+ */
+static void scenario(Si446x &radio)
+{
+  radio.configure_P(radioConfig);
+  radio.setPreambleLength(0x0A);
+  radio.setSync(0x01, 0xB42B);
+
+  uint8_t packet[16];
+  for (uint8_t round = 0; round < kPackets; round++) {
+    for (uint8_t idx = 0; idx < sizeof(packet); idx++) packet[idx] = round + idx;
+    radio.writeTX(packet, sizeof(packet));
+    radio.startTX(0, sizeof(packet), Si446x::kStateReady);
+
+    Si446x::IRQStatus status;
+    do {
+      delay(1);
+      radio.getIntStatus(status);
+    } while (!status.isPacketSentPending());
+  }
+}
+
+struct Frame {
+  uint8_t   pin;
+  uint32_t  time;
+  uint16_t  duration;
+  std::vector<uint8_t>  data;
+  std::vector<bool>     in;     // per byte: answered by the device
+
+  uint8_t getOpcode() const { return data.empty() ? 0xFF : data[0]; }
+  bool isPoll() const { return getOpcode() == kCmdReadCmdBuff; }
+  bool isReady() const { return data.size() > 1 && data[1] == 0xFF; }
+};
+
+static bool parse(const std::vector<uint8_t> &trace, std::vector<Frame> &frames)
+{
+  size_t pos = 0;
+  while (pos < trace.size()) {
+    uint8_t tag = trace[pos];
+    if (tag == SPITrace::kSelect) {
+      if (pos + 6 > trace.size()) return false;
+      Frame frame;
+      frame.pin = trace[pos + 1];
+      frame.time = trace[pos + 2] | (trace[pos + 3] << 8) | (trace[pos + 4] << 16) | ((uint32_t)trace[pos + 5] << 24);
+      frame.duration = 0;
+      frames.push_back(frame);
+      pos += 6;
+    }
+    else if (tag == SPITrace::kRelease) {
+      if (pos + 3 > trace.size() || frames.empty()) return false;
+      frames.back().duration = trace[pos + 1] | (trace[pos + 2] << 8);
+      pos += 3;
+    }
+    else if (tag == SPITrace::kOut || tag == SPITrace::kIn) {
+      if (pos + 2 > trace.size() || frames.empty()) return false;
+      uint8_t length = trace[pos + 1];
+      if (pos + 2 + length > trace.size()) return false;
+      Frame &frame = frames.back();
+      frame.data.insert(frame.data.end(), trace.begin() + pos + 2, trace.begin() + pos + 2 + length);
+      frame.in.insert(frame.in.end(), length, tag == SPITrace::kIn);
+      pos += 2 + length;
+    }
+    else return false;
+  }
+  return true;
+}
+
+/**
+ * Stands in for the radio on the bus, serving the recorded frames in
+ * order. replayTime[n] is when recorded command frame n was replayed.
+ */
+class TraceDevice : public host::Device {
+public:
+  TraceDevice(const std::vector<Frame> &frames)
+    : _frames(frames), _next(0), _lastCommand(-1), _replayTime(frames.size(), 0), _replayed(frames.size(), false),
+      _mismatch(-1), _extraPolls(0), _commands(0) {}
+
+  void select() {
+    _frame = -1;
+    _pos = 0;
+    _poll = false;
+  }
+
+  uint8_t transfer(uint8_t x) {
+    if (_pos == 0) start(x);
+    uint8_t out = 0xFF;
+
+    if (_poll) {
+      if (_pos == 1) out = _pollReady ? 0xFF : 0x00;
+      else if (_pollReady && _frame >= 0 && _pos < _frames[_frame].data.size()) out = _frames[_frame].data[_pos];
+      else out = 0;
+    }
+    else if (_frame >= 0 && _pos < _frames[_frame].data.size()) {
+      const Frame &frame = _frames[_frame];
+      if (frame.in[_pos]) out = frame.data[_pos];
+      else if (frame.data[_pos] != x) diverge(x, frame.data[_pos]);
+    }
+    else if (_frame >= 0) diverge(x, -1);
+    _pos++;
+    return out;
+  }
+
+  bool isComplete() const { return _next >= _frames.size(); }
+  int getMismatch() const { return _mismatch; }
+  const std::string &getMismatchText() const { return _mismatchText; }
+  uint32_t getExtraPolls() const { return _extraPolls; }
+  uint32_t getCommands() const { return _commands; }
+  bool isReplayed(size_t frame) const { return _replayed[frame]; }
+  uint32_t getReplayTime(size_t frame) const { return _replayTime[frame]; }
+
+private:
+  void start(uint8_t opcode) {
+    if (opcode == kCmdReadCmdBuff) startPoll();
+    else startCommand(opcode);
+  }
+
+  /**
+   * CTS is ready once the radio has been busy as long as in the recording,
+   * counted from the last command frame, or at once if the recording has
+   * no poll here.
+   */
+  void startPoll() {
+    _poll = true;
+    _pollReady = true;
+    size_t ready = _next;
+    while (ready < _frames.size() && _frames[ready].isPoll() && !_frames[ready].isReady()) ready++;
+    if (ready >= _frames.size() || !_frames[ready].isPoll()) {
+      _extraPolls++;
+      return;
+    }
+
+    if (_lastCommand >= 0) {
+      uint32_t busy = _frames[ready].time - _frames[_lastCommand].time;
+      if (host::clockMicros - _replayTime[_lastCommand] < busy) {
+        _pollReady = false;
+        return;
+      }
+    }
+    _frame = ready;
+    _next = ready + 1;
+  }
+
+  void startCommand(uint8_t opcode) {
+    // Polls the driver no longer needed
+    while (_next < _frames.size() && _frames[_next].isPoll()) _next++;
+    _commands++;
+    if (_next >= _frames.size()) {
+      diverge(opcode, -1);
+      return;
+    }
+    _frame = _next++;
+    _lastCommand = _frame;
+    _replayTime[_frame] = host::clockMicros;
+    _replayed[_frame] = true;
+  }
+
+  void diverge(uint8_t got, int expected) {
+    if (_mismatch >= 0) return;
+    _mismatch = (_frame >= 0) ? _frame : (int)_frames.size();
+    char text[96];
+    if (expected < 0) snprintf(text, sizeof(text), "byte %u is %02X, beyond the recorded frame", _pos, got);
+    else snprintf(text, sizeof(text), "byte %u is %02X, recorded %02X", _pos, got, expected);
+    _mismatchText = text;
+  }
+
+  const std::vector<Frame> &_frames;
+  size_t    _next;
+  int       _lastCommand;
+  std::vector<uint32_t> _replayTime;
+  std::vector<bool>     _replayed;
+  int       _frame;
+  unsigned  _pos;
+  bool      _poll;
+  bool      _pollReady;
+  int       _mismatch;
+  std::string _mismatchText;
+  uint32_t  _extraPolls;
+  uint32_t  _commands;
+};
+
+static std::vector<uint8_t> record()
+{
+  static uint8_t buffer[16384];
+  SPITrace trace(buffer, sizeof(buffer));
+
+  Si446xSim sim(kPinCS);
+  Si446x radio(kPinCS, 26000000UL);
+  host::detachAll();
+  sim.attach();
+  sim.useTypicalTimes();
+
+  radio.setTrace(&trace);
+  scenario(radio);
+  radio.setTrace(0);
+  host::detachAll();
+
+  std::vector<uint8_t> data(trace.getLength());
+  trace.read(0, data.data(), data.size());
+  if (trace.getCounters().dropped > 0) fprintf(stderr, "trace ring overflowed, oldest frames dropped\n");
+  return data;
+}
+
+static const char *phaseName(uint8_t opcode)
+{
+  switch (opcode) {
+    case kCmdPowerUp: return "boot";
+    case kCmdStartTX: return "tx";
+    case kCmdStartRX: return "rx";
+    default:          return "setup";
+  }
+}
+
+static int replay(const std::vector<uint8_t> &trace)
+{
+  std::vector<Frame> frames;
+  if (!parse(trace, frames) || frames.empty()) {
+    fprintf(stderr, "not a trace\n");
+    return 1;
+  }
+
+  TraceDevice device(frames);
+  Si446x radio(kPinCS, 26000000UL);
+  host::detachAll();
+  host::attach(&device, kPinCS);
+  host::clockMicros = frames[0].time;
+  scenario(radio);
+  host::detachAll();
+
+  // Phases open at POWER_UP, START_TX and START_RX command frames
+  std::vector<size_t> opens;
+  size_t lastCommand = 0, commands = 0;
+  for (size_t idx = 0; idx < frames.size(); idx++) {
+    if (frames[idx].isPoll()) continue;
+    uint8_t opcode = frames[idx].getOpcode();
+    if (opens.empty() || opcode == kCmdPowerUp || opcode == kCmdStartTX || opcode == kCmdStartRX) {
+      if (commands > 0 || opens.empty()) opens.push_back(idx);
+      else opens.back() = idx;
+    }
+    lastCommand = idx;
+    commands++;
+  }
+  printf("%lu byte trace: %lu frames, %lu commands\n\n", (unsigned long)trace.size(),
+    (unsigned long)frames.size(), (unsigned long)commands);
+
+  // Each phase runs from its command to the next phase's, the last one to the last command
+  printf("phase     frames  polls   bytes  recorded us  replayed us\n");
+  for (size_t phase = 0; phase < opens.size(); phase++) {
+    size_t first = opens[phase];
+    size_t last = (phase + 1 < opens.size()) ? opens[phase + 1] : lastCommand;
+    uint32_t polls = 0, bytes = 0;
+    for (size_t idx = first; idx < last; idx++) {
+      if (frames[idx].isPoll()) polls++;
+      bytes += frames[idx].data.size();
+    }
+
+    // Sized for any unsigned long, and the longest phase name with it
+    char replayed[24] = "-";
+    if (device.isReplayed(first) && device.isReplayed(last)) {
+      snprintf(replayed, sizeof(replayed), "%lu", (unsigned long)(device.getReplayTime(last) - device.getReplayTime(first)));
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%s %lu", phaseName(frames[first].getOpcode()), (unsigned long)phase);
+    printf("%-9s %6lu %6lu %7lu %12lu %12s\n", name, (unsigned long)(last - first), (unsigned long)polls,
+      (unsigned long)bytes, (unsigned long)(frames[last].time - frames[first].time), replayed);
+  }
+
+  printf("\n");
+  if (device.getMismatch() >= 0) {
+    printf("Command sequence differs at frame %d (opcode %02X): %s\n", device.getMismatch(),
+      (device.getMismatch() < (int)frames.size()) ? frames[device.getMismatch()].getOpcode() : 0xFF,
+      device.getMismatchText().c_str());
+    return 2;
+  }
+  if (!device.isComplete()) {
+    printf("Replay stopped before the end of the trace\n");
+    return 2;
+  }
+  printf("Command sequence matches: %lu commands, extra polls %lu\n",
+    (unsigned long)device.getCommands(), (unsigned long)device.getExtraPolls());
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+    std::vector<uint8_t> trace = record();
+    FILE *file = fopen(argv[2], "wb");
+    if (!file || fwrite(trace.data(), 1, trace.size(), file) != trace.size()) {
+      perror(argv[2]);
+      return 1;
+    }
+    fclose(file);
+    return 0;
+  }
+
+  std::vector<uint8_t> trace;
+  if (argc > 1) {
+    FILE *file = fopen(argv[1], "rb");
+    if (!file) {
+      perror(argv[1]);
+      return 1;
+    }
+    int c;
+    while ((c = fgetc(file)) != EOF) trace.push_back(c);
+    fclose(file);
+  }
+  else trace = record();
+
+  return replay(trace);
+}
@@ -0,0 +1,52 @@
+/*! @file
+ * Delta command stream from radio_config_Si4060.h to radio_config_Si4362.h, for Si446x::applyDelta().
+ * Generated by host/config_delta.cpp, do not edit.
+ *
+ * 37 commands, 372 bytes (full stream: 51 commands, 574 bytes)
+ */
+
+#ifndef RADIO_DELTA_SI4060_TO_SI4362_H_
+#define RADIO_DELTA_SI4060_TO_SI4362_H_
+
+#define RADIO_DELTA_SI4060_TO_SI4362 { \
+        0x08, 0x13, 0x11, 0x14, 0x00, 0x00, 0x00, 0x4B, 0x00, \
+        0x05, 0x11, 0x00, 0x01, 0x00, 0x3D, \
+        0x07, 0x11, 0x20, 0x03, 0x03, 0x02, 0x71, 0x00, \
+        0x05, 0x11, 0x20, 0x01, 0x0C, 0x51, \
+        0x05, 0x11, 0x20, 0x01, 0x1F, 0x10, \
+        0x0D, 0x11, 0x20, 0x09, 0x22, 0x00, 0x44, 0x07, 0x8F, 0xD5, 0x00, 0x00, 0x02, 0xC0, \
+        0x08, 0x11, 0x20, 0x04, 0x2E, 0x00, 0x28, 0x01, 0x7C, \
+        0x0C, 0x11, 0x20, 0x08, 0x39, 0x0F, 0x0F, 0x00, 0x1A, 0x20, 0x00, 0x00, 0x28, \
+        0x07, 0x11, 0x20, 0x03, 0x47, 0x8E, 0x01, 0x80, \
+        0x05, 0x11, 0x20, 0x01, 0x4E, 0x22, \
+        0x10, 0x11, 0x21, 0x0C, 0x00, 0xCC, 0xA1, 0x30, 0xA0, 0x21, 0xD1, 0xB9, 0xC9, 0xEA, 0x05, 0x12, 0x11, \
+        0x10, 0x11, 0x21, 0x0C, 0x0C, 0x0A, 0x04, 0x15, 0xFC, 0x03, 0x00, 0xCC, 0xA1, 0x30, 0xA0, 0x21, 0xD1, \
+        0x10, 0x11, 0x21, 0x0C, 0x18, 0xB9, 0xC9, 0xEA, 0x05, 0x12, 0x11, 0x0A, 0x04, 0x15, 0xFC, 0x03, 0x00, \
+        0x0C, 0x11, 0x40, 0x08, 0x00, 0x43, 0x09, 0x00, 0x00, 0x4E, 0xC5, 0x20, 0xFE, \
+        0x08, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x05, 0x17, 0x56, 0x10, 0xCA, 0xF0, \
+        0x05, 0x17, 0x13, 0x10, 0xCA, 0xF0, \
+        0x08, 0x11, 0x01, 0x04, 0x00, 0x07, 0x18, 0x01, 0x08, \
+        0x05, 0x11, 0x10, 0x01, 0x03, 0x0F, \
+        0x05, 0x11, 0x12, 0x01, 0x06, 0x12, \
+        0x09, 0x11, 0x12, 0x05, 0x08, 0x2A, 0x01, 0x00, 0x30, 0x30, \
+        0x10, 0x11, 0x12, 0x0C, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x0C, 0x11, 0x12, 0x08, 0x2D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x07, 0x11, 0x20, 0x03, 0x03, 0x00, 0x5D, 0xC0, \
+        0x05, 0x11, 0x20, 0x01, 0x0C, 0x18, \
+        0x05, 0x11, 0x20, 0x01, 0x1F, 0x21, \
+        0x0D, 0x11, 0x20, 0x09, 0x22, 0x02, 0xA5, 0x00, 0xC1, 0x95, 0x00, 0xC2, 0x02, 0x00, \
+        0x09, 0x11, 0x20, 0x05, 0x2E, 0xC0, 0x06, 0x0E, 0xD2, 0xE0, \
+        0x0C, 0x11, 0x20, 0x08, 0x39, 0x94, 0x94, 0x00, 0x1A, 0x40, 0x00, 0x00, 0x2B, \
+        0x08, 0x11, 0x20, 0x04, 0x47, 0x1C, 0x01, 0x80, 0x50, \
+        0x05, 0x11, 0x20, 0x01, 0x4C, 0x02, \
+        0x05, 0x11, 0x20, 0x01, 0x4E, 0x3A, \
+        0x10, 0x11, 0x21, 0x0C, 0x12, 0xA2, 0xA0, 0x97, 0x8A, 0x79, 0x66, 0x52, 0x3F, 0x2E, 0x1F, 0x14, 0x0B, \
+        0x09, 0x11, 0x21, 0x05, 0x1E, 0x06, 0x02, 0x00, 0x00, 0x00, \
+        0x08, 0x11, 0x22, 0x04, 0x00, 0x08, 0x7F, 0x00, 0x5D, \
+        0x10, 0x11, 0x30, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+        0x08, 0x11, 0x40, 0x04, 0x00, 0x41, 0x0E, 0xA5, 0x6A, \
+        0x00 \
+ }
+
+#endif
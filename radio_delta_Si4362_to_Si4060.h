@@ -0,0 +1,30 @@
+/*! @file
+ * Delta command stream from radio_config_Si4362.h to radio_config_Si4060.h, for Si446x::applyDelta().
+ * Generated by host/config_delta.cpp, do not edit.
+ *
+ * 15 commands, 140 bytes (full stream: 25 commands, 255 bytes)
+ */
+
+#ifndef RADIO_DELTA_SI4362_TO_SI4060_H_
+#define RADIO_DELTA_SI4362_TO_SI4060_H_
+
+#define RADIO_DELTA_SI4362_TO_SI4060 { \
+        0x08, 0x13, 0x44, 0x10, 0x00, 0x00, 0x00, 0x4B, 0x00, \
+        0x05, 0x11, 0x00, 0x01, 0x00, 0x00, \
+        0x08, 0x11, 0x01, 0x04, 0x00, 0x01, 0x20, 0x00, 0x04, \
+        0x05, 0x11, 0x12, 0x01, 0x06, 0x02, \
+        0x08, 0x11, 0x12, 0x04, 0x08, 0x00, 0x00, 0x00, 0x30, \
+        0x05, 0x11, 0x20, 0x01, 0x18, 0x01, \
+        0x09, 0x11, 0x20, 0x05, 0x2E, 0x80, 0x06, 0x0E, 0xD2, 0xA0, \
+        0x07, 0x11, 0x20, 0x03, 0x48, 0x02, 0x80, 0xFF, \
+        0x05, 0x11, 0x20, 0x01, 0x4C, 0x01, \
+        0x05, 0x11, 0x20, 0x01, 0x4E, 0x32, \
+        0x10, 0x11, 0x21, 0x0C, 0x00, 0xFF, 0xBA, 0x0F, 0x51, 0xCF, 0xA9, 0xC9, 0xFC, 0x1B, 0x1E, 0x0F, 0x01, \
+        0x10, 0x11, 0x21, 0x0C, 0x0C, 0xFC, 0xFD, 0x15, 0xFF, 0x00, 0x0F, 0xFF, 0xC4, 0x30, 0x7F, 0xF5, 0xB5, \
+        0x0E, 0x11, 0x21, 0x0A, 0x18, 0xB8, 0xDE, 0x05, 0x17, 0x16, 0x0C, 0x03, 0x00, 0x15, 0xFF, \
+        0x08, 0x11, 0x22, 0x04, 0x00, 0x18, 0x10, 0xC0, 0x3D, \
+        0x05, 0x11, 0x40, 0x01, 0x07, 0xFF, \
+        0x00 \
+ }
+
+#endif
@@ -1,5 +1,9 @@
 #include <SPI.h>
 #include "si4x6x.h"
+#include "si4x6x_irq.h"
+#include "si4x6x_manager.h"
+#include "si4x6x_queue.h"
+#include "si4x6x_stream.h"
 
 enum Mode {
   MODE_IDLE = 0,
@@ -14,23 +18,79 @@ Mode mode = MODE_RX;
 //Mode mode = MODE_TX;
 
 const int pinCS = 10;
+const int pinIRQ = 2;
 const int pinBuzzer = 7;
 const int pinLED = 8;
 
-const uint8_t kPacketLength = 7;
-const uint8_t kMaxPacketLength = 7;
+const uint8_t kMaxPackets = 8;     // packets returned per takePackets() call
 
 const uint32_t xoFrequency = 26000000UL;
 const uint8_t  xoTune      = 28;
 
 Si446x tx(pinCS, xoFrequency);
+Si446xIRQ irq(tx, pinIRQ);
+
+// Services every radio on the bus; more receivers get their own Si446x and
+// Si446xIRQ and are added next to irq in setup()
+Si446xManager radios;
+
+uint8_t rxStorage[96];
+Si446x::RXBuffer rxBuffer(rxStorage, sizeof(rxStorage));
+
+// The drain onPacketHandler() has queued: latched RSSI and nIRQ time of its
+// PACKET_RX, and what came in while it was under way
+Si446x::FastStatus rxStatus;
+uint32_t rxEventTime;
+bool rxReading;
+bool rxAgain;
+bool rxFlush;
+
+// Filled by the radio service path, emptied by loop()
+Si446xQueue<Si446xPacketRecord, 8> rxQueue;
+
+uint8_t txStorage[128];
+Si446xRing txRing(txStorage, sizeof(txStorage));
+Si446xTXQueue txQueue(tx, txRing, 0, &irq);
+
+static const uint8_t radioConfig[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
+
+// Shadow copy of the properties initModem() sets, so that running it again
+// in the same mode only writes what changed
+const uint8_t kShadowSize = 48;
+Si446x::PropertyEntry shadowTable[kShadowSize];
+
+#if SI446X_TRACE
+// Last few hundred bytes of SPI traffic, for host/trace_replay.cpp
+uint8_t traceStorage[512];
+SPITrace spiTrace(traceStorage, sizeof(traceStorage));
+#endif
+
+#ifdef __AVR__
+// Stack high-water mark: free RAM is painted at startup and later scanned
+// for the first byte the stack (or heap) has overwritten.
+extern uint8_t __heap_start;
+extern uint8_t *__brkval;
+
+const uint8_t kStackPaint = 0xC5;
+
+void paintStack() {
+  uint8_t marker;
+  for (uint8_t *p = &__heap_start; p < &marker - 32; p++) *p = kStackPaint;
+}
+
+uint16_t getStackHeadroom() {
+  const uint8_t *p = (__brkval != 0) ? __brkval : &__heap_start;
+  uint16_t count = 0;
+  while (p[count] == kStackPaint) count++;
+  return count;
+}
+#endif
 
 void initModemAlt()
 {  
   for (uint8_t nTry = 3; nTry > 0; nTry--) {
     Serial.println("Initializing radio...");
-    uint8_t config[] = RADIO_CONFIGURATION_DATA_ARRAY;
-    if (tx.configure(config)) break;
+    if (tx.configure_P(radioConfig)) break;
     Serial.println("Failed");
     delay(100);
   }    
@@ -50,9 +110,13 @@ void initModemAlt()
   }  
 }
 
-void initModem()
+void initModem(bool powerUp)
 { 
-  for (uint8_t nTry = 3; nTry > 0; nTry--) {
+  // A mode change powers the radio up again with the other oscillator, which
+  // also clears the shadow copy. In the same mode the radio keeps its
+  // properties, and the shadow copy reduces the writes below to the ones
+  // that differ.
+  for (uint8_t nTry = 3; powerUp && nTry > 0; nTry--) {
     if (mode == MODE_RX) {
       tx.powerUpXTAL();
     }
@@ -82,18 +146,21 @@ void initModem()
       break;
   }
 
+  tx.resetPropertyCounters();
+  tx.beginProperties();
   tx.setGlobalConfig(0x60);
 
   if (mode == MODE_TX) {
     tx.setXOTune(0);
-    //tx.setIntControl(false, false, true);   // Enable only Packet Handler interrupts
-    //tx.setPHInterrupts(0x20);               // Enable PACKET_SENT interrupt
+    irq.onPacketHandler(Si446xTXQueue::onEvent, &txQueue);
+    irq.enable(Si446x::kIntPacketSent | Si446x::kIntTXFIFOAlmostEmpty);
     tx.setPreambleLength(0x0A);
   }
   if (mode == MODE_RX) {
     tx.setXOTune(xoTune);
-    //tx.setIntControl(false, false, true);   // Enable only Packet Handler interrupts
-    //tx.setPHInterrupts(0x18);               // Enable PACKET_RX and CRC_ERROR interrupts
+    irq.onPacketHandler(onPacketHandler);
+    irq.enable(Si446x::kIntPacketRX | Si446x::kIntCRCError);   // Enable only PACKET_RX and CRC_ERROR interrupts
+    rxBuffer.reset();     // packet format may change below
   }
 
   tx.setFrequency(434.000 * 1E6);
@@ -118,10 +185,18 @@ void initModem()
     tx.setRSSIThreshold(0x40);
     tx.setRSSIComp(0x40);
   }
+  tx.flushProperties();
+
+  const Si446x::PropertyCounters &counters = tx.getPropertyCounters();
+  Serial.print("SET_PROPERTY commands: "); Serial.print(counters.sent); Serial.print('/'); Serial.print(counters.requested);
+  Serial.print(", bytes: "); Serial.print(counters.sentBytes); Serial.print('/'); Serial.println(counters.requestedBytes);
 }
 
 void setup() {
   // put your setup code here, to run once:
+#ifdef __AVR__
+  paintStack();
+#endif
   SPI.begin();
   pinMode(pinCS, OUTPUT);
   pinMode(pinBuzzer, OUTPUT);
@@ -138,7 +213,12 @@ void setup() {
   Serial.begin(9600);
   Serial.println("Reset!");
 
+#if SI446X_TRACE
+  tx.setTrace(&spiTrace);
+#endif
+
   initModemAlt();
+  tx.setShadowTable(shadowTable, kShadowSize);
 
 
   tx.getIntStatus();
@@ -146,7 +226,17 @@ void setup() {
   //tx.getIntStatus();
   delay(500);
 
+  radios.add(irq);
+  if (!radios.begin()) Serial.println("nIRQ pin has no interrupt");
+
+  if (mode == MODE_TX) {
+    irq.onPacketHandler(Si446xTXQueue::onEvent, &txQueue);
+    irq.enable(Si446x::kIntPacketSent | Si446x::kIntTXFIFOAlmostEmpty);
+  }
   if (mode == MODE_RX) {  
+    irq.onPacketHandler(onPacketHandler);
+    tx.configureFastStatus();
+    irq.enable(Si446x::kIntPacketRX | Si446x::kIntCRCError);
     //tx.startRX(0, kMaxPacketLength, Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
     tx.startRX(0, 0, Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
   }  
@@ -165,12 +255,14 @@ void parseCommand(const String & line) {
       tx.setXOTune(args.toInt());
     }
     else if (cmd == String("tx")) {
+      bool changed = (mode != MODE_TX);
       mode = MODE_TX;
-      initModem();
+      initModem(changed);
     }
     else if (cmd == String("rx")) {
+      bool changed = (mode != MODE_RX);
       mode = MODE_RX;
-      initModem();
+      initModem(changed);
     }
     else {
       parseError = true;
@@ -180,7 +272,47 @@ void parseCommand(const String & line) {
     String cmd = line;
     //if (cmd == String("kp")) {
     //}
-    parseError = true;
+    if (cmd == String("irq")) {
+      const Si446xIRQ::Latency &latency = irq.getLatency();
+      Serial.print("IRQ events: "); Serial.println(latency.count);
+      Serial.print("Latency us (last/max): "); Serial.print(latency.last); Serial.print('/'); Serial.println(latency.max);
+      Serial.print("Queued/dropped packets: "); Serial.print(rxQueue.size()); Serial.print('/'); Serial.println(rxQueue.getDrops());
+    }
+    else if (cmd == String("txq")) {
+      const Si446xTXQueue::Counters &counters = txQueue.getCounters();
+      Serial.print("Packets sent/preloaded: "); Serial.print(counters.packets); Serial.print('/'); Serial.println(counters.preloaded);
+      Serial.print("Packets per second: "); Serial.println(txQueue.getPacketsPerSecond());
+      Serial.print("Gap us (mean/max): "); Serial.print(txQueue.getMeanGap()); Serial.print('/'); Serial.println(counters.gapMax);
+    }
+#if SI446X_STATS
+    else if (cmd == String("cts")) {
+      printCTSStats();
+    }
+    else if (cmd == String("stats")) {
+      dumpStats();
+    }
+#endif
+#if SI446X_TRACE
+    else if (cmd == String("trace")) {
+      dumpTrace();
+    }
+#endif
+#ifdef __AVR__
+    else if (cmd == String("mem")) {
+      Serial.print("Unused stack/heap gap: "); Serial.println(getStackHeadroom());
+    }
+#endif
+    else if (cmd == String("radios")) {
+      printRadios();
+    }
+    else if (cmd == String("bus")) {
+      const Si446x::Counters &counters = tx.getBusCounters();
+      Serial.print("Arbitrations: "); Serial.println(counters.arbitrations);
+      Serial.print("CS frames: "); Serial.println(counters.frames);
+    }
+    else {
+      parseError = true;
+    }
   }
   
   if (!parseError) {
@@ -191,6 +323,53 @@ void parseCommand(const String & line) {
   }
 }
 
+#if SI446X_STATS
+void printCTSStats() {
+  const Si446x::Stats &stats = tx.getStats();
+  Serial.println("CTS wait histogram (log2 us buckets)");
+  for (uint8_t idx = 0; idx < Si446x::Stats::kCommands; idx++) {
+    const Si446x::Stats::Command &command = stats.commands[idx];
+    uint32_t total = 0;
+    for (uint8_t bucket = 0; bucket < Si446x::Stats::kBuckets; bucket++) {
+      total += command.ctsWait[bucket];
+    }
+    if (total == 0) continue;
+
+    Serial.print(command.opcode, HEX);
+    Serial.print(':');
+    for (uint8_t bucket = 0; bucket < Si446x::Stats::kBuckets; bucket++) {
+      Serial.print(' ');
+      Serial.print(command.ctsWait[bucket]);
+    }
+    Serial.println();
+  }
+}
+
+// Binary counters and histograms, decoded by host/stats_dump.cpp
+void dumpStats() {
+  uint8_t record[Si446x::Stats::kRecordSize];
+  Serial.write(record, tx.packStatsHeader(record));
+  for (uint8_t idx = 0; idx < Si446x::Stats::kCommands; idx++) {
+    uint8_t length = tx.packStats(idx, record);
+    if (length > 0) Serial.write(record, length);
+  }
+}
+#endif
+
+#if SI446X_TRACE
+// Binary trace records, oldest first; the ring starts over afterwards
+void dumpTrace() {
+  uint8_t chunk[32];
+  uint16_t offset = 0;
+  uint16_t length;
+  while ((length = spiTrace.read(offset, chunk, sizeof(chunk))) > 0) {
+    Serial.write(chunk, length);
+    offset += length;
+  }
+  spiTrace.clear();
+}
+#endif
+
 void processConsole() {
   static uint8_t len;
   static char line[80];
@@ -220,8 +399,13 @@ void debugIRQ() {
     tx.getModemStatus(modemStatus);
     //tx.getChipStatus();
 
+    Si446x::FastStatus fastStatus;
+    tx.getFastStatus(fastStatus);
+
     Serial.print(" RSSI=");
-    Serial.println(modemStatus.getCurrentRSSI());  
+    Serial.print(modemStatus.getCurrentRSSI());  
+    Serial.print(" Latched RSSI=");
+    Serial.println(fastStatus.getLatchedRSSI());
     Serial.print("Modem pending: ");
     if (modemStatus.isRSSIPending()) Serial.print("RSSI_OK ");
     if (modemStatus.isPreambleDetectPending()) Serial.print("PRE_DET ");
@@ -239,105 +423,153 @@ void debugIRQ() {
     Serial.println();   
 }
 
-void loop() {
-  static uint16_t count;
-  
-  processConsole();
-  
-  if (mode == MODE_TX && count == 200) {
-    count = 0;
+// The FIFO does not tell which packet failed, so drop all it holds (the
+// manager counts the error). Leaving RX drops the packet coming in too,
+// which would put the next drain out of step.
+void flushPackets() {
+    tx.changeStateAsync(Si446x::kStateReady);
+    tx.flushRXAsync();
+    tx.changeStateAsync(Si446x::kStateRX);
+    rxBuffer.reset();
+}
 
-    int16_t temp = tx.getTemperature();
-    Serial.print("Temperature: "); Serial.print(temp / 10); Serial.print('.'); Serial.println(temp % 10);
+void readPackets() {
+    rxReading = true;
+    rxEventTime = irq.getEventTime();
+    tx.getFastStatusAsync(rxStatus);
+    tx.receivePacketsAsync(rxBuffer, onPacketsRead);
+}
 
-    digitalWrite(pinLED, HIGH);
-    delay(100);
-    digitalWrite(pinLED, LOW);
-    Serial.println("Transmitting...");
-  
-    //uint8_t data[kPacketLength] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
-    uint8_t data[kPacketLength] = { 0x06, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+void onPacketsRead(Si446x::CommandHandle handle, bool success, void *context) {
+    rxReading = false;
 
-    for (uint8_t idx = 0; idx < 8; idx++) 
-    {
-      uint16_t nTry = 100;
-      while (nTry > 0) {
-        Si446x::IRQStatus irqStatus;
-        tx.getIntStatus(irqStatus);
-
-        if (irqStatus.isPacketSentPending()) {     
-          break;
-        }
-        delay(10);
-        nTry--;
-      }
-      tx.getIntStatus();
-      tx.writeTX(data, kPacketLength); 
-      tx.startTX(0, kPacketLength);      
+    if (rxFlush) {
+      rxFlush = rxAgain = false;
+      flushPackets();
+      return;
     }
-  }
-  else if (mode == MODE_RX && count == 5) {
-    count = 0;
 
-    //debugIRQ();
+    if (success) {
+        Si446x::Packet packets[kMaxPackets];
+        uint8_t count;
 
-    Si446x::IRQStatus irqStatus;
-    tx.getIntStatus(irqStatus);
+        do {
+          count = tx.takePackets(rxBuffer, packets, kMaxPackets);
 
-    /*
-    Serial.print("IRQ: ");
-    for (uint8_t idx = 0; idx < 8; idx++) {
-      Serial.print(irqStatus.rawData[idx], HEX);
-      Serial.print(' ');
+          for (uint8_t pkt = 0; pkt < count; pkt++) {
+            Si446xPacketRecord *record = rxQueue.reserve();
+            if (!record) continue;    // queue full, counted as a drop
+
+            record->timestamp = rxEventTime;
+            record->rssi = rxStatus.getLatchedRSSI();
+            record->length = packets[pkt].length;
+            record->crcOK = true;
+            memcpy(record->data, rxBuffer.data + packets[pkt].offset, record->getStoredLength());
+            rxQueue.commit();
+          }
+        } while (count == kMaxPackets);
+    }
+
+    // The FIFO count may have been taken before the last packet was in
+    if (rxAgain) {
+      rxAgain = false;
+      readPackets();
+    }
+}
+
+// Runs from radios.service(), so it only queues commands: a drain in
+// progress finishes first, and events that arrive meanwhile follow it
+void onPacketHandler(Si446x::IRQStatus &irqStatus, void *context) {
+    //debugIRQ();
+
+    if (irqStatus.isCRCErrorPending()) {
+      if (rxReading) rxFlush = true;
+      else flushPackets();
+      return;
     }
-    Serial.println();
-     */
 
     if (irqStatus.isPacketRXPending())
     {
-        static uint16_t index;
-        
         //debugIRQ();
-        
-        uint8_t packet[kMaxPacketLength];
-
-        uint8_t rxCount = tx.getAvailableRX();
-        //if (rxCount > 0) {
-        //  Serial.print("Available: ");
-        //  Serial.println(rxCount);
-        //}
-
-        while (rxCount > 0) {
-          Serial.print("Packet #");
-          Serial.print(index++);
-          Serial.print(" : ");
-          
-          for (uint8_t idx = 0; idx < kPacketLength; idx++) {
-            packet[idx] = 0;
-          }
-          tx.readRX(packet, kMaxPacketLength);
-    
-          for (uint8_t idx = 0; idx < kPacketLength; idx++) {
-            Serial.print(packet[idx], HEX);
-            Serial.print(' ');
-          }
-          Serial.println();
-
-          if (rxCount >= kPacketLength) {
-            rxCount -= kPacketLength;          
-          }
-          else rxCount = 0;
-        }
+        if (rxReading) rxAgain = true;
+        else readPackets();
               
       //digitalWrite(pinBuzzer, HIGH);
       //delay(250);
       //digitalWrite(pinBuzzer, LOW);
     }
-    if (irqStatus.isCRCErrorPending()) {
-      tx.flushRX();
-    }
+}
+
+void printRadios() {
+  for (uint8_t idx = 0; idx < radios.getCount(); idx++) {
+    const Si446xManager::Counters &counters = radios.getCounters(idx);
+    Serial.print("Radio "); Serial.print(idx);
+    Serial.print(": events "); Serial.print(counters.events);
+    Serial.print(", RX/sent/CRC errors "); Serial.print(counters.packetsRX); Serial.print('/');
+    Serial.print(counters.packetsSent); Serial.print('/'); Serial.print(counters.crcErrors);
+    Serial.print(", packets/s "); Serial.print(radios.getPacketsPerSecond(idx));
+    Serial.print(", bus bytes "); Serial.print(radios.getBusBytes(idx));
+    Serial.print(" ("); Serial.print(radios.getBusUtilisation(idx)); Serial.println(" per mille)");
+  }
+  radios.resetCounters();
+}
+
+// Prints one queued packet per call so the radio gets serviced in between
+void printPacket() {
+  static uint16_t index;
+
+  Si446xPacketRecord *record = rxQueue.front();
+  if (!record) return;
+
+  Serial.print("Packet #");
+  Serial.print(index++);
+  Serial.print(" @");
+  Serial.print(record->timestamp);
+  Serial.print(" RSSI ");
+  Serial.print(record->rssi);
+  if (!record->crcOK) Serial.print(" CRC error");
+  Serial.print(" : ");
+  for (uint8_t idx = 0; idx < record->getStoredLength(); idx++) {
+    Serial.print(record->data[idx], HEX);
+    Serial.print(' ');
   }
+  Serial.println();
 
-  count++;
-  delay(10);
+  rxQueue.release();
+}
+
+void loop() {
+  static uint32_t lastBurst;
+  
+  processConsole();
+
+  if (mode == MODE_RX) {
+    radios.service();
+    printPacket();
+    return;
+  }
+  
+  if (mode == MODE_TX) {
+    radios.service();
+  }
+
+  if (mode == MODE_TX && txQueue.isIdle() && millis() - lastBurst >= 2000) {
+    lastBurst = millis();
+
+    int16_t temp = tx.getTemperature();
+    Serial.print("Temperature: "); Serial.print(temp / 10); Serial.print('.'); Serial.println(temp % 10);
+
+    digitalWrite(pinLED, HIGH);
+    delay(100);
+    digitalWrite(pinLED, LOW);
+    Serial.println("Transmitting...");
+  
+    // Length byte, then the payload
+    uint8_t data[] = { 0x06, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+
+    // Queued back to back, sent from the PACKET_SENT events
+    for (uint8_t idx = 0; idx < 8; idx++) {
+      txQueue.send(data, sizeof(data));
+    }
+  }
 }
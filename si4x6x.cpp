@@ -40,6 +40,9 @@ enum {
   RF_GLOBAL_CONFIG      = 0x0003,
   RF_SYNC_CONFIG        = 0x1100,
   RF_PKT_CONFIG1        = 0x1206,
+  RF_PKT_LEN            = 0x1208,
+  RF_PKT_TX_THRESHOLD   = 0x120B,
+  RF_PKT_RX_THRESHOLD   = 0x120C,
   RF_PKT_FIELD_1_CONFIG = 0x120F,
   RF_MODEM_MOD_TYPE     = 0x2000,
   RF_MODEM_MAP_CONTROL  = 0x2001,
@@ -74,139 +77,1268 @@ enum {
 };
 
 
-Si446x::Si446x(int pinCS, uint32_t xtalFrequency) 
-  : SPIDevice(pinCS), _xtalFrequency(xtalFrequency), _outDiv(4)
+template <class Transport, class Clock>
+Si446xT<Transport, Clock>::Si446xT(int pinCS, uint32_t xtalFrequency, const Transport &transport) 
+  : SPIDevice(pinCS, transport), _xtalFrequency(xtalFrequency), _outDiv(4), _pinCTS(-1), _lastCommand(SI_CMD_NOP),
+    _pendingCount(0), _shadowProperties(0), _shadowSize(0), _shadowCount(0), _deferDepth(0), _committing(false),
+    _commandHead(0), _commandCount(0), _nextHandle(1), _asyncHandle(0), _async(false), _transferDone(false), _waiters(0)
 {
+  memset(_commands, 0, sizeof(_commands));
+  resetPropertyCounters();
+#if SI446X_STATS
+  resetStats();
+#endif
+}
+
+
+/**
+ * Use a radio GPIO configured as CTS (function 8, see configureGPIO) instead
+ * of READ_CMD_BUFF polling. Pass -1 to go back to polling.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setCTSPin(int pinCTS)
+{
+  _pinCTS = pinCTS;
+  if (_pinCTS >= 0) {
+    pinMode(_pinCTS, INPUT);
+  }
+}
+
+
+#if SI446X_STATS
+static const uint8_t kStatsOpcodes[Si446x::Stats::kCommands] = {
+  SI_CMD_NOP, SI_CMD_PART_INFO, SI_CMD_POWER_UP, SI_CMD_FUNC_INFO,
+  SI_CMD_SET_PROPERTY, SI_CMD_GET_PROPERTY, SI_CMD_GPIO_PIN_CFG, SI_CMD_GET_ADC_READING,
+  SI_CMD_FIFO_INFO, SI_CMD_PACKET_INFO, SI_CMD_IRCAL, SI_CMD_PROTOCOL_CFG,
+  SI_CMD_GET_INT_STATUS, SI_CMD_GET_PH_STATUS, SI_CMD_GET_MODEM_STATUS, SI_CMD_GET_CHIP_STATUS,
+  SI_CMD_START_TX, SI_CMD_START_RX, SI_CMD_REQUEST_DEVICE_STATE, SI_CMD_CHANGE_STATE,
+  SI_CMD_RX_HOP, SI_CMD_READ_CMD_BUFF, SI_CMD_FRR_A_READ, SI_CMD_FRR_B_READ,
+  SI_CMD_FRR_C_READ, SI_CMD_FRR_D_READ, SI_CMD_WRITE_TX_FIFO, SI_CMD_READ_RX_FIFO
+};
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+  for (uint8_t idx = 0; idx < Stats::kCommands; idx++) {
+    _stats.commands[idx].opcode = kStatsOpcodes[idx];
+  }
+}
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::Stats::Command *Si446xT<Transport, Clock>::findStats(uint8_t opcode)
+{
+  for (uint8_t idx = 0; idx < Stats::kCommands; idx++) {
+    if (_stats.commands[idx].opcode == opcode) return &_stats.commands[idx];
+  }
+  return 0;
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::recordCommand(uint8_t opcode, uint8_t bytesOut, uint8_t bytesIn)
+{
+  typename Stats::Command *command = findStats(opcode);
+  if (!command) return;
+  if (command->calls < 0xFFFF) command->calls++;
+  command->bytesOut += bytesOut;
+  command->bytesIn += bytesIn;
+}
+
+// A READ_CMD_BUFF frame: command and CTS byte, then the reply if CTS was set
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::recordPoll(uint8_t bytesIn)
+{
+  typename Stats::Command *command = findStats(_lastCommand);
+  if (!command) return;
+  command->ctsPolls++;
+  command->bytesOut += 2;
+  command->bytesIn += bytesIn;
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::recordCTSWait(uint32_t wait)
+{
+  uint8_t bucket = 0;
+  while (wait > 1 && bucket < Stats::kBuckets - 1) {
+    wait >>= 1;
+    bucket++;
+  }
+
+  typename Stats::Command *command = findStats(_lastCommand);
+  if (command && command->ctsWait[bucket] < 0xFFFF) command->ctsWait[bucket]++;
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::recordTimeout()
+{
+  typename Stats::Command *command = findStats(_lastCommand);
+  if (command && command->timeouts < 0xFFFF) command->timeouts++;
+}
+
+static uint8_t packLE(uint8_t *buffer, uint32_t value, uint8_t size)
+{
+  for (uint8_t idx = 0; idx < size; idx++) {
+    buffer[idx] = value >> (8 * idx);
+  }
+  return size;
+}
+
+/**
+ * Binary dump for a serial console: a header ('S', 'I', version, number
+ * of buckets, number of records) followed by packStats() for every row in
+ * use. Multi-byte fields are little endian. Returns the header length.
+ */
+template <class Transport, class Clock>
+uint8_t Si446xT<Transport, Clock>::packStatsHeader(uint8_t *buffer) const
+{
+  uint8_t records = 0;
+  for (uint8_t idx = 0; idx < Stats::kCommands; idx++) {
+    const typename Stats::Command &command = _stats.commands[idx];
+    if (command.calls > 0 || command.ctsPolls > 0) records++;
+  }
+  buffer[0] = 'S';
+  buffer[1] = 'I';
+  buffer[2] = Stats::kVersion;
+  buffer[3] = Stats::kBuckets;
+  buffer[4] = records;
+  return 5;
+}
+
+/**
+ * Packs row index as opcode, calls, timeouts, ctsPolls, bytesOut, bytesIn
+ * and the ctsWait buckets. Returns Stats::kRecordSize, or 0 if the row was
+ * never used.
+ */
+template <class Transport, class Clock>
+uint8_t Si446xT<Transport, Clock>::packStats(uint8_t index, uint8_t *buffer) const
+{
+  const typename Stats::Command &command = _stats.commands[index];
+  if (command.calls == 0 && command.ctsPolls == 0) return 0;
+
+  uint8_t pos = 0;
+  buffer[pos++] = command.opcode;
+  pos += packLE(buffer + pos, command.calls, 2);
+  pos += packLE(buffer + pos, command.timeouts, 2);
+  pos += packLE(buffer + pos, command.ctsPolls, 4);
+  pos += packLE(buffer + pos, command.bytesOut, 4);
+  pos += packLE(buffer + pos, command.bytesIn, 4);
+  for (uint8_t bucket = 0; bucket < Stats::kBuckets; bucket++) {
+    pos += packLE(buffer + pos, command.ctsWait[bucket], 2);
+  }
+  return pos;
+}
+#endif
+
+
+
+/**
+ * Resets the radio
+ */
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::shutdown()
+{
+  // NO SDN PIN 
+}
+
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// SPI communication methods
+// 
+
+
+/**
+ * Polls READ_CMD_BUFF once and fetches the reply if CTS is set.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::pollReply(uint8_t *reply, uint8_t replyLength)
+{
+  SPIDevice::select();
+  SPIDevice::write(SI_CMD_READ_CMD_BUFF);
+  uint8_t cts = SPIDevice::readStatus(0xFF, reply, replyLength);
+  SPIDevice::release();
+#if SI446X_STATS
+  recordPoll((cts == 0xFF) ? replyLength : 0);
+#endif
+
+  return (cts == 0xFF);
+}
+
+
+/**
+ * A CTS backoff pause. The bus is given up for it even inside a
+ * Transaction scope: CTS can take up to kCTSTimeout, and other devices on
+ * the bus should not wait that long.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::pauseForCTS(uint16_t us)
+{
+  SPIDevice::pauseTransaction();
+  Clock::delayMicroseconds(us);
+  SPIDevice::resumeTransaction();
+}
+
+
+/**
+ * Waits for CTS outside the command queue, for commands sent straight from
+ * program memory. Polls with the same backoff as waitForCommand(). The
+ * timeout is in microseconds.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::waitForReply(uint8_t *reply, uint8_t replyLength, uint32_t timeout)
+{
+  uint32_t start = Clock::micros();
+  uint16_t backoff = kCTSBackoffMin;
+
+  for (;;)
+  {
+    if (_pinCTS < 0 || digitalRead(_pinCTS) == HIGH) 
+    {
+      if (pollReply(reply, replyLength)) 
+      {
+#if SI446X_STATS
+        recordCTSWait(Clock::micros() - start);
+#endif
+        return true;
+      }
+    }
+
+    if (Clock::micros() - start >= timeout) 
+    {
+      break;
+    }
+
+    if (_pinCTS < 0) 
+    {
+      pauseForCTS(backoff);
+      if (backoff < kCTSBackoffMax) backoff <<= 1;
+    }
+  }
+
+#if SI446X_STATS
+  recordCTSWait(timeout);
+  recordTimeout();
+#endif
+  return false;
+}
+
+
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::waitForCTS(uint32_t timeout)
+{ 
+  return waitForReply(0, 0, timeout);
+}
+
+
+/**
+ * Blocking command: queues it behind whatever is pending and waits until
+ * it is done. Inside beginAsync() it only queues.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::sendCommand(uint8_t cmd, const uint8_t *data, uint8_t dataLength, uint8_t *reply, uint8_t replyLength, bool pollCTS)
+{
+  CommandHandle handle = submitCommand(cmd, data, dataLength, reply, replyLength, pollCTS ? 0 : kCommandNoCTS);
+  return _async || waitForCommand(handle);
+}
+
+
+/**
+ * sendCommand() for arguments in program memory, without reply.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::sendCommand_P(uint8_t cmd, const uint8_t *data, uint8_t dataLength)
+{
+  typename SPIDevice::Transaction bus(*this);
+
+  waitForIdle();
+  if (!waitForCTS())
+    return false;
+  
+  SPIDevice::select();
+  SPIDevice::write(cmd);
+  SPIDevice::transfer_P(data, dataLength);
+  _lastCommand = cmd;
+#if SI446X_STATS
+  recordCommand(cmd, 1 + dataLength, 0);
+#endif
+  Clock::delayMicroseconds(1); /* Select hold time min 50 ns */
+  SPIDevice::release();
+
+  return true;
+}
+
+
+/**
+ * Command whose reply is clocked out in the same frame (FIFO and FRR reads).
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::sendImmediate(uint8_t cmd, uint8_t *reply, uint8_t replyLength, bool pollCTS)
+{
+  uint8_t flags = kCommandImmediate | (pollCTS ? 0 : kCommandNoCTS);
+  CommandHandle handle = submitCommand(cmd, 0, 0, reply, replyLength, flags);
+  return _async || waitForCommand(handle);
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Command queue
+// 
+
+
+/**
+ * Appends a command to the queue, waiting for the oldest one if it is full.
+ * Inside beginAsync() short arguments are copied, since the caller's
+ * buffer usually lives on its stack.
+ */
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::submitCommand(uint8_t cmd, const uint8_t *data, uint8_t dataLength, uint8_t *reply, uint8_t replyLength, uint8_t flags)
+{
+  while (_commandCount == SI446X_COMMAND_QUEUE) {
+    waitForCommand(_commands[_commandHead].handle);
+  }
+
+  Command &command = _commands[(_commandHead + _commandCount) % SI446X_COMMAND_QUEUE];
+  command.handle = _nextHandle;
+  if (++_nextHandle == 0) _nextHandle = 1;
+
+  if (cmd == SI_CMD_WRITE_TX_FIFO || cmd == SI_CMD_READ_RX_FIFO) flags |= kCommandFIFO;
+
+  command.opcode = cmd;
+  command.length = dataLength;
+  command.data = data;
+  if (_async && dataLength <= kCommandArgs) {
+    memcpy(command.args, data, dataLength);
+    command.data = command.args;
+  }
+  command.reply = reply;
+  command.replyLength = replyLength;
+  command.flags = flags;
+  command.callback = 0;
+  command.context = 0;
+  command.state = kSlotQueued;
+  _commandCount++;
+
+  if (_async) _asyncHandle = command.handle;
+  return command.handle;
+}
+
+
+/**
+ * Takes every queued command as far as it goes without waiting: at most
+ * one CTS or reply poll for the command at the head, and on to the next
+ * one whenever a command finishes. Without a CTS pin the polls of a
+ * command back off the same way waitForCommand() does, so a radio slow to
+ * raise CTS does not fill the bus with READ_CMD_BUFF. Returns true if a
+ * command finished.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::poll()
+{
+  if (_commandCount == 0) return false;
+
+  typename SPIDevice::Transaction bus(*this);
+  bool finished = false;
+  while (_commandCount > 0 && advanceCommand()) {
+    finished = true;
+  }
+  return finished;
+}
+
+
+/**
+ * One step of the command at the head of the queue: CTS, the command
+ * frame, the reply. Returns true once it has finished. A FIFO burst gets
+ * kCTSTimeout from its start to complete, then fails with CS released.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::advanceCommand()
+{
+  Command &command = _commands[_commandHead];
+
+  if (command.state == kSlotQueued) {
+    command.state = kSlotWaitCTS;
+    command.started = command.nextPoll = Clock::micros();
+    command.backoff = kCTSBackoffMin;
+  }
+
+  if (command.state == kSlotWaitCTS) {
+    if (!(command.flags & kCommandNoCTS) && !isCTSReady(command, 0, 0)) {
+      return expireCommand(command);
+    }
+
+    SPIDevice::select();
+    SPIDevice::write(command.opcode);
+#if SI446X_STATS
+    if (command.flags & kCommandImmediate) recordCommand(command.opcode, 1, command.replyLength);
+    else recordCommand(command.opcode, 1 + command.length, 0);
+#endif
+    if (command.flags & kCommandFIFO) {
+      // The burst may run by DMA: CS stays low until the transport calls back
+      command.state = kSlotTransfer;
+      command.started = Clock::micros();
+      command.backoff = kCTSBackoffMin;
+      __atomic_store_n(&_transferDone, false, __ATOMIC_RELAXED);
+      if (command.flags & kCommandImmediate) {
+        SPIDevice::transferAsync(0, command.reply, command.replyLength, onTransferDone, this);
+      }
+      else {
+        SPIDevice::transferAsync(command.data, 0, command.length, onTransferDone, this);
+      }
+    }
+    else {
+      if (command.flags & kCommandImmediate) {
+        SPIDevice::transfer(0, command.reply, command.replyLength);
+      }
+      else {
+        SPIDevice::transfer(command.data, 0, command.length);
+        _lastCommand = command.opcode;
+      }
+      Clock::delayMicroseconds(1); /* Select hold time min 50 ns */
+      SPIDevice::release();
+
+      if ((command.flags & kCommandImmediate) || command.replyLength == 0) {
+        finishCommand(true);
+        return true;
+      }
+      command.state = kSlotWaitReply;
+      command.started = command.nextPoll = Clock::micros();
+      command.backoff = kCTSBackoffMin;
+    }
+  }
+
+  // A transport that never calls back would hold CS low and the queue for good
+  if (command.state == kSlotTransfer) {
+    if (!__atomic_load_n(&_transferDone, __ATOMIC_ACQUIRE)) {
+      if (Clock::micros() - command.started < kCTSTimeout) return false;
+      SPIDevice::release();
+      return expireCommand(command);
+    }
+    Clock::delayMicroseconds(1); /* Select hold time min 50 ns */
+    SPIDevice::release();
+    finishCommand(true);
+    return true;
+  }
+
+  if (isCTSReady(command, command.reply, command.replyLength)) {
+    finishCommand(true);
+    return true;
+  }
+  return expireCommand(command);
+}
+
+
+/**
+ * Transport completion of a FIFO burst, possibly from an interrupt or
+ * another thread: only flags it for the next poll().
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::onTransferDone(void *context)
+{
+  Si446xT *radio = (Si446xT *)context;
+  __atomic_store_n(&radio->_transferDone, true, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Checks CTS once, on the CTS pin if there is one, and fetches the reply
+ * when it is set. Without the pin the check waits for nextPoll, and every
+ * poll that finds CTS low doubles the wait before the next.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::isCTSReady(Command &command, uint8_t *reply, uint8_t replyLength)
+{
+  if (_pinCTS >= 0) {
+    if (digitalRead(_pinCTS) == LOW) return false;
+  }
+  else if ((int32_t)(Clock::micros() - command.nextPoll) < 0) return false;
+
+  if (!pollReply(reply, replyLength)) {
+    command.nextPoll = Clock::micros() + command.backoff;
+    if (command.backoff < kCTSBackoffMax) command.backoff <<= 1;
+    return false;
+  }
+#if SI446X_STATS
+  recordCTSWait(Clock::micros() - command.started);
+#endif
+  return true;
+}
+
+
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::expireCommand(Command &command)
+{
+  if (Clock::micros() - command.started < kCTSTimeout) return false;
+#if SI446X_STATS
+  recordCTSWait(kCTSTimeout);
+  recordTimeout();
+#endif
+  finishCommand(false);
+  return true;
+}
+
+
+/**
+ * Retires the command at the head. The slot keeps its handle and outcome
+ * for getCommandStatus() until it is reused. A SET_PROPERTY from commit()
+ * that timed out, queued or blocking, leaves its properties dirty, so the
+ * next commit() sends them again.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::finishCommand(bool success)
+{
+  Command &command = _commands[_commandHead];
+  command.state = success ? kSlotDone : kSlotFailed;
+  if (!success && (command.flags & kCommandProperty)) {
+    markPropertiesDirty(command.data);
+  }
+
+  _commandHead = (_commandHead + 1) % SI446X_COMMAND_QUEUE;
+  _commandCount--;
+  for (Waiter *waiter = _waiters; waiter; waiter = waiter->outer) {
+    if (waiter->handle == command.handle) waiter->status = success ? kCommandDone : kCommandFailed;
+  }
+
+  // The callback may queue more commands into this very slot
+  if (command.callback) {
+    CommandCallback callback = command.callback;
+    callback(command.handle, success, command.context);
+  }
+}
+
+
+/**
+ * Hands the values of a failed SET_PROPERTY back to the next commit().
+ * Shadow entries turn dirty again, keeping any value staged since; other
+ * properties go back to the pending list unless a newer write is there.
+ * While commit() runs it keeps its own failed runs, and the pending list
+ * is left alone.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::markPropertiesDirty(const uint8_t *args)
+{
+  uint16_t id = (args[0] << 8) | args[2];
+  for (uint8_t idx = 0; idx < args[1]; idx++) {
+    uint8_t pos;
+    if (findShadowProperty(id + idx, pos)) {
+      _shadowProperties[pos].id |= kShadowDirty;
+    }
+    else if (!_committing) {
+      insertProperty(id + idx, args[3 + idx], false);
+    }
+  }
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandStatus Si446xT<Transport, Clock>::getCommandStatus(CommandHandle handle) const
+{
+  if (handle == 0) return kCommandDone;
+  for (uint8_t idx = 0; idx < SI446X_COMMAND_QUEUE; idx++) {
+    const Command &command = _commands[idx];
+    if (command.handle != handle) continue;
+    switch (command.state) {
+      case kSlotQueued:
+      case kSlotWaitCTS:    return kCommandQueued;
+      case kSlotWaitReply:
+      case kSlotTransfer:   return kCommandBusy;
+      case kSlotDone:       return kCommandDone;
+      case kSlotFailed:     return kCommandFailed;
+    }
+  }
+  return kCommandUnknown;
+}
+
+
+/**
+ * Runs the queue until the command has finished, polling first back to
+ * back and then with an exponentially growing pause. If a GPIO is routed
+ * to CTS (see setCTSPin), the pin is watched instead and the bus is only
+ * used once to fetch the reply. Returns false if it failed. The bus is
+ * only held for the frames themselves, not between polls.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::waitForCommand(CommandHandle handle)
+{
+  Waiter waiter = { _waiters, handle, (uint8_t)getCommandStatus(handle) };
+  _waiters = &waiter;
+  for (;;)
+  {
+    poll();
+
+    // A callback may have reused the slot already: trust the recorded outcome
+    CommandStatus status = (CommandStatus)waiter.status;
+    if (status == kCommandQueued || status == kCommandBusy) status = getCommandStatus(handle);
+    if (status != kCommandQueued && status != kCommandBusy) 
+    {
+      _waiters = waiter.outer;
+      return (status == kCommandDone);
+    }
+
+    if (_pinCTS < 0) 
+    {
+      Command &command = _commands[_commandHead];
+      if (command.state == kSlotTransfer) 
+      {
+        // CS stays low through a burst in progress: keep the bus for that
+        Clock::delayMicroseconds(command.backoff);
+        if (command.backoff < kCTSBackoffMax) command.backoff <<= 1;
+      }
+      else 
+      {
+        int32_t wait = command.nextPoll - Clock::micros();
+        if (wait > 0) pauseForCTS(wait);
+      }
+    }
+  }
+}
+
+
+/**
+ * Blocks until every queued command has finished.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::waitForIdle()
+{
+  if (_commandCount > 0) {
+    waitForCommand(_commands[(_commandHead + _commandCount - 1) % SI446X_COMMAND_QUEUE].handle);
+  }
+}
+
+
+/**
+ * Between beginAsync() and endAsync() the blocking command helpers only
+ * queue their commands; the callback goes with the last one.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::beginAsync()
+{
+  _async = true;
+  _asyncHandle = 0;
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::endAsync(CommandCallback callback, void *context)
+{
+  _async = false;
+  CommandHandle handle = _asyncHandle;
+  if (handle == 0) {
+    if (callback) callback(0, true, context);
+    return 0;
+  }
+
+  for (uint8_t idx = 0; idx < SI446X_COMMAND_QUEUE; idx++) {
+    if (_commands[idx].handle == handle) {
+      _commands[idx].callback = callback;
+      _commands[idx].context = context;
+    }
+  }
+  return handle;
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::getIntStatusAsync(IRQStatus &status, CommandCallback callback, void *context)
+{
+  beginAsync();
+  getIntStatus(status);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::getFastStatusAsync(FastStatus &status, CommandCallback callback, void *context)
+{
+  beginAsync();
+  getFastStatus(status);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::readRXAsync(uint8_t *data, uint8_t length, CommandCallback callback, void *context)
+{
+  beginAsync();
+  readRX(data, length);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::writeTXAsync(const uint8_t *data, uint8_t length, CommandCallback callback, void *context)
+{
+  beginAsync();
+  writeTX(data, length);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::setFrequencyAsync(uint32_t freq, CommandCallback callback, void *context)
+{
+  beginAsync();
+  setFrequency(freq);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::startTXAsync(uint8_t channel, uint16_t pktLength, State txCompleteState, CommandCallback callback, void *context)
+{
+  beginAsync();
+  startTX(channel, pktLength, txCompleteState);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::startRXAsync(uint8_t channel, uint16_t pktLength, State preambleTimeoutState, State validPacketState, State invalidPacketState, CommandCallback callback, void *context)
+{
+  beginAsync();
+  startRX(channel, pktLength, preambleTimeoutState, validPacketState, invalidPacketState);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::changeStateAsync(State state, CommandCallback callback, void *context)
+{
+  beginAsync();
+  changeState(state);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::getFIFOInfoAsync(FIFOInfo &info, CommandCallback callback, void *context)
+{
+  beginAsync();
+  getFIFOInfo(info);
+  return endAsync(callback, context);
+}
+
+
+template <class Transport, class Clock>
+typename Si446xT<Transport, Clock>::CommandHandle Si446xT<Transport, Clock>::flushRXAsync(CommandCallback callback, void *context)
+{
+  beginAsync();
+  flushRX();
+  return endAsync(callback, context);
+}
+
+
+/**
+ * The packet format is read first if the buffer does not know it yet;
+ * PACKET_INFO, if needed, and FIFO_INFO then go out together, and the
+ * FIFO read for the count they report is queued from their callback.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::receivePacketsAsync(RXBuffer &buffer, CommandCallback callback, void *context)
+{
+  buffer.compact();
+  buffer.radio = this;
+  buffer.callback = callback;
+  buffer.context = context;
+
+  if (buffer.formatKnown) {
+    requestRXCount(buffer);
+    return;
+  }
+
+  uint8_t data[] = { (uint8_t)(RF_PKT_LEN >> 8), 7, (uint8_t)RF_PKT_LEN };
+  beginAsync();
+  sendCommand(SI_CMD_GET_PROPERTY, data, sizeof(data), buffer.reply, sizeof(buffer.reply));
+  endAsync(onRXFormat, &buffer);
+}
+
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::requestRXCount(RXBuffer &buffer)
+{
+  bool variable = (buffer.lengthConfig & 0x07) != 0;
+  bool lengthInFIFO = variable && (buffer.lengthConfig & 0x08);
+  uint8_t data[] = { 0x00 };
+
+  beginAsync();
+  if (variable && !lengthInFIFO) sendCommand(SI_CMD_PACKET_INFO, 0, 0, buffer.reply, 2);
+  sendCommand(SI_CMD_FIFO_INFO, data, sizeof(data), buffer.reply + 2, 2);
+  endAsync(onRXCount, &buffer);
+}
+
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::onRXFormat(CommandHandle handle, bool success, void *context)
+{
+  RXBuffer &buffer = *(RXBuffer *)context;
+  if (!success) {
+    buffer.callback(handle, false, buffer.context);
+    return;
+  }
+  buffer.radio->setPacketFormat(buffer, buffer.reply);
+  buffer.radio->requestRXCount(buffer);
+}
+
+
+// The last step: the callback goes with the FIFO read
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::onRXCount(CommandHandle handle, bool success, void *context)
+{
+  RXBuffer &buffer = *(RXBuffer *)context;
+  if (!success) {
+    buffer.callback(handle, false, buffer.context);
+    return;
+  }
+
+  bool variable = (buffer.lengthConfig & 0x07) != 0;
+  if (variable && !(buffer.lengthConfig & 0x08)) {
+    buffer.packetLength = (buffer.reply[0] << 8) | buffer.reply[1];
+  }
+
+  uint8_t count = buffer.reply[2];
+  if (count > buffer.size - buffer.end) count = buffer.size - buffer.end;
+  if (count == 0) {
+    buffer.callback(0, true, buffer.context);
+    return;
+  }
+  buffer.end += count;
+  buffer.radio->readRXAsync(buffer.data + buffer.end - count, count, buffer.callback, buffer.context);
 }
 
 
 
 /**
- * Resets the radio
+ * Runs a WDS style command stream: length byte, command, arguments, ...,
+ * terminated by a zero length. SET_PROPERTY commands go through the shadow
+ * table and are merged; other commands flush them first since they may
+ * depend on the properties (e.g. IRCAL, START_RX).
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::configure(uint8_t *params)
+{
+  return configureStream(params, false);
+}
+
+
+/**
+ * Same as configure() for a stream kept in program memory, e.g.
+ *   static const uint8_t config[] PROGMEM = RADIO_CONFIGURATION_DATA_ARRAY;
  */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::configure_P(const uint8_t *params)
+{
+  return configureStream(params, true);
+}
+
 
-void Si446x::shutdown()
+/**
+ * Switches an already powered radio to another profile with a delta stream
+ * in program memory, as generated by host/config_delta.cpp. POWER_UP
+ * commands in the stream are ignored.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::applyDelta(const uint8_t *delta)
 {
-  // NO SDN PIN 
+  return configureStream(delta, true, false);
 }
 
 
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::configureStream(const uint8_t *params, bool progmem, bool allowPowerUp)
+{
+  typename SPIDevice::Transaction bus(*this);
+  bool success = true;
+
+  beginProperties();
+  for (;;) {
+    uint8_t length = progmem ? pgm_read_byte(params) : *params;
+    if (length == 0) break;
+    params++;
+
+    uint8_t cmd = progmem ? pgm_read_byte(params) : *params;
+    if (cmd == SI_CMD_SET_PROPERTY) {
+      // The shadow table needs the values in RAM, one command at a time
+      uint8_t args[3 + kMaxPropertyRun];
+      uint8_t argsLength = length - 1;
+      if (argsLength > sizeof(args)) argsLength = sizeof(args);
+      if (progmem) memcpy_P(args, params + 1, argsLength);
+      else memcpy(args, params + 1, argsLength);
+
+      if (!setProperties(args, argsLength)) {
+        success = false;
+        break;
+      }
+    }
+    else if (cmd != SI_CMD_POWER_UP || allowPowerUp) {
+      if (!commit()) {
+        success = false;
+        break;
+      }
+      bool sent = progmem ? sendCommand_P(cmd, params + 1, length - 1) 
+                          : sendCommand(cmd, params + 1, length - 1);
+      if (!sent) {
+        success = false;
+        break;
+      }
+      if (cmd == SI_CMD_POWER_UP) {
+        invalidateProperties();
+      }
+      if (!waitForReply(0, 0)) {
+        success = false;
+        break;
+      }
+    }
+    
+    params += length;
+  }
+  if (!flushProperties()) success = false;
+  return success;
+}
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
-// SPI communication methods
+// Property writes
 // 
 
 
-bool Si446x::waitForReply(uint8_t *reply, uint8_t replyLength, uint16_t timeout)
+/**
+ * Holds back property writes until the matching flushProperties(), so that
+ * writes to neighbouring properties go out as one SET_PROPERTY. Calls nest.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::beginProperties()
 {
-  uint8_t cts;
-  while (timeout > 0)
-  {    
-    SPIDevice::select();
-    SPIDevice::write(SI_CMD_READ_CMD_BUFF);
-    cts = SPIDevice::read();
-    if (cts == 0xFF) 
-    {
-      for (; replyLength > 0; replyLength--) 
-      {
-        *reply++ = SPIDevice::read();
+  _deferDepth++;
+}
+
+
+/**
+ * Ends a beginProperties() block. The outermost call commits the held back
+ * writes.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::flushProperties()
+{
+  if (_deferDepth > 0) _deferDepth--;
+  if (_deferDepth > 0) return true;
+
+  return commit();
+}
+
+
+/**
+ * Writes every property whose value differs from what the radio has, merged
+ * into runs of up to 12 consecutive properties of the same group. Gaps
+ * between changed properties are bridged with their shadow values. Runs
+ * that fail stay dirty or pending for the next commit().
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::commit()
+{
+  typename SPIDevice::Transaction bus(*this);
+  bool success = true;
+  uint8_t values[kMaxPropertyRun];
+
+  _committing = true;
+  uint8_t kept = 0;
+  uint8_t pendingIdx = 0;
+  uint8_t shadowIdx = 0;
+  PropertyEntry entry;
+  bool dirty;
+
+  while (peekProperty(pendingIdx, shadowIdx, entry, dirty)) {
+    if (!dirty) {
+      shadowIdx++;
+      continue;
+    }
+
+    // Extend the run over consecutive IDs, then cut it after the last dirty one
+    uint16_t id = entry.id;
+    uint8_t count = 0;
+    uint8_t used = 0;
+    uint8_t runPending = pendingIdx, runShadow = shadowIdx;
+    uint8_t endPending = pendingIdx, endShadow = shadowIdx;
+    while (count < kMaxPropertyRun && (uint8_t)id + count <= 0xFF && 
+           peekProperty(runPending, runShadow, entry, dirty) && entry.id == id + count) {
+      values[count++] = entry.value;
+      if (runShadow < _shadowCount && (_shadowProperties[runShadow].id & ~kShadowDirty) == entry.id) runShadow++;
+      else runPending++;
+      if (dirty) {
+        used = count;
+        endPending = runPending;
+        endShadow = runShadow;
       }
-      SPIDevice::release();
-      break;
     }
-    SPIDevice::release();
-    
-    delay(1);
-    timeout--;
-  }
 
-  if (timeout == 0) 
-  {
-    // TODO: possibly indicate error
-    return false;
+    if (writeProperties(id, values, used)) {
+      for (uint8_t idx = shadowIdx; idx < endShadow; idx++) {
+        _shadowProperties[idx].id &= ~kShadowDirty;
+      }
+    }
+    else {
+      success = false;
+      // Shadow entries are still dirty; move the pending ones down to keep them
+      for (uint8_t idx = pendingIdx; idx < endPending; idx++) {
+        _pendingProperties[kept++] = _pendingProperties[idx];
+      }
+    }
+
+    pendingIdx = endPending;
+    shadowIdx = endShadow;
   }
+  _pendingCount = kept;
+  _committing = false;
+  return success;
+}
 
-  //if (cts == 0xFF) 
-  //{
-  //  _ctsHigh = true;
-  //}
 
-  return (cts == 0xFF);
+/**
+ * Returns the lowest ID property at the given pending list and shadow table
+ * positions. Pending writes are always dirty. Should both hold the same ID,
+ * the shadow entry is the newer one and the pending write is skipped.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::peekProperty(uint8_t &pendingIdx, uint8_t shadowIdx, PropertyEntry &entry, bool &dirty)
+{
+  bool hasShadow = (shadowIdx < _shadowCount);
+  uint16_t shadowID = hasShadow ? (_shadowProperties[shadowIdx].id & ~kShadowDirty) : 0;
+
+  while (pendingIdx < _pendingCount) {
+    const PropertyEntry &pending = _pendingProperties[pendingIdx];
+    if (hasShadow && pending.id == shadowID) {
+      pendingIdx++;
+      continue;
+    }
+    if (!hasShadow || pending.id < shadowID) {
+      entry = pending;
+      dirty = true;
+      return true;
+    }
+    break;
+  }
+
+  if (!hasShadow) return false;
+  entry.id = shadowID;
+  entry.value = _shadowProperties[shadowIdx].value;
+  dirty = (_shadowProperties[shadowIdx].id & kShadowDirty) != 0;
+  return true;
 }
 
 
-bool Si446x::waitForCTS(uint16_t timeout)
-{ 
-  return waitForReply(0, 0, timeout);
+/**
+ * Turns the shadow copy on: table holds the last value written to up to
+ * size properties, and writes of the same value again are dropped. Size it
+ * for the properties the application sets, e.g. the WDS configuration
+ * stream and the setters after it; properties beyond that are always
+ * written. Without a table (the default, or null) nothing is remembered.
+ * Writes still held back are committed first; returns false, keeping the
+ * old table, if that fails.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::setShadowTable(PropertyEntry *table, uint8_t size)
+{
+  if (!commit()) return false;
+  _shadowProperties = table;
+  _shadowSize = table ? size : 0;
+  _shadowCount = 0;
+  return true;
 }
 
 
-bool Si446x::sendCommand(uint8_t cmd, const uint8_t *data, uint8_t dataLength, uint8_t *reply, uint8_t replyLength, bool pollCTS)
+/**
+ * Forgets the shadow values, e.g. after the radio was reset. Writes that
+ * were not committed yet are kept.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::invalidateProperties()
 {
-  if (pollCTS) {
-    if (!waitForCTS())
-      return false;
+  uint8_t count = 0;
+  for (uint8_t idx = 0; idx < _shadowCount; idx++) {
+    if (_shadowProperties[idx].id & kShadowDirty) {
+      _shadowProperties[count++] = _shadowProperties[idx];
+    }
   }
-  
-  SPIDevice::select();
-  SPIDevice::write(cmd);
-  for(; dataLength; dataLength--) {
-    uint8_t x = *(data++);
-    SPIDevice::write(x);
+  _shadowCount = count;
+}
+
+
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::getShadowProperty(uint16_t id, uint8_t &value)
+{
+  uint8_t pos;
+  if (!findShadowProperty(id, pos)) return false;
+  value = _shadowProperties[pos].value;
+  return true;
+}
+
+
+/**
+ * Reads up to 16 consecutive properties of one group from the radio.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::getProperties(uint16_t id, uint8_t *values, uint8_t count)
+{
+  if (count > 16) count = 16;
+  uint8_t data[] = { (uint8_t)(id >> 8), count, (uint8_t)id };
+  return sendCommand(SI_CMD_GET_PROPERTY, data, sizeof(data), values, count);
+}
+
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::resetPropertyCounters()
+{
+  memset(&_propertyCounters, 0, sizeof(_propertyCounters));
+}
+
+
+/**
+ * Sets properties from SET_PROPERTY arguments: group, count, start index
+ * and the values. Values equal to the shadow copy are dropped; the rest is
+ * written right away or, inside beginProperties(), on flush.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::setProperties(const uint8_t *args, uint8_t length)
+{
+  uint8_t count = args[1];
+  if (count > length - 3) count = length - 3;
+
+  _propertyCounters.requested++;
+  _propertyCounters.requestedBytes += 4 + count;
+
+  uint16_t id = (args[0] << 8) | args[2];
+  bool success = true;
+
+  beginProperties();
+  for (uint8_t idx = 0; idx < count; idx++) {
+    if (!stageProperty(id + idx, args[3 + idx])) success = false;
   }
-  delayMicroseconds(1); /* Select hold time min 50 ns */
-  SPIDevice::release();
+  if (!flushProperties()) success = false;
+  return success;
+}
 
-  if (replyLength == 0) {
+
+/**
+ * Records a property value in the shadow table, marking it dirty if it
+ * changed. Properties that do not fit in the table go to the pending list.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::stageProperty(uint16_t id, uint8_t value)
+{
+  uint8_t pos;
+  if (findShadowProperty(id, pos)) {
+    PropertyEntry &entry = _shadowProperties[pos];
+    if (entry.value != value) {
+      entry.value = value;
+      entry.id |= kShadowDirty;
+    }
     return true;
   }
-  else {
-    return waitForReply(reply, replyLength);
+
+  if (_shadowCount < _shadowSize) {
+    for (uint8_t idx = _shadowCount; idx > pos; idx--) {
+      _shadowProperties[idx] = _shadowProperties[idx - 1];
+    }
+    _shadowProperties[pos].id = id | kShadowDirty;
+    _shadowProperties[pos].value = value;
+    _shadowCount++;
+    return true;
   }
+
+  return queueProperty(id, value);
 }
 
 
-bool Si446x::sendImmediate(uint8_t cmd, uint8_t *reply, uint8_t replyLength, bool pollCTS)
+/**
+ * Binary search in the shadow table, which is sorted by property ID. On a
+ * miss pos is where the entry would be inserted.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::findShadowProperty(uint16_t id, uint8_t &pos)
 {
-  if (pollCTS) {
-    if (!waitForCTS())
-      return false;
-  }
-  
-  SPIDevice::select();
-  SPIDevice::write(cmd);
-  for(; replyLength; replyLength--) {
-    uint8_t x = SPIDevice::read();
-    *(reply++) = x;
+  uint8_t lo = 0;
+  uint8_t hi = _shadowCount;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    uint16_t midID = _shadowProperties[mid].id & ~kShadowDirty;
+    if (midID == id) {
+      pos = mid;
+      return true;
+    }
+    if (midID < id) lo = mid + 1;
+    else hi = mid;
   }
-  delayMicroseconds(1); /* Select hold time min 50 ns */
-  SPIDevice::release();
-
-  return true;
+  pos = lo;
+  return false;
 }
 
 
+/**
+ * Adds a write to the pending list. A later write to the same property
+ * replaces the earlier one. A full list is sent out early; should that
+ * fail, the write is still kept if it made room.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::queueProperty(uint16_t id, uint8_t value)
+{
+  if (insertProperty(id, value, true)) return true;
+
+  bool success = commit();
+  if (!insertProperty(id, value, true)) return false;
+  return success;
+}
+
 
-bool Si446x::configure(uint8_t *params)
+/**
+ * Inserts into the pending list, kept sorted by property ID. An entry for
+ * the same property is overwritten only with replace. Returns false if the
+ * list is full.
+ */
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::insertProperty(uint16_t id, uint8_t value, bool replace)
 {
-  while (*params != 0) {
-    uint8_t length = *params;
-    params++;
-   
-    if (!sendCommand(*params, params + 1, length - 1)) {
-      return false;
-    }
-    if (!waitForReply(0, 0)) {
-      return false;
-    }
-    
-    params += length;
+  uint8_t pos = 0;
+  while (pos < _pendingCount && _pendingProperties[pos].id < id) pos++;
+
+  if (pos < _pendingCount && _pendingProperties[pos].id == id) {
+    if (replace) _pendingProperties[pos].value = value;
+    return true;
+  }
+
+  if (_pendingCount == SI446X_PROPERTY_QUEUE) return false;
+
+  for (uint8_t idx = _pendingCount; idx > pos; idx--) {
+    _pendingProperties[idx] = _pendingProperties[idx - 1];
   }
+  _pendingProperties[pos].id = id;
+  _pendingProperties[pos].value = value;
+  _pendingCount++;
   return true;
 }
 
-void Si446x::powerUpXTAL(uint8_t bootOptions) 
+
+template <class Transport, class Clock>
+bool Si446xT<Transport, Clock>::writeProperties(uint16_t id, const uint8_t *values, uint8_t count)
+{
+  uint8_t data[3 + kMaxPropertyRun];
+
+  data[0] = (uint8_t)(id >> 8);
+  data[1] = count;
+  data[2] = (uint8_t)id;
+  memcpy(data + 3, values, count);
+
+  _propertyCounters.sent++;
+  _propertyCounters.sentBytes += 4 + count;
+
+  CommandHandle handle = submitCommand(SI_CMD_SET_PROPERTY, data, 3 + count, 0, 0, kCommandProperty);
+  return _async || waitForCommand(handle);
+}
+
+
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::powerUpXTAL(uint8_t bootOptions) 
 {
   uint8_t xtalOptions = 0x00;
 
@@ -219,9 +1351,11 @@ void Si446x::powerUpXTAL(uint8_t bootOptions)
   };
 
   sendCommand(SI_CMD_POWER_UP, data, sizeof(data));
+  invalidateProperties();
 }
 
-void Si446x::powerUpTCXO(uint8_t bootOptions) 
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::powerUpTCXO(uint8_t bootOptions) 
 {
   uint8_t xtalOptions = 0x01;
 
@@ -234,18 +1368,21 @@ void Si446x::powerUpTCXO(uint8_t bootOptions)
   };
 
   sendCommand(SI_CMD_POWER_UP, data, sizeof(data));
+  invalidateProperties();
 }
 
-void Si446x::setXOTune(uint8_t xoTune)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setXOTune(uint8_t xoTune)
 {
   uint8_t data[] = { 
     0x00, 0x02, 0x00, xoTune, 0x00
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
 
-int16_t Si446x::getTemperature()
+template <class Transport, class Clock>
+int16_t Si446xT<Transport, Clock>::getTemperature()
 {
   uint8_t reply[8];
 
@@ -266,7 +1403,8 @@ int16_t Si446x::getTemperature()
 }
 
 
-void Si446x::setModulation(ModulationType modType, ModulationSource modSource, uint8_t txDirectModeGPIO, uint8_t txDirectModeType)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setModulation(ModulationType modType, ModulationSource modSource, uint8_t txDirectModeGPIO, uint8_t txDirectModeType)
 {
   uint8_t mode = 
     ((txDirectModeType & 1) << 7) |
@@ -278,11 +1416,12 @@ void Si446x::setModulation(ModulationType modType, ModulationSource modSource, u
     0x20, 0x03, 0x00, 
     mode, 0x00, 0x07
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
 
-void Si446x::changeState(Si446x::State state)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::changeState(State state)
 {
   uint8_t data[] = { 
     (uint8_t)state
@@ -291,18 +1430,21 @@ void Si446x::changeState(Si446x::State state)
 }
 
 
-void Si446x::enableTX(void)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::enableTX(void)
 {
   changeState(kStateTX);
 }
 
 
-void Si446x::disableRadio(void)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::disableRadio(void)
 {
   changeState(kStateReady);
 }
 
-void Si446x::setFrequency(uint32_t freq)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setFrequency(uint32_t freq)
 {
   // Set the output divider according to recommended ranges given in Si446x datasheet  
   _outDiv = 4;
@@ -329,7 +1471,7 @@ void Si446x::setFrequency(uint32_t freq)
   {
     uint8_t data[] = { 
       0x20, 0x01, 0x51, band };
-    sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+    setProperties(data, sizeof(data));
   }
     
   // Set the step size
@@ -346,13 +1488,14 @@ void Si446x::setFrequency(uint32_t freq)
       (uint8_t)(m), 
       //size_1, size_0
     };
-    sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+    setProperties(data, sizeof(data));
   }
   
   //changeState(kStateTXTune);
 }
 
-void Si446x::startTX(uint8_t channel, uint16_t pktLength, State txCompleteState)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::startTX(uint8_t channel, uint16_t pktLength, State txCompleteState)
 {
   uint8_t data[] = { 
     channel, 
@@ -370,7 +1513,8 @@ void Si446x::startTX(uint8_t channel, uint16_t pktLength, State txCompleteState)
   sendCommand(SI_CMD_START_TX, data, sizeof(data), 0, 0, false);
 }
 
-void Si446x::startRX(uint8_t channel, uint16_t pktLength, State preambleTimeoutState, State validPacketState, State invalidPacketState)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::startRX(uint8_t channel, uint16_t pktLength, State preambleTimeoutState, State validPacketState, State invalidPacketState)
 {
   uint8_t data[] = { 
     channel, 
@@ -386,17 +1530,43 @@ void Si446x::startRX(uint8_t channel, uint16_t pktLength, State preambleTimeoutS
   sendCommand(SI_CMD_START_RX, data, sizeof(data), 0, 0, false);
 }
 
-void Si446x::writeTX(const uint8_t *data, uint8_t length)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::writeTX(const uint8_t *data, uint8_t length)
 {
   sendCommand(SI_CMD_WRITE_TX_FIFO, data, length, 0, 0, false);
 }
 
-void Si446x::readRX(uint8_t *data, uint8_t length)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::readRX(uint8_t *data, uint8_t length)
 {
   sendImmediate(SI_CMD_READ_RX_FIFO, data, length, false);
 }
 
-void Si446x::configureGPIO(uint8_t gpio0, uint8_t gpio1, uint8_t gpio2, uint8_t gpio3, uint8_t nirq, uint8_t sdo, uint8_t genConfig)
+/**
+ * Reads length + wrapLength bytes in one FIFO read, the first part into
+ * data and the rest into wrapData, e.g. both halves of a ring buffer's free
+ * space. A null buffer discards its part.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::readRX(uint8_t *data, uint8_t length, uint8_t *wrapData, uint8_t wrapLength)
+{
+  typename SPIDevice::Transaction bus(*this);
+
+  waitForIdle();
+
+  SPIDevice::select();
+  SPIDevice::write(SI_CMD_READ_RX_FIFO);
+  SPIDevice::transfer(0, data, length);
+  SPIDevice::transfer(0, wrapData, wrapLength);
+  Clock::delayMicroseconds(1); /* Select hold time min 50 ns */
+  SPIDevice::release();
+#if SI446X_STATS
+  recordCommand(SI_CMD_READ_RX_FIFO, 1, length + wrapLength);
+#endif
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::configureGPIO(uint8_t gpio0, uint8_t gpio1, uint8_t gpio2, uint8_t gpio3, uint8_t nirq, uint8_t sdo, uint8_t genConfig)
 {
   uint8_t data[] = { gpio0, gpio1, gpio2, gpio3, nirq, sdo, genConfig };
 
@@ -406,28 +1576,31 @@ void Si446x::configureGPIO(uint8_t gpio0, uint8_t gpio1, uint8_t gpio2, uint8_t
 }
 
 
-void Si446x::setPreambleLength(uint8_t length)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setPreambleLength(uint8_t length)
 {
   uint8_t data[] = { 
     0x10, 0x01, 0x00,
     length
   };
 
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
-void Si446x::setPreambleConfig(uint8_t config)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setPreambleConfig(uint8_t config)
 {
   uint8_t data[] = { 
     0x10, 0x01, 0x04,
     config
   };
 
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
 
-void Si446x::setSync(uint8_t config, uint16_t syncWord)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setSync(uint8_t config, uint16_t syncWord)
 {
   uint8_t data[] = { 
     0x11, 0x03, 0x00,
@@ -436,22 +1609,24 @@ void Si446x::setSync(uint8_t config, uint16_t syncWord)
     (uint8_t)(syncWord)
   };
 
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
 
-void Si446x::setPowerLevel(uint8_t level)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setPowerLevel(uint8_t level)
 {
   uint8_t data[] = { 
     0x22, 0x01, 0x01,
     level
   };
 
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));  
+  setProperties(data, sizeof(data));  
 }
 
 
-void Si446x::setNCOModulo(NCOModulo osr, uint32_t ncoFreq) {
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setNCOModulo(NCOModulo osr, uint32_t ncoFreq) {
   //uint32_t ncoFreq;
   //switch (osr) {
   //  case kModulo10: ncoFreq = _xtalFrequency / 10; break;
@@ -467,11 +1642,12 @@ void Si446x::setNCOModulo(NCOModulo osr, uint32_t ncoFreq) {
     (uint8_t)(ncoFreq),
   };
   
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
 
-void Si446x::setDataRate(uint32_t dataRate)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setDataRate(uint32_t dataRate)
 {
   uint8_t data[] = { 
     0x20, 0x03, 0x03,
@@ -479,11 +1655,12 @@ void Si446x::setDataRate(uint32_t dataRate)
     (uint8_t)(dataRate >> 8),
     (uint8_t)(dataRate),
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
 
-void Si446x::setDeviation(uint32_t deviation)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setDeviation(uint32_t deviation)
 {
   uint32_t x = ((uint64_t)(1ul << 18) * _outDiv * deviation)/ _xtalFrequency;
 
@@ -493,59 +1670,263 @@ void Si446x::setDeviation(uint32_t deviation)
     (uint8_t)(x >> 8),
     (uint8_t)(x)
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, 6);
+  setProperties(data, sizeof(data));
 }
 
 
-void Si446x::flushTX()
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::flushTX()
 {
   uint8_t data[] = { 0x01 };
   sendCommand(SI_CMD_FIFO_INFO, data, sizeof(data));
 }
 
-void Si446x::flushRX()
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::flushRX()
 {
   uint8_t data[] = { 0x02 };
   sendCommand(SI_CMD_FIFO_INFO, data, sizeof(data));
 }
 
-uint8_t Si446x::getAvailableRX()
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::getFIFOInfo(FIFOInfo &info)
 {
   uint8_t data[] = { 0x00 };
+  sendCommand(SI_CMD_FIFO_INFO, data, sizeof(data), info.rawData, sizeof(info.rawData));
+}
+
+template <class Transport, class Clock>
+uint8_t Si446xT<Transport, Clock>::getAvailableRX()
+{
+  FIFOInfo info;
+  getFIFOInfo(info);
+  return info.getRXCount();
+}
+
+/**
+ * PACKET_INFO: length of the variable length field of the last packet.
+ */
+template <class Transport, class Clock>
+uint16_t Si446xT<Transport, Clock>::getPacketLength()
+{
   uint8_t reply[2];
-  sendCommand(SI_CMD_FIFO_INFO, data, sizeof(data), reply, 2);
-  return reply[0];
+  sendCommand(SI_CMD_PACKET_INFO, 0, 0, reply, 2);
+  return (reply[0] << 8) | reply[1];
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::readPacketFormat(RXBuffer &buffer)
+{
+  // PKT_LEN, PKT_LEN_FIELD_SOURCE, PKT_LEN_ADJUST, PKT_TX_THRESHOLD,
+  // PKT_RX_THRESHOLD, PKT_FIELD_1_LENGTH (2)
+  uint8_t data[] = { (uint8_t)(RF_PKT_LEN >> 8), 7, (uint8_t)RF_PKT_LEN };
+  uint8_t reply[7];
+  sendCommand(SI_CMD_GET_PROPERTY, data, sizeof(data), reply, sizeof(reply));
+  setPacketFormat(buffer, reply);
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setPacketFormat(RXBuffer &buffer, const uint8_t *reply)
+{
+  buffer.lengthConfig = reply[0];
+  buffer.lengthAdjust = (int8_t)reply[2];
+  buffer.fixedLength = ((reply[5] & 0x1F) << 8) | reply[6];
+  buffer.formatKnown = true;
+}
+
+/**
+ * Drains the RX FIFO into buffer with a single FIFO read and splits what
+ * arrived into packets with takePackets(). Returns the number of
+ * descriptors filled in.
+ */
+template <class Transport, class Clock>
+uint8_t Si446xT<Transport, Clock>::receivePackets(RXBuffer &buffer, Packet *packets, uint8_t maxPackets)
+{
+  typename SPIDevice::Transaction bus(*this);
+
+  buffer.compact();
+  if (!buffer.formatKnown) readPacketFormat(buffer);
+
+  bool variable = (buffer.lengthConfig & 0x07) != 0;
+  if (variable && !(buffer.lengthConfig & 0x08)) buffer.packetLength = getPacketLength();
+
+  uint8_t count = getAvailableRX();
+  if (count > buffer.size - buffer.end) count = buffer.size - buffer.end;
+  if (count > 0) {
+    readRX(buffer.data + buffer.end, count);
+    buffer.end += count;
+  }
+  return takePackets(buffer, packets, maxPackets);
+}
+
+/**
+ * Splits the bytes buffer holds into packets, without touching the radio
+ * unless a length is garbage; then the buffer is emptied and a FIFO flush
+ * queued. With a length field stored in the FIFO (PKT_LEN IN_FIFO) every
+ * queued packet is found from its own length; fixed length packets use the
+ * field 1 length. A variable length that is not stored comes from
+ * PACKET_INFO, which only describes the last packet: a drain must then hold
+ * exactly that one packet, so drain on every PACKET_RX. A drain holding
+ * more cannot be split and is dropped the same way. Returns the number of
+ * descriptors filled in.
+ */
+template <class Transport, class Clock>
+uint8_t Si446xT<Transport, Clock>::takePackets(RXBuffer &buffer, Packet *packets, uint8_t maxPackets)
+{
+  buffer.compact();
+
+  bool variable = (buffer.lengthConfig & 0x07) != 0;
+  bool lengthInFIFO = variable && (buffer.lengthConfig & 0x08);
+  uint8_t lengthSize = (buffer.lengthConfig & 0x10) ? 2 : 1;
+
+  if (variable && !lengthInFIFO) {
+    uint8_t left = buffer.end - buffer.start;
+    uint16_t length = buffer.packetLength;
+    if (left == 0 || maxPackets == 0) return 0;
+    if (length == 0 || left > length) {
+      buffer.start = buffer.end = 0;
+      flushRXAsync();
+      return 0;
+    }
+    if (left < length) return 0;
+
+    packets[0].offset = buffer.start;
+    packets[0].length = length;
+    buffer.start = buffer.end;
+    return 1;
+  }
+
+  uint16_t fixedLength = buffer.fixedLength;
+  if (!variable) lengthSize = 0;
+
+  uint8_t found = 0;
+  while (found < maxPackets) {
+    uint8_t left = buffer.end - buffer.start;
+    if (left == 0 || left < lengthSize) break;
+
+    const uint8_t *header = buffer.data + buffer.start;
+    int16_t length = fixedLength;
+    if (lengthInFIFO) {
+      if (lengthSize == 1) length = header[0];
+      else if (buffer.lengthConfig & 0x20) length = (header[0] << 8) | header[1];
+      else length = (header[1] << 8) | header[0];
+      length += buffer.lengthAdjust;
+    }
+
+    if (length <= 0 || lengthSize + length > buffer.size) {
+      // Garbage length: nothing after it can be trusted
+      buffer.start = buffer.end = 0;
+      flushRXAsync();
+      break;
+    }
+    if (lengthSize + length > left) break;
+
+    packets[found].offset = buffer.start + lengthSize;
+    packets[found].length = length;
+    found++;
+    buffer.start += lengthSize + length;
+  }
+  return found;
+}
+
+template <class Transport, class Clock>
+uint8_t Si446xT<Transport, Clock>::getTXSpace()
+{
+  FIFOInfo info;
+  getFIFOInfo(info);
+  return info.getTXSpace();
+}
+
+/**
+ * TX FIFO almost empty fires when at least this many bytes of the FIFO are
+ * free.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setTXThreshold(uint8_t threshold)
+{
+  setParameter(RF_PKT_TX_THRESHOLD, threshold);
+}
+
+/**
+ * RX FIFO almost full fires when at least this many bytes are waiting.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setRXThreshold(uint8_t threshold)
+{
+  setParameter(RF_PKT_RX_THRESHOLD, threshold);
 }
 
-void Si446x::getIntStatus(void)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::getIntStatus(void)
 {
   uint8_t data[] = { 0x00, 0x00, 0x00 };
   //uint8_t data[] = { 0xFF, 0xFF, 0xFF };
   sendCommand(SI_CMD_GET_INT_STATUS, data, sizeof(data));
 }
 
-void Si446x::getIntStatus(IRQStatus &status)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::getIntStatus(IRQStatus &status)
 {
   uint8_t data[] = { 0x00, 0x00, 0x00 };
   sendCommand(SI_CMD_GET_INT_STATUS, data, sizeof(data), status.rawData, 8);
 }
 
-void Si446x::getModemStatus(ModemStatus &status)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::getModemStatus(ModemStatus &status)
 {
   sendCommand(SI_CMD_GET_MODEM_STATUS, 0, 0, status.rawData, 8);
 }
 
-void Si446x::getChipStatus(ChipStatus &status)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::getChipStatus(ChipStatus &status)
 {
   sendCommand(SI_CMD_GET_CHIP_STATUS, 0, 0, status.rawData, 3);
 }
 
-void Si446x::getPartInfo(PartInfo &info)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setFRRModes(FRRMode a, FRRMode b, FRRMode c, FRRMode d)
+{
+  uint8_t data[] = { 
+    0x02, 0x04, 0x00,
+    (uint8_t)a,
+    (uint8_t)b,
+    (uint8_t)c,
+    (uint8_t)d
+  };
+  setProperties(data, sizeof(data));
+}
+
+/**
+ * Reads 1..4 Fast Response Registers starting at FRR A. The registers are
+ * clocked out back to back in one CS frame and need no CTS.
+ */
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::readFRR(uint8_t *values, uint8_t count)
+{
+  if (count > 4) count = 4;
+  sendImmediate(SI_CMD_FRR_A_READ, values, count, false);
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::configureFastStatus()
+{
+  setFRRModes(kFRRPHPending, kFRRModemPending, kFRRLatchedRSSI, kFRRCurrentState);
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::getFastStatus(FastStatus &status)
+{
+  readFRR(status.rawData, sizeof(status.rawData));
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::getPartInfo(PartInfo &info)
 {
   sendCommand(SI_CMD_PART_INFO, 0, 0, info.rawData, 8);
 }
 
-void Si446x::setIntControl(bool enableChipInt, bool enableModemInt, bool enablePHInt)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setIntControl(bool enableChipInt, bool enableModemInt, bool enablePHInt)
 {
   uint8_t x = 0;
   if (enableChipInt) x |= 0x04;
@@ -556,34 +1937,59 @@ void Si446x::setIntControl(bool enableChipInt, bool enableModemInt, bool enableP
     0x01, 0x01, 0x00,
     x
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
-void Si446x::setPHInterrupts(uint8_t mask)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setPHInterrupts(uint8_t mask)
 {
   uint8_t data[] = { 
     0x01, 0x01, 0x01,
     mask
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setModemInterrupts(uint8_t mask)
+{
+  uint8_t data[] = { 
+    0x01, 0x01, 0x02,
+    mask
+  };
+  setProperties(data, sizeof(data));
+}
+
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setChipInterrupts(uint8_t mask)
+{
+  uint8_t data[] = { 
+    0x01, 0x01, 0x03,
+    mask
+  };
+  setProperties(data, sizeof(data));
 }
 
-void Si446x::setGlobalConfig(uint8_t globalConfig)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setGlobalConfig(uint8_t globalConfig)
 {
   setParameter(RF_GLOBAL_CONFIG, globalConfig);
 }
 
-void Si446x::setPacketConfig(uint8_t config)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setPacketConfig(uint8_t config)
 {
   setParameter(RF_PKT_CONFIG1, config);
 }
 
-void Si446x::setField1Config(uint8_t config)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setField1Config(uint8_t config)
 {
   setParameter(RF_PKT_FIELD_1_CONFIG, config);
 }
 
-void Si446x::setModemParams(uint8_t modemControl, uint8_t ifControl, uint32_t ifFreq, uint8_t cfg1, uint8_t cfg2)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setModemParams(uint8_t modemControl, uint8_t ifControl, uint32_t ifFreq, uint8_t cfg1, uint8_t cfg2)
 {  
   uint8_t data[] = { 
     0x20, 0x07, 0x19,
@@ -595,10 +2001,11 @@ void Si446x::setModemParams(uint8_t modemControl, uint8_t ifControl, uint32_t if
     cfg1, 
     cfg2
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
-void Si446x::setBCRParams(uint16_t osr, uint32_t ncoOffset, uint16_t gain, uint8_t gear, uint8_t misc1)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setBCRParams(uint16_t osr, uint32_t ncoOffset, uint16_t gain, uint8_t gear, uint8_t misc1)
 {  
   uint8_t data[] = { 
     0x20, 0x09, 0x22,
@@ -612,10 +2019,11 @@ void Si446x::setBCRParams(uint16_t osr, uint32_t ncoOffset, uint16_t gain, uint8
     gear,
     misc1
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
-void Si446x::setPAConfig(uint8_t mode, uint8_t level, uint8_t duty, uint8_t tc)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setPAConfig(uint8_t mode, uint8_t level, uint8_t duty, uint8_t tc)
 {
   uint8_t data[] = { 
     0x22, 0x04, 0x00,
@@ -624,10 +2032,11 @@ void Si446x::setPAConfig(uint8_t mode, uint8_t level, uint8_t duty, uint8_t tc)
     duty,
     tc
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
-void Si446x::setParameter(uint16_t id, uint8_t value)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setParameter(uint16_t id, uint8_t value)
 {
   uint8_t data[] = { 
     (uint8_t)(id >> 8),
@@ -635,10 +2044,11 @@ void Si446x::setParameter(uint16_t id, uint8_t value)
     (uint8_t)id,
     value
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
-void Si446x::setParameter16(uint16_t id, uint16_t value)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setParameter16(uint16_t id, uint16_t value)
 {
   uint8_t data[] = { 
     (uint8_t)(id >> 8),
@@ -647,28 +2057,34 @@ void Si446x::setParameter16(uint16_t id, uint16_t value)
     (uint8_t)(value >> 8),
     (uint8_t)(value)
   };
-  sendCommand(SI_CMD_SET_PROPERTY, data, sizeof(data));
+  setProperties(data, sizeof(data));
 }
 
-uint8_t Si446x::getState()
+template <class Transport, class Clock>
+uint8_t Si446xT<Transport, Clock>::getState()
 { 
   uint8_t reply[2]; 
   sendCommand(SI_CMD_REQUEST_DEVICE_STATE, 0, 0, reply, 2);
   return reply[0] & 0x0F;
 }
 
-void Si446x::setRSSIMode(uint8_t mode)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setRSSIMode(uint8_t mode)
 {
   setParameter(RF_MODEM_RSSI_CONTROL, mode);
 }
 
-void Si446x::setRSSIComp(uint8_t comp)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setRSSIComp(uint8_t comp)
 {
   setParameter(RF_MODEM_RSSI_COMP, comp);
 }
 
-void Si446x::setRSSIThreshold(uint8_t threshold)
+template <class Transport, class Clock>
+void Si446xT<Transport, Clock>::setRSSIThreshold(uint8_t threshold)
 {
   setParameter(RF_MODEM_RSSI_THRESHOLD, threshold);
 }
 
+
+template class Si446xT<>;
@@ -1,34 +1,519 @@
+#ifndef SI4X6X_H_
+#define SI4X6X_H_
+
 #include "Arduino.h"
 #include <SPI.h>
 
-class SPIDevice {
+// Set to 1 to collect per-command traffic counters and CTS wait histograms (costs RAM)
+#ifndef SI446X_STATS
+#define SI446X_STATS 0
+#endif
+
+// Number of property writes that can be held back by beginProperties()
+#ifndef SI446X_PROPERTY_QUEUE
+#define SI446X_PROPERTY_QUEUE 32
+#endif
+
+// Number of commands the asynchronous API can hold before it has to wait
+#ifndef SI446X_COMMAND_QUEUE
+#define SI446X_COMMAND_QUEUE 4
+#endif
+
+// Set to 1 to let SPIDevice log its traffic to an SPITrace
+#ifndef SI446X_TRACE
+#define SI446X_TRACE 0
+#endif
+
+#if SI446X_TRACE
+#include "si4x6x_trace.h"
+#endif
+
+/**
+ * Burst helpers shared by the transports: staged and program memory
+ * transfers built on Derived::transfer(buf, n), a synchronous
+ * transferAsync(), and byte writes and status reads built on
+ * Derived::transfer(x).
+ */
+template <class Derived>
+class SPIBurst {
 public:
-  SPIDevice(int pinCS) : _pinCS(pinCS) {}
+  typedef void (*Callback)(void *context);
 
-  void select() {
-    digitalWrite(_pinCS, LOW);
+  // A byte whose answer is not needed
+  void write(uint8_t x) {
+    static_cast<Derived &>(*this).transfer(x);
+  }
+
+  /**
+   * Reads a status byte and, only if it equals ready, n more bytes into rx
+   * in the same frame. Returns the status byte.
+   */
+  uint8_t readStatus(uint8_t ready, uint8_t *rx, size_t n) {
+    Derived &self = static_cast<Derived &>(*this);
+    uint8_t status = self.transfer(0xFF);
+    if (status == ready && n > 0) self.transferStaged(0, rx, n);
+    return status;
+  }
+
+  /**
+   * Clocks n bytes in one burst. Either buffer may be null: a null tx sends
+   * 0xFF filler, a null rx discards whatever comes back.
+   */
+  void transferStaged(const uint8_t *tx, uint8_t *rx, size_t n) {
+    Derived &self = static_cast<Derived &>(*this);
+    if (rx != 0) {
+      if (tx == 0) memset(rx, 0xFF, n);
+      else if (tx != rx) memmove(rx, tx, n);
+      self.transfer(rx, n);
+      return;
+    }
+    // The burst works in place, so stage constant data in small chunks
+    uint8_t chunk[kChunkSize];
+    while (n > 0) {
+      size_t len = (n < kChunkSize) ? n : kChunkSize;
+      if (tx != 0) {
+        memcpy(chunk, tx, len);
+        tx += len;
+      }
+      else memset(chunk, 0xFF, len);
+      self.transfer(chunk, len);
+      n -= len;
+    }
+  }
+
+  /**
+   * Sends n bytes from program memory (PROGMEM), staged through the same
+   * small chunk buffer rather than a full RAM copy.
+   */
+  void transfer_P(const uint8_t *tx, size_t n) {
+    Derived &self = static_cast<Derived &>(*this);
+    uint8_t chunk[kChunkSize];
+    while (n > 0) {
+      size_t len = (n < kChunkSize) ? n : kChunkSize;
+      memcpy_P(chunk, tx, len);
+      self.transfer(chunk, len);
+      tx += len;
+      n -= len;
+    }
+  }
+
+  void transferAsync(const uint8_t *tx, uint8_t *rx, size_t n, Callback callback, void *context) {
+    transferStaged(tx, rx, n);
+    callback(context);
+  }
+
+private:
+  enum { kChunkSize = 16 };
+};
+
+/**
+ * Moves bytes to and from SPI devices. This default drives the Arduino SPI
+ * library and a GPIO chip select; boards with DMA, and host builds, derive
+ * their own and hand it to the Si446x constructor. Every call goes through
+ * the vtable; see SPITransportRef for the compile-time alternatives.
+ */
+class SPITransport : public SPIBurst<SPITransport> {
+public:
+  virtual ~SPITransport() {}
+
+  virtual void beginTransaction() {
+    SPI.beginTransaction(SPISettings(1000000, MSBFIRST, SPI_MODE0));
+  }
+
+  virtual void endTransaction() {
+    SPI.endTransaction();
+  }
+
+  virtual void select(int pinCS) {
+    digitalWrite(pinCS, LOW);
+  }
+
+  virtual void release(int pinCS) {
+    digitalWrite(pinCS, HIGH);
+  }
+
+  virtual uint8_t transfer(uint8_t x) {
+    return SPI.transfer(x);
+  }
+
+  // Full duplex burst, in place
+  virtual void transfer(uint8_t *buf, size_t n) {
+    SPI.transfer(buf, n);
+  }
+
+  /**
+   * Starts an n byte burst and may return before it is done; callback runs
+   * once it is, possibly from an interrupt or another thread, so it should
+   * do no more than flag the completion. Either buffer may be null as for
+   * SPIDevice::transfer(). The buffers must stay valid until the callback.
+   * This default transfers synchronously and calls back before returning.
+   */
+  virtual void transferAsync(const uint8_t *tx, uint8_t *rx, size_t n, Callback callback, void *context) {
+    SPIBurst<SPITransport>::transferAsync(tx, rx, n, callback, context);
+  }
+
+  static SPITransport &getDefault() {
+    static SPITransport transport;
+    return transport;
+  }
+};
+
+/**
+ * Transport policies for SPIDeviceT and Si446xT, chosen at compile time.
+ * A policy is copied into each device and needs beginTransaction(),
+ * endTransaction(), select(pin), release(pin), transfer(x),
+ * transfer(buf, n), transferStaged(), transfer_P(), transferAsync(),
+ * write(x) and readStatus(); SPIBurst supplies the last five.
+ *
+ * SPITransportRef forwards to a runtime SPITransport, so transports can
+ * still be swapped per radio (DMA, threads) at the cost of a virtual call
+ * per byte. It converts from an SPITransport pointer, null meaning the
+ * default one. It is the default off AVR; on AVR it is opt-in with
+ * SI446X_TRANSPORT=SPITransportRef.
+ */
+class SPITransportRef {
+public:
+  typedef SPITransport::Callback Callback;
+
+  SPITransportRef(SPITransport *transport = 0)
+    : _transport(transport ? transport : &SPITransport::getDefault()) {}
+
+  void beginTransaction() { _transport->beginTransaction(); }
+  void endTransaction() { _transport->endTransaction(); }
+  void select(int pinCS) { _transport->select(pinCS); }
+  void release(int pinCS) { _transport->release(pinCS); }
+  uint8_t transfer(uint8_t x) { return _transport->transfer(x); }
+  void transfer(uint8_t *buf, size_t n) { _transport->transfer(buf, n); }
+  void write(uint8_t x) { _transport->write(x); }
+  uint8_t readStatus(uint8_t ready, uint8_t *rx, size_t n) { return _transport->readStatus(ready, rx, n); }
+  void transferStaged(const uint8_t *tx, uint8_t *rx, size_t n) { _transport->transferStaged(tx, rx, n); }
+  void transfer_P(const uint8_t *tx, size_t n) { _transport->transfer_P(tx, n); }
+
+  void transferAsync(const uint8_t *tx, uint8_t *rx, size_t n, Callback callback, void *context) {
+    _transport->transferAsync(tx, rx, n, callback, context);
+  }
+
+private:
+  SPITransport  *_transport;
+};
+
+/**
+ * The Arduino SPI library and digitalWrite() chip select without virtual
+ * calls. Also what host builds use to reach the simulated radio.
+ */
+class ArduinoSPITransport : public SPIBurst<ArduinoSPITransport> {
+public:
+  void beginTransaction() {
+    SPI.beginTransaction(SPISettings(1000000, MSBFIRST, SPI_MODE0));
+  }
+
+  void endTransaction() {
+    SPI.endTransaction();
+  }
+
+  void select(int pinCS) {
+    digitalWrite(pinCS, LOW);
+  }
+
+  void release(int pinCS) {
+    digitalWrite(pinCS, HIGH);
+  }
+
+  uint8_t transfer(uint8_t x) {
+    return SPI.transfer(x);
+  }
+
+  void transfer(uint8_t *buf, size_t n) {
+    SPI.transfer(buf, n);
+  }
+};
+
+#ifdef __AVR__
+/**
+ * AVR hardware SPI by its registers: SPDR/SPSR for data, the chip select
+ * port and bit looked up once. The SPI library still applies the bus
+ * settings per transaction.
+ */
+class AVRSPITransport : public SPIBurst<AVRSPITransport> {
+public:
+  AVRSPITransport() : _pinCS(-1), _port(0), _mask(0) {}
+
+  void beginTransaction() {
     SPI.beginTransaction(SPISettings(1000000, MSBFIRST, SPI_MODE0));
   }
 
+  void endTransaction() {
+    SPI.endTransaction();
+  }
+
+  void select(int pinCS) {
+    resolve(pinCS);
+    *_port &= ~_mask;
+  }
+
+  void release(int pinCS) {
+    resolve(pinCS);
+    *_port |= _mask;
+  }
+
+  uint8_t transfer(uint8_t x) {
+    SPDR = x;
+    asm volatile("nop");
+    while (!(SPSR & _BV(SPIF))) ;
+    return SPDR;
+  }
+
+  // Loads the next byte as soon as the previous one is in
+  void transfer(uint8_t *buf, size_t n) {
+    if (n == 0) return;
+    SPDR = *buf;
+    while (--n > 0) {
+      uint8_t out = *(buf + 1);
+      while (!(SPSR & _BV(SPIF))) ;
+      uint8_t in = SPDR;
+      SPDR = out;
+      *buf++ = in;
+    }
+    while (!(SPSR & _BV(SPIF))) ;
+    *buf = SPDR;
+  }
+
+private:
+  // Port register and bit of pinCS, looked up again only when the pin changes
+  void resolve(int pinCS) {
+    if (pinCS != _pinCS) {
+      _pinCS = pinCS;
+      _port = portOutputRegister(digitalPinToPort(pinCS));
+      _mask = digitalPinToBitMask(pinCS);
+    }
+  }
+
+  int               _pinCS;
+  volatile uint8_t  *_port;
+  uint8_t           _mask;
+};
+#endif
+
+// Clock policy: where Si446xT gets its microseconds and delays from
+struct ArduinoClock {
+  static uint32_t micros() { return ::micros(); }
+  static void delayMicroseconds(unsigned int us) { ::delayMicroseconds(us); }
+};
+
+// Header declaring a transport or clock policy defined outside this file,
+// e.g. "spidev_transport.h" for SI446X_TRANSPORT=SpidevTransport
+#ifdef SI446X_TRANSPORT_HEADER
+#include SI446X_TRANSPORT_HEADER
+#endif
+
+// Policies the Si446x and SPIDevice typedefs use; AVR drives SPDR directly
+#ifndef SI446X_TRANSPORT
+#ifdef __AVR__
+#define SI446X_TRANSPORT AVRSPITransport
+#else
+#define SI446X_TRANSPORT SPITransportRef
+#endif
+#endif
+
+#ifndef SI446X_CLOCK
+#define SI446X_CLOCK ArduinoClock
+#endif
+
+/**
+ * One chip on the bus: its chip select, transaction nesting and traffic
+ * counters, over a transport policy.
+ */
+template <class Transport>
+class SPIDeviceT {
+public:
+  struct Counters {
+    uint32_t arbitrations;  // SPI.beginTransaction() calls
+    uint32_t frames;        // CS select/release cycles
+    uint32_t bytes;         // bytes clocked, either way
+  };
+
+  /**
+   * Holds the bus settings for as long as the object lives, so a sequence of
+   * commands pays for one beginTransaction/endTransaction pair. CS still
+   * toggles for every command, and the bus is let go during CTS backoff
+   * pauses. Scopes may be nested.
+   */
+  class Transaction {
+  public:
+    Transaction(SPIDeviceT &device) : _device(device), _startFrames(device._counters.frames) {
+      _device.beginTransaction();
+    }
+
+    ~Transaction() {
+      _device.endTransaction();
+    }
+
+    uint32_t getFrames() const {
+      return _device._counters.frames - _startFrames;
+    }
+
+    // Arbitrations avoided compared to one transaction per CS frame
+    uint32_t getSavedArbitrations() const {
+      uint32_t frames = getFrames();
+      return (frames > 1) ? frames - 1 : 0;
+    }
+
+  private:
+    SPIDeviceT &_device;
+    uint32_t  _startFrames;
+  };
+
+  SPIDeviceT(int pinCS, const Transport &transport = Transport()) 
+    : _transport(transport), _pinCS(pinCS), _depth(0) 
+  {
+    _counters.arbitrations = 0;
+    _counters.frames = 0;
+    _counters.bytes = 0;
+#if SI446X_TRACE
+    _trace = 0;
+    _traceRXLength = 0;
+#endif
+  }
+
+#if SI446X_TRACE
+  // Records every following CS frame; 0 stops recording
+  void setTrace(SPITrace *trace) {
+    _trace = trace;
+  }
+#endif
+
+  void beginTransaction() {
+    if (_depth++ == 0) {
+      _transport.beginTransaction();
+      _counters.arbitrations++;
+    }
+  }
+
+  void endTransaction() {
+    if (--_depth == 0) {
+      _transport.endTransaction();
+    }
+  }
+
+  /**
+   * Lets other devices have the bus while an open Transaction scope waits
+   * with no frame in progress, e.g. during a CTS backoff.
+   */
+  void pauseTransaction() {
+    if (_depth > 0) _transport.endTransaction();
+  }
+
+  void resumeTransaction() {
+    if (_depth > 0) {
+      _transport.beginTransaction();
+      _counters.arbitrations++;
+    }
+  }
+
+  void select() {
+    beginTransaction();
+    _transport.select(_pinCS);
+    _counters.frames++;
+#if SI446X_TRACE
+    if (_trace) _trace->select(_pinCS, micros());
+#endif
+  }
+
   void write(uint8_t x) {
-    SPI.transfer(x);
+    _transport.write(x);
+    _counters.bytes++;
+#if SI446X_TRACE
+    if (_trace) _trace->record(SPITrace::kOut, &x, 1);
+#endif
   }
 
   uint8_t read() {
-    return SPI.transfer(0xFF);
+    uint8_t x = _transport.transfer(0xFF);
+    _counters.bytes++;
+#if SI446X_TRACE
+    if (_trace) _trace->record(SPITrace::kIn, &x, 1);
+#endif
+    return x;
+  }
+
+  // Status byte, then n bytes into rx only if it equals ready
+  uint8_t readStatus(uint8_t ready, uint8_t *rx, size_t n) {
+    uint8_t x = _transport.readStatus(ready, rx, n);
+    _counters.bytes += (x == ready) ? 1 + n : 1;
+#if SI446X_TRACE
+    if (_trace) {
+      _trace->record(SPITrace::kIn, &x, 1);
+      if (x == ready) _trace->record(SPITrace::kIn, rx, n);
+    }
+#endif
+    return x;
+  }
+
+  void transfer_P(const uint8_t *tx, size_t n) {
+    _transport.transfer_P(tx, n);
+    _counters.bytes += n;
+#if SI446X_TRACE
+    if (_trace) _trace->record(SPITrace::kOut, tx, n, true);
+#endif
+  }
+
+  // A full duplex transfer is recorded as the bytes sent
+  void transfer(const uint8_t *tx, uint8_t *rx, size_t n) {
+    _transport.transferStaged(tx, rx, n);
+    _counters.bytes += n;
+#if SI446X_TRACE
+    if (_trace) _trace->record(tx ? SPITrace::kOut : SPITrace::kIn, tx ? tx : rx, n);
+#endif
+  }
+
+  void transferAsync(const uint8_t *tx, uint8_t *rx, size_t n, typename Transport::Callback callback, void *context) {
+#if SI446X_TRACE
+    // Received bytes are only there once the burst is done, at release()
+    if (_trace && tx) _trace->record(SPITrace::kOut, tx, n);
+    _traceRX = rx;
+    _traceRXLength = tx ? 0 : n;
+#endif
+    _transport.transferAsync(tx, rx, n, callback, context);
+    _counters.bytes += n;
   }
 
   void release() {
-    SPI.endTransaction();
-    digitalWrite(_pinCS, HIGH);
+    _transport.release(_pinCS);
+#if SI446X_TRACE
+    if (_trace) {
+      _trace->record(SPITrace::kIn, _traceRX, _traceRXLength);
+      _trace->release(micros());
+    }
+    _traceRXLength = 0;
+#endif
+    endTransaction();
+  }
+
+  const Counters &getBusCounters() const {
+    return _counters;
   }
 
 private:
-  int _pinCS;
+  Transport     _transport;
+  int           _pinCS;
+  uint8_t       _depth;
+  Counters      _counters;
+#if SI446X_TRACE
+  SPITrace      *_trace;
+  uint8_t       *_traceRX;      // pending transferAsync() reply
+  size_t        _traceRXLength;
+#endif
 };
 
+typedef SPIDeviceT<SI446X_TRANSPORT> SPIDevice;
+
 class Si446xBase {
 public:
+  enum {
+    kFIFOSize         = 64,     // TX and RX FIFO, bytes
+    kMaxPacketLength  = 8191    // START_TX/START_RX length field
+  };
+
   enum ModulationType {
     kModCW    = 0,
     kModOOK   = 1,
@@ -50,6 +535,45 @@ public:
     kModulo40  = 1
   };  
 
+  enum PHInterrupt {
+    kIntFilterMatch       = 0x80,
+    kIntFilterMiss        = 0x40,
+    kIntPacketSent        = 0x20,
+    kIntPacketRX          = 0x10,
+    kIntCRCError          = 0x08,
+    kIntTXFIFOAlmostEmpty = 0x02,
+    kIntRXFIFOAlmostFull  = 0x01
+  };
+
+  enum ModemInterrupt {
+    kIntInvalidSync       = 0x20,
+    kIntRSSI              = 0x08,
+    kIntInvalidPreamble   = 0x04,
+    kIntPreambleDetect    = 0x02,
+    kIntSyncDetect        = 0x01
+  };
+
+  enum ChipInterrupt {
+    kIntFIFOError         = 0x20,
+    kIntStateChange       = 0x10,
+    kIntCommandError      = 0x08,
+    kIntChipReady         = 0x04
+  };
+
+  enum FRRMode {
+    kFRRDisabled      = 0,
+    kFRRIntStatus     = 1,
+    kFRRIntPending    = 2,
+    kFRRPHStatus      = 3,
+    kFRRPHPending     = 4,
+    kFRRModemStatus   = 5,
+    kFRRModemPending  = 6,
+    kFRRChipStatus    = 7,
+    kFRRChipPending   = 8,
+    kFRRCurrentState  = 9,
+    kFRRLatchedRSSI   = 10
+  };
+
   enum State {
     kStateNoChange  = 0,
     kStateSleep     = 1,
@@ -64,8 +588,102 @@ public:
 
 
 
-class Si446x : public Si446xBase, SPIDevice {
+/**
+ * The driver, over a transport policy (see SPITransportRef) and a clock
+ * policy (ArduinoClock), fixed at compile time so the bus calls inline.
+ * Si446x is the instance the rest of the library works with, picked by
+ * SI446X_TRANSPORT and SI446X_CLOCK; si4x6x.cpp instantiates it.
+ */
+template <class Transport = SI446X_TRANSPORT, class Clock = SI446X_CLOCK>
+class Si446xT : public Si446xBase, SPIDeviceT<Transport> {
+  typedef SPIDeviceT<Transport> SPIDevice;
+
 public:
+  /**
+   * Bus transaction scope for a sequence of radio commands, e.g. a status
+   * poll followed by a FIFO read.
+   */
+  class Transaction : public SPIDevice::Transaction {
+  public:
+    Transaction(Si446xT &radio) : SPIDevice::Transaction(radio) {}
+  };
+
+  using SPIDevice::Counters;
+  using SPIDevice::getBusCounters;
+#if SI446X_TRACE
+  using SPIDevice::setTrace;
+#endif
+
+  /**
+   * A property and its value, as held in the shadow table handed to
+   * setShadowTable().
+   */
+  struct PropertyEntry {
+    uint16_t  id;
+    uint8_t   value;
+  };
+
+  /**
+   * SET_PROPERTY traffic: what the setters asked for versus what was sent
+   * after coalescing. Bytes count the command byte, header and values.
+   */
+  struct PropertyCounters {
+    uint16_t  requested;
+    uint16_t  requestedBytes;
+    uint16_t  sent;
+    uint16_t  sentBytes;
+  };
+
+  // Identifies a queued command, 0 stands for none
+  typedef uint8_t CommandHandle;
+
+  typedef void (*CommandCallback)(CommandHandle handle, bool success, void *context);
+
+  enum CommandStatus {
+    kCommandUnknown = 0,    // never issued, or finished too long ago
+    kCommandQueued  = 1,    // waiting for its turn or for CTS
+    kCommandBusy    = 2,    // sent, waiting for the reply
+    kCommandDone    = 3,
+    kCommandFailed  = 4     // CTS or the reply timed out
+  };
+
+#if SI446X_STATS
+  /**
+   * Per-opcode traffic and CTS wait histograms. Bucket n counts waits of
+   * [2^n, 2^(n+1)) microseconds, bucket 0 also holds zero waits and the
+   * last bucket everything longer. CTS polls, their bytes, waits and
+   * timeouts are charged to the command the radio was busy with, i.e. the
+   * last one sent, and its reply bytes to the command that asked. bytesOut
+   * and bytesIn of all rows add up to every byte clocked on the bus.
+   * 16 bit counters stop at 0xFFFF.
+   */
+  struct Stats {
+    enum { 
+      kCommands   = 28,
+      kBuckets    = 14,
+      kRecordSize = 17 + 2 * kBuckets,  // packStats() record
+      kVersion    = 1
+    };
+
+    struct Command {
+      uint8_t   opcode;
+      uint16_t  calls;
+      uint16_t  timeouts;
+      uint32_t  ctsPolls;     // READ_CMD_BUFF frames
+      uint32_t  bytesOut;     // command, arguments, FIFO data, poll headers
+      uint32_t  bytesIn;      // replies, FIFO and FRR reads
+      uint16_t  ctsWait[kBuckets];
+    };
+
+    Command   commands[kCommands];
+  };
+
+  const Stats &getStats() const { return _stats; }
+  void resetStats();
+  uint8_t packStatsHeader(uint8_t *buffer) const;
+  uint8_t packStats(uint8_t index, uint8_t *buffer) const;
+#endif
+
   struct PartInfo {
     uint16_t getPartID() {
       return ((rawData[1] << 8) | rawData[2]);
@@ -91,6 +709,14 @@ public:
       return rawData[2] & (1 << 3);
     }
 
+    bool isTXFIFOAlmostEmptyPending() {
+      return rawData[2] & (1 << 1);
+    }
+
+    bool isRXFIFOAlmostFullPending() {
+      return rawData[2] & (1 << 0);
+    }
+
     bool isPacketSent() {
       return rawData[3] & (1 << 5);
     }
@@ -98,6 +724,18 @@ public:
     bool isPacketRX() {
       return rawData[3] & (1 << 4);
     }
+
+    uint8_t getPHPending() {
+      return rawData[2];
+    }
+
+    uint8_t getModemPending() {
+      return rawData[4];
+    }
+
+    uint8_t getChipPending() {
+      return rawData[6];
+    }
     
     uint8_t   rawData[8];
   };  
@@ -155,15 +793,139 @@ public:
     uint8_t   rawData[8];
   };     
 
+  /**
+   * Fast Response Register snapshot in the layout set up by
+   * configureFastStatus(): A = PH pending, B = modem pending,
+   * C = latched RSSI, D = current state.
+   */
+  struct FastStatus {
+    uint8_t getPHPending() {
+      return rawData[0];
+    }
+
+    uint8_t getModemPending() {
+      return rawData[1];
+    }
+
+    uint8_t getLatchedRSSI() {
+      return rawData[2];
+    }
+
+    uint8_t getState() {
+      return rawData[3] & 0x0F;
+    }
+
+    bool isPacketSentPending() {
+      return rawData[0] & (1 << 5);
+    }
+
+    bool isPacketRXPending() {
+      return rawData[0] & (1 << 4);
+    }
+
+    bool isCRCErrorPending() {
+      return rawData[0] & (1 << 3);
+    }
+
+    bool isSyncDetectPending() {
+      return rawData[1] & (1 << 0);
+    }
+
+    bool isPreambleDetectPending() {
+      return rawData[1] & (1 << 1);
+    }
+
+    uint8_t   rawData[4];
+  };
+
   struct ChipStatus {
         
     uint8_t   rawData[3];
   };  
+
+  // FIFO_INFO reply
+  struct FIFOInfo {
+    uint8_t getRXCount() {
+      return rawData[0];
+    }
+
+    uint8_t getTXSpace() {
+      return rawData[1];
+    }
+
+    uint8_t   rawData[2];
+  };
+
+  /**
+   * Receive buffer for receivePackets(). Bytes of a packet that was still
+   * coming in when the FIFO was drained are kept for the next call. The
+   * packet format (PKT_LEN, PKT_LEN_ADJUST, field 1 length) is read from
+   * the radio on first use; call reset() after changing it.
+   */
+  struct RXBuffer {
+    RXBuffer(uint8_t *data, uint8_t size) : data(data), size(size) {
+      reset();
+    }
+
+    void reset() {
+      start = end = 0;
+      formatKnown = false;
+    }
+
+    // What the last takePackets() returned is gone, keep the rest at the front
+    void compact() {
+      if (start == 0) return;
+      memmove(data, data + start, end - start);
+      end -= start;
+      start = 0;
+    }
+
+    uint8_t   *data;
+    uint8_t   size;
+    uint8_t   start;          // first byte not yet returned as a packet
+    uint8_t   end;            // end of the bytes read from the FIFO
+
+    bool      formatKnown;
+    uint8_t   lengthConfig;   // PKT_LEN
+    int8_t    lengthAdjust;   // PKT_LEN_ADJUST
+    uint16_t  fixedLength;    // field 1 length, for fixed length packets
+    uint16_t  packetLength;   // PACKET_INFO, variable length not in the FIFO
+
+    // receivePacketsAsync() in progress
+    Si446xT         *radio;
+    CommandCallback callback;
+    void            *context;
+    uint8_t         reply[7];
+  };
+
+  /**
+   * A packet returned by receivePackets(): its payload, without the length
+   * field, is data[offset] .. data[offset + length - 1] of the RXBuffer.
+   * Valid until the next call with the same buffer.
+   */
+  struct Packet {
+    uint8_t   offset;
+    uint8_t   length;
+  };
   
   //Si446x(SPI &spi, PinName pinCS, uint32_t xtalFrequency, bool isTCXO = false);
-  Si446x(int pinCS, uint32_t xtalFrequency);
+  Si446xT(int pinCS, uint32_t xtalFrequency, const Transport &transport = Transport());
+
+  void setCTSPin(int pinCTS);
 
   bool configure(uint8_t *params);
+  bool configure_P(const uint8_t *params);
+  bool applyDelta(const uint8_t *delta);
+
+  void beginProperties();
+  bool flushProperties();
+  bool commit();
+  bool setShadowTable(PropertyEntry *table, uint8_t size);
+  void invalidateProperties();
+  bool getShadowProperty(uint16_t id, uint8_t &value);
+  bool getProperties(uint16_t id, uint8_t *values, uint8_t count);
+  const PropertyCounters &getPropertyCounters() const { return _propertyCounters; }
+  void resetPropertyCounters();
 
   void getPartInfo(PartInfo &info);
   uint8_t getState();
@@ -207,13 +969,23 @@ public:
 
   void writeTX(const uint8_t *data, uint8_t length);
   void flushTX();
+  uint8_t getTXSpace();
+  void setTXThreshold(uint8_t threshold);
 
   uint8_t getAvailableRX();
+  uint16_t getPacketLength();
+  uint8_t receivePackets(RXBuffer &buffer, Packet *packets, uint8_t maxPackets);
+  uint8_t takePackets(RXBuffer &buffer, Packet *packets, uint8_t maxPackets);
   void readRX(uint8_t *data, uint8_t length);
+  void readRX(uint8_t *data, uint8_t length, uint8_t *wrapData, uint8_t wrapLength);
   void flushRX();
+  void getFIFOInfo(FIFOInfo &info);
+  void setRXThreshold(uint8_t threshold);
 
   void setIntControl(bool enableChipInt, bool enableModemInt, bool enablePHInt);
   void setPHInterrupts(uint8_t mask);
+  void setModemInterrupts(uint8_t mask);
+  void setChipInterrupts(uint8_t mask);
 
   //void check(uint8_t param1, uint8_t param2);
 
@@ -223,16 +995,133 @@ public:
   void getModemStatus(ModemStatus &status);  
   void getChipStatus(ChipStatus &status);
   
+  void setFRRModes(FRRMode a, FRRMode b = kFRRDisabled, FRRMode c = kFRRDisabled, FRRMode d = kFRRDisabled);
+  void readFRR(uint8_t *values, uint8_t count);
+  void configureFastStatus();
+  void getFastStatus(FastStatus &status);
+
   int16_t getTemperature(); 
 
   void changeState(State state);
+
+  /**
+   * Asynchronous variants: the command is queued and the call returns at
+   * once; poll() moves the queue along and the callback runs from there
+   * when the command has finished. Arguments up to 16 bytes are copied,
+   * everything else (longer TX data, reply and RX buffers) must stay valid
+   * until then. With the queue full, the call waits for the oldest command.
+   * Returns 0 and calls back at once if nothing had to be sent, e.g. when
+   * the properties already have those values or beginProperties() holds
+   * them back. Blocking calls wait for everything queued before them.
+   */
+  CommandHandle getIntStatusAsync(IRQStatus &status, CommandCallback callback = 0, void *context = 0);
+  CommandHandle getFastStatusAsync(FastStatus &status, CommandCallback callback = 0, void *context = 0);
+  CommandHandle readRXAsync(uint8_t *data, uint8_t length, CommandCallback callback = 0, void *context = 0);
+  CommandHandle writeTXAsync(const uint8_t *data, uint8_t length, CommandCallback callback = 0, void *context = 0);
+  CommandHandle setFrequencyAsync(uint32_t freq, CommandCallback callback = 0, void *context = 0);
+  CommandHandle startTXAsync(uint8_t channel, uint16_t pktLength, State txCompleteState, CommandCallback callback = 0, void *context = 0);
+  CommandHandle startRXAsync(uint8_t channel, uint16_t pktLength, State preambleTimeoutState, State validPacketState, State invalidPacketState, CommandCallback callback = 0, void *context = 0);
+  CommandHandle changeStateAsync(State state, CommandCallback callback = 0, void *context = 0);
+  CommandHandle getFIFOInfoAsync(FIFOInfo &info, CommandCallback callback = 0, void *context = 0);
+  CommandHandle flushRXAsync(CommandCallback callback = 0, void *context = 0);
+
+  /**
+   * receivePackets() in steps: the FIFO is drained into buffer by queued
+   * commands, each sent when the one before has its reply, and the callback
+   * runs when the bytes are in or a step has failed. takePackets() then
+   * splits them into packets. One call per buffer at a time.
+   */
+  void receivePacketsAsync(RXBuffer &buffer, CommandCallback callback, void *context = 0);
+
+  bool poll();
+  CommandStatus getCommandStatus(CommandHandle handle) const;
+  uint8_t getPendingCommands() const { return _commandCount; }
+  // A FIFO burst has been started and not called back: CS is still low
+  bool isTransferring() const { return _commandCount > 0 && _commands[_commandHead].state == kSlotTransfer; }
+  bool waitForCommand(CommandHandle handle);
+  void waitForIdle();
   
 private: 
-  bool waitForCTS(uint16_t timeout = 200);
-  bool waitForReply(uint8_t *reply, uint8_t replyLength, uint16_t timeout = 200);
+  static const uint32_t kCTSTimeout    = 200000UL;  // microseconds
+  static const uint16_t kCTSBackoffMin = 2;
+  static const uint16_t kCTSBackoffMax = 256;
+
+  bool waitForCTS(uint32_t timeout = kCTSTimeout);
+  bool waitForReply(uint8_t *reply, uint8_t replyLength, uint32_t timeout = kCTSTimeout);
+  bool pollReply(uint8_t *reply, uint8_t replyLength);
+  void pauseForCTS(uint16_t us);
   
+  enum {
+    kCommandArgs      = 16,     // arguments copied into a queue slot
+    kCommandNoCTS     = 0x01,   // FIFO and START commands go out without CTS
+    kCommandImmediate = 0x02,   // reply is clocked out in the command frame
+    kCommandFIFO      = 0x04,   // data burst goes through transferAsync()
+    kCommandProperty  = 0x08    // SET_PROPERTY from commit(), re-dirtied if it fails
+  };
+
+  enum CommandState {
+    kSlotFree,
+    kSlotQueued,
+    kSlotWaitCTS,
+    kSlotWaitReply,
+    kSlotTransfer,
+    kSlotDone,
+    kSlotFailed
+  };
+
+  struct Command {
+    const uint8_t   *data;
+    uint8_t         *reply;
+    CommandCallback callback;
+    void            *context;
+    uint32_t        started;    // micros() when the current wait began
+    uint32_t        nextPoll;   // no CTS poll before this, without a CTS pin
+    uint16_t        backoff;    // pause after the next poll that fails
+    CommandHandle   handle;
+    uint8_t         opcode;
+    uint8_t         length;
+    uint8_t         replyLength;
+    uint8_t         flags;
+    uint8_t         state;
+    uint8_t         args[kCommandArgs];
+  };
+
+  // One per waitForCommand() on the stack, innermost first. finishCommand()
+  // fills in the outcome before a callback can hand the slot to another command.
+  struct Waiter {
+    Waiter          *outer;
+    CommandHandle   handle;
+    uint8_t         status;
+  };
+
+  CommandHandle submitCommand(uint8_t cmd, const uint8_t *data, uint8_t dataLength, uint8_t *reply, uint8_t replyLength, uint8_t flags);
+  bool advanceCommand();
+  bool isCTSReady(Command &command, uint8_t *reply, uint8_t replyLength);
+  bool expireCommand(Command &command);
+  void finishCommand(bool success);
+  static void onTransferDone(void *context);
+  void markPropertiesDirty(const uint8_t *args);
+  void beginAsync();
+  CommandHandle endAsync(CommandCallback callback, void *context);
+
   bool sendCommand(uint8_t cmd, const uint8_t *data, uint8_t dataLength, uint8_t *reply = 0, uint8_t replyLength = 0, bool pollCTS = true);
   bool sendImmediate(uint8_t cmd, uint8_t *reply, uint8_t replyLength, bool pollCTS = true);
+  bool sendCommand_P(uint8_t cmd, const uint8_t *data, uint8_t dataLength);
+  bool configureStream(const uint8_t *params, bool progmem, bool allowPowerUp = true);
+  void readPacketFormat(RXBuffer &buffer);
+  void setPacketFormat(RXBuffer &buffer, const uint8_t *reply);
+  void requestRXCount(RXBuffer &buffer);
+  static void onRXFormat(CommandHandle handle, bool success, void *context);
+  static void onRXCount(CommandHandle handle, bool success, void *context);
+
+  static const uint8_t kMaxPropertyRun = 12;
+
+  bool setProperties(const uint8_t *args, uint8_t length);
+  bool stageProperty(uint16_t id, uint8_t value);
+  bool queueProperty(uint16_t id, uint8_t value);
+  bool insertProperty(uint16_t id, uint8_t value, bool replace);
+  bool findShadowProperty(uint16_t id, uint8_t &pos);
+  bool writeProperties(uint16_t id, const uint8_t *values, uint8_t count);
 
   void setParameter(uint16_t id, uint8_t value);
   void setParameter16(uint16_t id, uint16_t value);
@@ -242,6 +1131,41 @@ private:
   
   uint32_t    _xtalFrequency;
   uint8_t     _outDiv;
+  int         _pinCTS;
+  uint8_t     _lastCommand;
+
+  // Set in a shadow entry's ID while the value has not been written yet
+  static const uint16_t kShadowDirty = 0x8000;
+
+  bool peekProperty(uint8_t &pendingIdx, uint8_t shadowIdx, PropertyEntry &entry, bool &dirty);
+
+  PropertyEntry     _pendingProperties[SI446X_PROPERTY_QUEUE];
+  uint8_t           _pendingCount;
+  PropertyEntry     *_shadowProperties;
+  uint8_t           _shadowSize;
+  uint8_t           _shadowCount;
+  uint8_t           _deferDepth;
+  bool              _committing;
+  PropertyCounters  _propertyCounters;
+
+  Command           _commands[SI446X_COMMAND_QUEUE];
+  uint8_t           _commandHead;
+  uint8_t           _commandCount;
+  CommandHandle     _nextHandle;
+  CommandHandle     _asyncHandle;   // last command queued inside beginAsync()
+  bool              _async;
+  bool              _transferDone;  // set by the transport callback
+  Waiter            *_waiters;
+
+#if SI446X_STATS
+  typename Stats::Command *findStats(uint8_t opcode);
+  void recordCommand(uint8_t opcode, uint8_t bytesOut, uint8_t bytesIn);
+  void recordPoll(uint8_t bytesIn);
+  void recordCTSWait(uint32_t wait);
+  void recordTimeout();
+
+  Stats       _stats;
+#endif
 
   //bool        _ctsHigh;
 
@@ -253,3 +1177,8 @@ private:
   */
 };
 
+typedef Si446xT<> Si446x;
+
+extern template class Si446xT<>;
+
+#endif
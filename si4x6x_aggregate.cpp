@@ -0,0 +1,145 @@
+#include "si4x6x_aggregate.h"
+
+
+/**
+ * buffer must hold maxFrame bytes; maxFrame is capped at the TX queue's
+ * 64 byte packets.
+ */
+Si446xAggregator::Si446xAggregator(Si446xTXQueue &queue, uint8_t *buffer, uint8_t maxFrame, uint16_t maxDelay, bool lengthField)
+  : _queue(queue), _buffer(buffer), _maxFrame(maxFrame), _maxDelay(maxDelay), _start(lengthField ? 1 : 0)
+{
+  if (_maxFrame > Si446x::kFIFOSize) _maxFrame = Si446x::kFIFOSize;
+  _length = _start;
+  _count = 0;
+  resetCounters();
+}
+
+
+void Si446xAggregator::resetCounters()
+{
+  memset(&_counters, 0, sizeof(_counters));
+}
+
+
+/**
+ * Queues a message, sending the current frame first if the message does
+ * not fit in it. Returns false if the message is empty or larger than a
+ * frame, or if the TX queue had no room for the full frame.
+ */
+bool Si446xAggregator::add(const uint8_t *data, uint8_t length)
+{
+  if (length == 0 || _start + 1 + length > _maxFrame) {
+    _counters.rejected++;
+    return false;
+  }
+
+  if (_length + 1 + length > _maxFrame && !flush()) {
+    _counters.rejected++;
+    return false;
+  }
+
+  if (_count == 0) _firstTime = millis();
+  _buffer[_length++] = length;
+  memcpy(_buffer + _length, data, length);
+  _length += length;
+  _count++;
+  _counters.messages++;
+
+  // Full up: no further message would fit
+  if (_length + 2 > _maxFrame) flush();
+  service();
+  return true;
+}
+
+
+/**
+ * Sends the frame once its oldest message has waited maxDelay. Call from
+ * the main loop. Returns true if a frame went out.
+ */
+bool Si446xAggregator::service()
+{
+  if (_count == 0 || millis() - _firstTime < _maxDelay) return false;
+  return flush();
+}
+
+
+/**
+ * Hands the frame to the TX queue now. Returns false if it is empty or the
+ * queue is full, in which case the frame is kept.
+ */
+bool Si446xAggregator::flush()
+{
+  if (_count == 0) return false;
+
+  if (_start > 0) _buffer[0] = _length - 1;
+  if (!_queue.send(_buffer, _length)) return false;
+
+  uint32_t wait = millis() - _firstTime;
+  if (wait > _counters.waitMax) _counters.waitMax = wait;
+  _counters.frames++;
+  _counters.frameBytes += _length;
+  _counters.payloadBytes += _length - _start - _count;
+
+  _length = _start;
+  _count = 0;
+  return true;
+}
+
+
+/**
+ * Splits a received frame payload (without the radio's length field) into
+ * messages. Stops at a zero length byte, at a message running past the end
+ * and after maxMessages. Returns the number of descriptors filled in.
+ */
+uint8_t Si446xAggregator::unpack(const uint8_t *payload, uint8_t length, Message *messages, uint8_t maxMessages)
+{
+  uint8_t found = 0;
+  uint8_t pos = 0;
+  while (found < maxMessages && pos < length) {
+    uint8_t size = payload[pos];
+    if (size == 0 || size > length - pos - 1) break;
+    messages[found].offset = pos + 1;
+    messages[found].length = size;
+    found++;
+    pos += 1 + size;
+  }
+  return found;
+}
+
+
+/**
+ * Reads PREAMBLE_TX_LENGTH and PREAMBLE_CONFIG (length in bytes or
+ * nibbles), SYNC_CONFIG (1..4 bytes, none if SKIP_TX) and the PKT_CRC_CONFIG
+ * polynomial from the radio.
+ */
+void Si446xAggregator::readOverhead(Si446x &radio, Overhead &overhead)
+{
+  uint8_t preamble[5], sync[1], crc[1];
+  radio.getProperties(0x1000, preamble, sizeof(preamble));
+  radio.getProperties(0x1100, sync, sizeof(sync));
+  radio.getProperties(0x1200, crc, sizeof(crc));
+
+  overhead.preambleBits = preamble[0] * ((preamble[4] & 0x20) ? 8 : 4);
+  overhead.syncBits = (sync[0] & 0x80) ? 0 : ((sync[0] & 0x03) + 1) * 8;
+
+  switch (crc[0] & 0x0F) {
+    case 0:   overhead.crcBits = 0;   break;
+    case 1:   overhead.crcBits = 8;   break;
+    case 6:
+    case 7:
+    case 8:   overhead.crcBits = 32;  break;
+    default:  overhead.crcBits = 16;  break;
+  }
+}
+
+
+/**
+ * Message data bits over everything sent on air for the frames so far.
+ */
+float Si446xAggregator::getEfficiency(const Overhead &overhead) const
+{
+  uint32_t framing = overhead.preambleBits + overhead.syncBits + overhead.crcBits;
+  uint32_t airBits = _counters.frames * framing + _counters.frameBytes * 8;
+  if (airBits == 0) return 0;
+  return (float)(_counters.payloadBytes * 8) / airBits;
+}
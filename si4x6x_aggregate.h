@@ -0,0 +1,70 @@
+#ifndef SI4X6X_AGGREGATE_H_
+#define SI4X6X_AGGREGATE_H_
+
+#include "si4x6x.h"
+#include "si4x6x_stream.h"
+
+/**
+ * Packs small application messages into one radio frame, so they share a
+ * preamble, sync word and CRC. Each message goes in as a length byte and
+ * its data; a zero length byte ends the list early (padding). A frame is
+ * handed to the Si446xTXQueue when the next message does not fit or when
+ * its oldest message has waited maxDelay milliseconds, checked by add()
+ * and service().
+ *
+ * With lengthField set, the first frame byte carries the length of the
+ * rest, for radios set up with the packet length stored in the FIFO.
+ */
+class Si446xAggregator {
+public:
+  // Bits sent around every frame, from the radio configuration
+  struct Overhead {
+    uint16_t  preambleBits;
+    uint8_t   syncBits;
+    uint8_t   crcBits;
+  };
+
+  // A message returned by unpack(): payload[offset] .. payload[offset + length - 1]
+  struct Message {
+    uint8_t   offset;
+    uint8_t   length;
+  };
+
+  struct Counters {
+    uint32_t  messages;
+    uint32_t  frames;
+    uint32_t  payloadBytes;   // message data in the frames sent
+    uint32_t  frameBytes;     // including length bytes
+    uint32_t  rejected;       // add() calls that found no room
+    uint32_t  waitMax;        // longest a message waited for its frame, ms
+  };
+
+  Si446xAggregator(Si446xTXQueue &queue, uint8_t *buffer, uint8_t maxFrame, uint16_t maxDelay, bool lengthField = true);
+
+  bool add(const uint8_t *data, uint8_t length);
+  bool service();
+  bool flush();
+
+  uint8_t getPending() const { return _count; }
+
+  static uint8_t unpack(const uint8_t *payload, uint8_t length, Message *messages, uint8_t maxMessages);
+
+  static void readOverhead(Si446x &radio, Overhead &overhead);
+  float getEfficiency(const Overhead &overhead) const;
+
+  const Counters &getCounters() const { return _counters; }
+  void resetCounters();
+
+private:
+  Si446xTXQueue &_queue;
+  uint8_t   *_buffer;
+  uint8_t   _maxFrame;
+  uint16_t  _maxDelay;
+  uint8_t   _start;           // first message byte, after the length field
+  uint8_t   _length;          // bytes used in _buffer
+  uint8_t   _count;           // messages in the frame
+  uint32_t  _firstTime;       // millis() when the first message came in
+  Counters  _counters;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "si4x6x_fec.h"
+
+
+// GF(256), primitive polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D)
+static const uint8_t kExp[255] PROGMEM = {
+  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+  0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+  0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+  0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+  0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+  0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+  0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+  0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+  0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+  0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+  0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+  0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+  0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+  0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+  0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+  0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E
+};
+
+// kLog[0] is unused
+static const uint8_t kLog[256] PROGMEM = {
+  0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+  0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+  0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+  0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+  0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+  0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+  0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+  0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+  0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+  0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+  0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+  0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+  0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+  0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+  0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+  0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF
+};
+
+
+static inline uint8_t gfExp(uint16_t power)
+{
+  return pgm_read_byte(&kExp[power % 255]);
+}
+
+static inline uint8_t gfLog(uint8_t x)
+{
+  return pgm_read_byte(&kLog[x]);
+}
+
+static inline uint8_t gfMul(uint8_t a, uint8_t b)
+{
+  if (a == 0 || b == 0) return 0;
+  return gfExp(gfLog(a) + gfLog(b));
+}
+
+static inline uint8_t gfDiv(uint8_t a, uint8_t b)
+{
+  if (a == 0) return 0;
+  return gfExp(gfLog(a) + 255 - gfLog(b));
+}
+
+
+/**
+ * Builds the generator polynomial (x - a^0)(x - a^1)...(x - a^(parity-1)).
+ */
+Si446xFEC::Si446xFEC(uint8_t parity, uint8_t depth)
+{
+  if (parity > kMaxParity) parity = kMaxParity;
+  if (depth < 1) depth = 1;
+  if (depth > kMaxDepth) depth = kMaxDepth;
+  _parity = parity & ~1;
+  _depth = depth;
+
+  memset(_generator, 0, sizeof(_generator));
+  _generator[0] = 1;
+  for (uint8_t root = 0; root < _parity; root++) {
+    uint8_t alpha = gfExp(root);
+    for (uint8_t idx = root + 1; idx > 0; idx--) {
+      _generator[idx] = _generator[idx - 1] ^ gfMul(_generator[idx], alpha);
+    }
+    _generator[0] = gfMul(_generator[0], alpha);
+  }
+  resetCounters();
+}
+
+
+void Si446xFEC::resetCounters()
+{
+  memset(&_counters, 0, sizeof(_counters));
+}
+
+
+/**
+ * Systematic encoding: each codeword's parity is the remainder of its data
+ * times x^parity divided by the generator, computed with an LFSR whose
+ * first register holds the highest power.
+ */
+void Si446xFEC::encode(const uint8_t *data, uint8_t length, uint8_t *frame)
+{
+  uint8_t frameLength = getFrameLength(length);
+  if (frame != data) memcpy(frame, data, length);
+
+  for (uint8_t codeword = 0; codeword < _depth; codeword++) {
+    uint8_t remainder[kMaxParity];
+    memset(remainder, 0, _parity);
+
+    uint8_t dataLength = getCodewordLength(codeword, frameLength) - _parity;
+    for (uint8_t idx = 0; idx < dataLength; idx++) {
+      uint8_t feedback = data[idx * _depth + codeword] ^ remainder[0];
+      for (uint8_t pos = 0; pos + 1 < _parity; pos++) {
+        remainder[pos] = remainder[pos + 1] ^ gfMul(feedback, _generator[_parity - 1 - pos]);
+      }
+      remainder[_parity - 1] = gfMul(feedback, _generator[0]);
+    }
+
+    for (uint8_t pos = 0; pos < _parity; pos++) {
+      frame[(dataLength + pos) * _depth + codeword] = remainder[pos];
+    }
+  }
+}
+
+
+int16_t Si446xFEC::decode(uint8_t *frame, uint8_t frameLength, uint8_t *data)
+{
+  int16_t length = getPayloadLength(frameLength);
+  if (length < 0) return -1;
+
+  _counters.frames++;
+  bool ok = true;
+  for (uint8_t codeword = 0; codeword < _depth; codeword++) {
+    if (!decodeCodeword(frame + codeword, getCodewordLength(codeword, frameLength))) ok = false;
+  }
+  if (!ok) {
+    _counters.failures++;
+    return -1;
+  }
+
+  if (data != frame) memcpy(data, frame, length);
+  return length;
+}
+
+
+/**
+ * Decodes one codeword whose symbols are depth bytes apart: syndromes,
+ * Berlekamp-Massey for the error locator, Chien search for the positions
+ * and Forney for the values. Symbol j stands for x^(length - 1 - j).
+ */
+bool Si446xFEC::decodeCodeword(uint8_t *symbols, uint8_t length)
+{
+  uint8_t syndromes[kMaxParity];
+  bool clean = true;
+  for (uint8_t root = 0; root < _parity; root++) {
+    uint8_t alpha = gfExp(root);
+    uint8_t value = 0;
+    for (uint8_t idx = 0; idx < length; idx++) {
+      value = gfMul(value, alpha) ^ symbols[idx * _depth];
+    }
+    syndromes[root] = value;
+    if (value != 0) clean = false;
+  }
+  if (clean) return true;
+
+  // Berlekamp-Massey
+  uint8_t locator[kMaxParity + 1], previous[kMaxParity + 1], saved[kMaxParity + 1];
+  memset(locator, 0, sizeof(locator));
+  memset(previous, 0, sizeof(previous));
+  locator[0] = previous[0] = 1;
+  uint8_t errors = 0;
+  uint8_t shift = 1;
+  uint8_t lastDiscrepancy = 1;
+
+  for (uint8_t step = 0; step < _parity; step++) {
+    uint8_t discrepancy = syndromes[step];
+    for (uint8_t idx = 1; idx <= errors; idx++) {
+      discrepancy ^= gfMul(locator[idx], syndromes[step - idx]);
+    }
+    if (discrepancy == 0) {
+      shift++;
+      continue;
+    }
+
+    uint8_t scale = gfDiv(discrepancy, lastDiscrepancy);
+    memcpy(saved, locator, sizeof(locator));
+    for (uint8_t idx = 0; idx + shift <= _parity; idx++) {
+      locator[idx + shift] ^= gfMul(scale, previous[idx]);
+    }
+    if (2 * errors <= step) {
+      errors = step + 1 - errors;
+      memcpy(previous, saved, sizeof(saved));
+      lastDiscrepancy = discrepancy;
+      shift = 1;
+    }
+    else shift++;
+  }
+  if (errors > _parity / 2) return false;
+
+  // Error evaluator: syndromes times locator, mod x^parity
+  uint8_t evaluator[kMaxParity];
+  for (uint8_t idx = 0; idx < _parity; idx++) {
+    uint8_t value = 0;
+    for (uint8_t term = 0; term <= idx && term <= errors; term++) {
+      value ^= gfMul(locator[term], syndromes[idx - term]);
+    }
+    evaluator[idx] = value;
+  }
+
+  // Chien search over the positions that exist, then Forney
+  uint8_t found = 0;
+  for (uint8_t idx = 0; idx < length; idx++) {
+    uint8_t power = length - 1 - idx;
+    uint16_t inverse = 255 - power;     // log of 1/X
+
+    uint8_t value = 0;
+    for (uint8_t term = 0; term <= errors; term++) {
+      value ^= gfMul(locator[term], gfExp(inverse * term));
+    }
+    if (value != 0) continue;
+
+    uint8_t numerator = 0;
+    for (uint8_t term = 0; term < _parity; term++) {
+      numerator ^= gfMul(evaluator[term], gfExp(inverse * term));
+    }
+    uint8_t denominator = 0;
+    for (uint8_t term = 1; term <= errors; term += 2) {
+      denominator ^= gfMul(locator[term], gfExp(inverse * (term - 1)));
+    }
+    if (denominator == 0) return false;
+
+    symbols[idx * _depth] ^= gfMul(gfExp(power), gfDiv(numerator, denominator));
+    found++;
+  }
+  if (found != errors) return false;
+
+  _counters.corrected += found;
+  return true;
+}
+
+
+bool Si446xFEC::send(Si446x &radio, const uint8_t *data, uint8_t length, uint8_t channel)
+{
+  uint8_t frame[Si446x::kFIFOSize];
+  uint16_t frameLength = getFrameLength(length);
+  if (frameLength > sizeof(frame)) return false;
+
+  encode(data, length, frame);
+  radio.writeTX(frame, frameLength);
+  radio.startTX(channel, frameLength);
+  return true;
+}
+
+
+int16_t Si446xFEC::receive(Si446x &radio, uint8_t frameLength, uint8_t *data)
+{
+  uint8_t frame[Si446x::kFIFOSize];
+  if (frameLength > sizeof(frame)) return -1;
+
+  radio.readRX(frame, frameLength);
+  return decode(frame, frameLength, data);
+}
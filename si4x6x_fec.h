@@ -0,0 +1,76 @@
+#ifndef SI4X6X_FEC_H_
+#define SI4X6X_FEC_H_
+
+#include "si4x6x.h"
+
+/**
+ * Reed-Solomon forward error correction over GF(256) with block
+ * interleaving, for links where a retransmission costs more than the
+ * parity. A payload of L bytes is spread over depth codewords, byte p
+ * going to codeword p % depth, and each codeword gets parity bytes that
+ * correct up to parity / 2 byte errors in it. The frame is the payload as
+ * is, followed by the parity bytes interleaved the same way, so a burst of
+ * errors on the air is shared out among the codewords.
+ *
+ * Frames that fail the radio's CRC should still be decoded: correcting
+ * them is the point.
+ */
+class Si446xFEC {
+public:
+  enum {
+    kMaxParity  = 16,     // per codeword, must be even
+    kMaxDepth   = 8
+  };
+
+  struct Counters {
+    uint32_t  frames;
+    uint32_t  corrected;  // bytes repaired
+    uint32_t  failures;   // frames with a codeword beyond repair
+  };
+
+  Si446xFEC(uint8_t parity = 8, uint8_t depth = 2);
+
+  uint8_t getParity() const { return _parity; }
+  uint8_t getDepth() const { return _depth; }
+
+  uint16_t getFrameLength(uint8_t length) const {
+    return length + _depth * _parity;
+  }
+
+  // Payload length of a frame, negative if the frame is too short
+  int16_t getPayloadLength(uint16_t frameLength) const {
+    return (int16_t)frameLength - _depth * _parity;
+  }
+
+  // Frame length must stay within 255 bytes
+  void encode(const uint8_t *data, uint8_t length, uint8_t *frame);
+
+  /**
+   * Corrects the frame in place and copies the payload to data (may be the
+   * frame itself). Returns the payload length, or -1 if it could not be
+   * corrected.
+   */
+  int16_t decode(uint8_t *frame, uint8_t frameLength, uint8_t *data);
+
+  // writeTX()/startTX() of an encoded frame, which must fit the TX FIFO
+  bool send(Si446x &radio, const uint8_t *data, uint8_t length, uint8_t channel = 0);
+  // readRX() of a whole frame, then decode()
+  int16_t receive(Si446x &radio, uint8_t frameLength, uint8_t *data);
+
+  const Counters &getCounters() const { return _counters; }
+  void resetCounters();
+
+private:
+  uint8_t getCodewordLength(uint8_t codeword, uint8_t frameLength) const {
+    return (frameLength - codeword + _depth - 1) / _depth;
+  }
+
+  bool decodeCodeword(uint8_t *symbols, uint8_t length);
+
+  uint8_t   _parity;
+  uint8_t   _depth;
+  uint8_t   _generator[kMaxParity + 1];   // coefficient of x^i at [i]
+  Counters  _counters;
+};
+
+#endif
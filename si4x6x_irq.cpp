@@ -0,0 +1,174 @@
+#include "si4x6x_irq.h"
+
+
+Si446xIRQ *Si446xIRQ::_instances[Si446xIRQ::kMaxInstances];
+
+
+Si446xIRQ::Si446xIRQ(Si446x &radio, int pinIRQ)
+  : _radio(radio), _pinIRQ(pinIRQ), _pending(false), _irqTime(0), _eventTime(0),
+    _statusHandle(0), _statusDone(false), _statusOK(false), _statusIRQTime(0)
+{
+  _ph.handler = _modem.handler = _chip.handler = 0;
+  _ph.context = _modem.context = _chip.context = 0;
+  resetLatency();
+}
+
+/**
+ * Attaches the falling edge ISR to the nIRQ pin. Fails when the pin has no
+ * external interrupt or all instance slots are taken.
+ */
+bool Si446xIRQ::begin()
+{
+  static void (* const trampolines[kMaxInstances])() = {
+    &Si446xIRQ::isr<0>, &Si446xIRQ::isr<1>, &Si446xIRQ::isr<2>, &Si446xIRQ::isr<3>
+  };
+
+  int irq = digitalPinToInterrupt(_pinIRQ);
+  if (irq < 0) return false;
+
+  for (uint8_t idx = 0; idx < kMaxInstances; idx++) {
+    if (_instances[idx] == 0 || _instances[idx] == this) {
+      _instances[idx] = this;
+      pinMode(_pinIRQ, INPUT_PULLUP);
+      attachInterrupt(irq, trampolines[idx], FALLING);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Programs the radio interrupt enables. A zero mask leaves that group
+ * disabled in INT_CTL_ENABLE.
+ */
+void Si446xIRQ::enable(uint8_t phMask, uint8_t modemMask, uint8_t chipMask)
+{
+  Si446x::Transaction bus(_radio);
+
+  _radio.setPHInterrupts(phMask);
+  _radio.setModemInterrupts(modemMask);
+  _radio.setChipInterrupts(chipMask);
+  _radio.setIntControl(chipMask != 0, modemMask != 0, phMask != 0);
+  _radio.getIntStatus();
+}
+
+void Si446xIRQ::onPacketHandler(EventHandler handler, void *context)
+{
+  _ph.handler = handler;
+  _ph.context = context;
+}
+
+void Si446xIRQ::onModem(EventHandler handler, void *context)
+{
+  _modem.handler = handler;
+  _modem.context = context;
+}
+
+void Si446xIRQ::onChip(EventHandler handler, void *context)
+{
+  _chip.handler = handler;
+  _chip.context = context;
+}
+
+void Si446xIRQ::resetLatency()
+{
+  _latency.last = _latency.max = _latency.count = 0;
+}
+
+void Si446xIRQ::onInterrupt()
+{
+  if (!_pending) {
+    _irqTime = micros();
+    _pending = true;
+  }
+}
+
+/**
+ * Services pending radio events. nIRQ stays low while any enabled event is
+ * pending, so a level still low after the edge flag was consumed (an edge
+ * that arrived during the previous pass) is serviced as well. Commands
+ * queued with the ...Async() calls are moved along on every call, and
+ * those the handlers queued are waited for, so handlers written for
+ * Si446xManager behave here as they would blocking.
+ * Returns true if the radio was asked for its status.
+ */
+bool Si446xIRQ::service()
+{
+  _radio.poll();
+
+  uint32_t irqTime;
+  if (!takeEvent(irqTime)) return false;
+
+  Si446x::IRQStatus status;
+  _radio.getIntStatus(status);
+  dispatchAll(status, irqTime);
+  _radio.waitForIdle();
+  return true;
+}
+
+bool Si446xIRQ::requestStatus()
+{
+  if (_statusHandle != 0) return false;
+  if (!takeEvent(_statusIRQTime)) return false;
+
+  _statusDone = false;
+  _statusHandle = _radio.getIntStatusAsync(_status, onStatus, this);
+  return true;
+}
+
+/**
+ * A status read that failed (CTS timeout) is dropped; nIRQ is still low,
+ * so the next requestStatus() asks again.
+ */
+bool Si446xIRQ::dispatchStatus()
+{
+  if (_statusHandle == 0 || !_statusDone) return false;
+  _statusHandle = 0;
+  if (!_statusOK) return false;
+
+  dispatchAll(_status, _statusIRQTime);
+  return true;
+}
+
+// Called from the radio's poll(): only flags the completion
+void Si446xIRQ::onStatus(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Si446xIRQ *irq = (Si446xIRQ *)context;
+  irq->_statusOK = success;
+  irq->_statusDone = true;
+}
+
+// The edge flagged by the ISR, or nIRQ still low, and when it was seen
+bool Si446xIRQ::takeEvent(uint32_t &irqTime)
+{
+  noInterrupts();
+  bool pending = _pending;
+  irqTime = _irqTime;
+  _pending = false;
+  interrupts();
+
+  if (!pending) {
+    if (digitalRead(_pinIRQ) != LOW) return false;
+    irqTime = micros();
+  }
+  return true;
+}
+
+void Si446xIRQ::dispatchAll(Si446x::IRQStatus &status, uint32_t irqTime)
+{
+  _latency.last = micros() - irqTime;
+  if (_latency.last > _latency.max) _latency.max = _latency.last;
+  _latency.count++;
+  _eventTime = irqTime;
+
+  if (status.getPHPending()) dispatch(_ph, status);
+  if (status.getModemPending()) dispatch(_modem, status);
+  if (status.getChipPending()) dispatch(_chip, status);
+}
+
+void Si446xIRQ::dispatch(Slot &slot, Si446x::IRQStatus &status)
+{
+  if (slot.handler) {
+    slot.handler(status, slot.context);
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef SI4X6X_IRQ_H_
+#define SI4X6X_IRQ_H_
+
+#include "si4x6x.h"
+
+/**
+ * nIRQ driven event engine. The pin ISR only timestamps and flags the event;
+ * service() is called from the main loop, reads and clears the radio's
+ * interrupt status and dispatches PH, modem and chip events to handlers.
+ */
+class Si446xIRQ {
+public:
+  typedef void (*EventHandler)(Si446x::IRQStatus &status, void *context);
+
+  struct Latency {
+    uint32_t  last;     // IRQ edge to dispatch, microseconds
+    uint32_t  max;
+    uint32_t  count;
+  };
+
+  Si446xIRQ(Si446x &radio, int pinIRQ);
+
+  bool begin();
+  void enable(uint8_t phMask, uint8_t modemMask = 0, uint8_t chipMask = 0);
+
+  void onPacketHandler(EventHandler handler, void *context = 0);
+  void onModem(EventHandler handler, void *context = 0);
+  void onChip(EventHandler handler, void *context = 0);
+
+  bool service();
+
+  /**
+   * service() in two halves that never wait for CTS: requestStatus() queues
+   * GET_INT_STATUS for a pending event, the radio's poll() brings it in and
+   * dispatchStatus() then runs the handlers. Each returns false when there
+   * is nothing for it to do yet.
+   */
+  bool requestStatus();
+  bool dispatchStatus();
+
+  // Status dispatchStatus() last dispatched
+  Si446x::IRQStatus getStatus() const { return _status; }
+
+  Si446x &getRadio() const { return _radio; }
+
+  // micros() at the nIRQ edge of the event being dispatched
+  uint32_t getEventTime() const { return _eventTime; }
+
+  const Latency &getLatency() const { return _latency; }
+  void resetLatency();
+
+private:
+  enum { kMaxInstances = 4 };
+
+  struct Slot {
+    EventHandler  handler;
+    void          *context;
+  };
+
+  void onInterrupt();
+  bool takeEvent(uint32_t &irqTime);
+  void dispatchAll(Si446x::IRQStatus &status, uint32_t irqTime);
+  void dispatch(Slot &slot, Si446x::IRQStatus &status);
+
+  static void onStatus(Si446x::CommandHandle handle, bool success, void *context);
+
+  template<uint8_t N> static void isr() {
+    _instances[N]->onInterrupt();
+  }
+
+  static Si446xIRQ  *_instances[kMaxInstances];
+
+  Si446x    &_radio;
+  int       _pinIRQ;
+
+  volatile bool     _pending;
+  volatile uint32_t _irqTime;
+  uint32_t          _eventTime;
+
+  Slot      _ph, _modem, _chip;
+  Latency   _latency;
+
+  Si446x::IRQStatus     _status;
+  Si446x::CommandHandle _statusHandle;    // requestStatus() in flight
+  volatile bool         _statusDone;
+  bool                  _statusOK;
+  uint32_t              _statusIRQTime;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "si4x6x_manager.h"
+
+
+Si446xManager::Si446xManager(uint32_t spiClock)
+  : _count(0), _spiClock(spiClock), _startTime(0)
+{
+}
+
+/**
+ * Radios of equal priority are served in the order they were added.
+ */
+int8_t Si446xManager::add(Si446xIRQ &irq, uint8_t priority)
+{
+  if (_count == kMaxRadios) return -1;
+
+  uint8_t index = _count++;
+  Radio &radio = _radios[index];
+  radio.irq = &irq;
+  radio.priority = priority;
+
+  uint8_t pos = index;
+  while (pos > 0 && _radios[_order[pos - 1]].priority > priority) {
+    _order[pos] = _order[pos - 1];
+    pos--;
+  }
+  _order[pos] = index;
+
+  resetCounters();
+  return index;
+}
+
+// Attaches every radio's nIRQ; false if any has no interrupt
+bool Si446xManager::begin()
+{
+  bool ok = true;
+  for (uint8_t idx = 0; idx < _count; idx++) {
+    if (!_radios[idx].irq->begin()) ok = false;
+  }
+  return ok;
+}
+
+/**
+ * One pass over all radios: status reads are queued for new events, every
+ * command queue takes one step, and statuses that have come in are
+ * dispatched, each in priority order. A FIFO burst still on the bus cuts
+ * the pass short; the rest waits for the next one. Returns true if
+ * anything was dispatched.
+ */
+bool Si446xManager::service()
+{
+  if (isBusHeld()) return false;
+
+  for (uint8_t idx = 0; idx < _count; idx++) {
+    _radios[_order[idx]].irq->requestStatus();
+  }
+
+  for (uint8_t idx = 0; idx < _count; idx++) {
+    if (isBusHeld()) return false;
+    getRadio(_order[idx]).poll();
+  }
+
+  bool dispatched = false;
+  for (uint8_t idx = 0; idx < _count; idx++) {
+    Radio &radio = _radios[_order[idx]];
+    if (isBusHeld()) break;
+    if (radio.irq->dispatchStatus()) {
+      count(radio);
+      dispatched = true;
+    }
+  }
+  return dispatched;
+}
+
+// Polls the radio with a FIFO burst on the bus, if any; true while it still has one
+bool Si446xManager::isBusHeld()
+{
+  for (uint8_t idx = 0; idx < _count; idx++) {
+    Si446x &radio = getRadio(idx);
+    if (!radio.isTransferring()) continue;
+    radio.poll();
+    return radio.isTransferring();
+  }
+  return false;
+}
+
+void Si446xManager::count(Radio &radio)
+{
+  Si446x::IRQStatus status = radio.irq->getStatus();
+  radio.counters.events++;
+  if (status.isPacketRXPending()) radio.counters.packetsRX++;
+  if (status.isPacketSentPending()) radio.counters.packetsSent++;
+  if (status.isCRCErrorPending()) radio.counters.crcErrors++;
+}
+
+void Si446xManager::resetCounters()
+{
+  for (uint8_t idx = 0; idx < _count; idx++) {
+    Radio &radio = _radios[idx];
+    memset(&radio.counters, 0, sizeof(radio.counters));
+    radio.startBytes = radio.irq->getRadio().getBusCounters().bytes;
+  }
+  _startTime = micros();
+}
+
+uint32_t Si446xManager::getPacketsPerSecond(uint8_t index) const
+{
+  uint32_t elapsed = micros() - _startTime;
+  if (elapsed == 0) return 0;
+  const Counters &counters = _radios[index].counters;
+  return (uint32_t)((uint64_t)(counters.packetsRX + counters.packetsSent) * 1000000UL / elapsed);
+}
+
+uint32_t Si446xManager::getBusBytes(uint8_t index) const
+{
+  return getRadio(index).getBusCounters().bytes - _radios[index].startBytes;
+}
+
+uint16_t Si446xManager::getBusUtilisation(uint8_t index) const
+{
+  uint32_t elapsed = micros() - _startTime;
+  if (elapsed == 0) return 0;
+  uint64_t busTime = (uint64_t)getBusBytes(index) * 8000000UL / _spiClock;
+  return (uint16_t)(busTime * 1000 / elapsed);
+}
@@ -0,0 +1,71 @@
+#ifndef SI4X6X_MANAGER_H_
+#define SI4X6X_MANAGER_H_
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+
+/**
+ * Several radios on one SPI bus, each with its own chip select and nIRQ
+ * (its Si446xIRQ). service() takes them in priority order and never waits
+ * for CTS: status reads go through each radio's command queue, and every
+ * queue moves one step per pass, so a radio slow to raise CTS only delays
+ * itself. Handlers run from service(), outside the queues; commands they
+ * send that wait for CTS should use the ...Async() calls to keep it so
+ * (receivePacketsAsync() in place of receivePackets()), as the handlers
+ * of the stream classes do.
+ *
+ * A transport may complete FIFO bursts later (DMA), with the radio's CS
+ * held low until then. While one is on the bus, service() only polls that
+ * radio: no other radio is polled and no handler runs until it is done.
+ */
+class Si446xManager {
+public:
+  enum { kMaxRadios = 4 };
+
+  struct Counters {
+    uint32_t  events;       // statuses dispatched
+    uint32_t  packetsRX;    // PACKET_RX events
+    uint32_t  packetsSent;  // PACKET_SENT events
+    uint32_t  crcErrors;
+  };
+
+  Si446xManager(uint32_t spiClock = 1000000UL);
+
+  // Lower priority values are served first. Returns the radio's index, -1 if full
+  int8_t add(Si446xIRQ &irq, uint8_t priority = 0);
+  bool begin();
+
+  uint8_t getCount() const { return _count; }
+  Si446xIRQ &getIRQ(uint8_t index) const { return *_radios[index].irq; }
+  Si446x &getRadio(uint8_t index) const { return _radios[index].irq->getRadio(); }
+
+  bool service();
+
+  const Counters &getCounters(uint8_t index) const { return _radios[index].counters; }
+  void resetCounters();
+
+  // Since resetCounters(): packets received and sent per second, SPI bytes
+  // for the radio and the share of the time the bus spent on them (per mille)
+  uint32_t getPacketsPerSecond(uint8_t index) const;
+  uint32_t getBusBytes(uint8_t index) const;
+  uint16_t getBusUtilisation(uint8_t index) const;
+
+private:
+  struct Radio {
+    Si446xIRQ   *irq;
+    uint8_t     priority;
+    uint32_t    startBytes;
+    Counters    counters;
+  };
+
+  void count(Radio &radio);
+  bool isBusHeld();
+
+  Radio     _radios[kMaxRadios];
+  uint8_t   _order[kMaxRadios];   // indices by priority
+  uint8_t   _count;
+  uint32_t  _spiClock;
+  uint32_t  _startTime;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef SI4X6X_QUEUE_H_
+#define SI4X6X_QUEUE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Payload bytes kept per queued packet, longer packets are truncated
+#ifndef SI446X_RECORD_PAYLOAD
+#define SI446X_RECORD_PAYLOAD 16
+#endif
+
+/**
+ * A received packet as handed from the radio service path to the
+ * application.
+ */
+struct Si446xPacketRecord {
+  uint32_t  timestamp;    // micros() at the nIRQ edge that reported it
+  uint8_t   length;       // payload length as received
+  uint8_t   rssi;         // latched RSSI
+  bool      crcOK;
+  uint8_t   data[SI446X_RECORD_PAYLOAD];
+
+  uint8_t getStoredLength() const {
+    return (length < SI446X_RECORD_PAYLOAD) ? length : SI446X_RECORD_PAYLOAD;
+  }
+};
+
+/**
+ * Fixed capacity single producer, single consumer queue. The producer only
+ * writes _head and the consumer only writes _tail; both are single bytes
+ * accessed with acquire/release ordering, so neither side has to disable
+ * interrupts or take a lock, on AVR (ISR vs loop) as well as on a host with
+ * two threads. Capacity must be a power of two, at most 128.
+ *
+ * Slots are filled and read in place: reserve()/commit() on the producer
+ * side, front()/release() on the consumer side; push()/pop() copy.
+ */
+template<typename T, uint8_t N>
+class Si446xQueue {
+public:
+  Si446xQueue() : _head(0), _tail(0), _drops(0) {}
+
+  // Producer side
+
+  T *reserve() {
+    uint8_t head = _head;
+    if ((uint8_t)(head - load(_tail)) >= N) {
+      _drops++;
+      return 0;
+    }
+    return &_slots[head & (N - 1)];
+  }
+
+  void commit() {
+    store(_head, (uint8_t)(_head + 1));
+  }
+
+  bool push(const T &item) {
+    T *slot = reserve();
+    if (!slot) return false;
+    *slot = item;
+    commit();
+    return true;
+  }
+
+  // Items lost because the queue was full
+  uint16_t getDrops() const { return _drops; }
+
+  // Consumer side
+
+  T *front() {
+    uint8_t tail = _tail;
+    if (load(_head) == tail) return 0;
+    return &_slots[tail & (N - 1)];
+  }
+
+  void release() {
+    store(_tail, (uint8_t)(_tail + 1));
+  }
+
+  bool pop(T &item) {
+    T *slot = front();
+    if (!slot) return false;
+    item = *slot;
+    release();
+    return true;
+  }
+
+  // Either side
+
+  uint8_t size() const {
+    return (uint8_t)(load(_head) - load(_tail));
+  }
+
+  bool isEmpty() const { return size() == 0; }
+
+private:
+  static uint8_t load(const uint8_t &index) {
+    return __atomic_load_n(&index, __ATOMIC_ACQUIRE);
+  }
+
+  static void store(uint8_t &index, uint8_t value) {
+    __atomic_store_n(&index, value, __ATOMIC_RELEASE);
+  }
+
+  T         _slots[N];
+  uint8_t   _head;
+  uint8_t   _tail;
+  uint16_t  _drops;
+
+  static_assert(N > 0 && N <= 128 && (N & (N - 1)) == 0, "capacity must be a power of two up to 128");
+};
+
+#endif
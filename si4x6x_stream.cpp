@@ -0,0 +1,459 @@
+#include "si4x6x_stream.h"
+
+
+uint16_t Si446xRing::read(uint8_t *data, uint16_t length)
+{
+  uint16_t done = 0;
+  while (done < length) {
+    uint16_t run;
+    const uint8_t *src = readRun(run);
+    if (run == 0) break;
+    if (run > length - done) run = length - done;
+    memcpy(data + done, src, run);
+    consume(run);
+    done += run;
+  }
+  return done;
+}
+
+
+uint16_t Si446xRing::write(const uint8_t *data, uint16_t length)
+{
+  uint16_t done = 0;
+  while (done < length) {
+    uint16_t run;
+    uint8_t *dest = writeRun(run);
+    if (run == 0) break;
+    if (run > length - done) run = length - done;
+    memcpy(dest, data + done, run);
+    commit(run);
+    done += run;
+  }
+  return done;
+}
+
+
+Si446xTXStream::Si446xTXStream(Si446x &radio, uint8_t threshold)
+  : _radio(radio), _threshold(threshold), _data(0), _length(0), _queued(0), _busy(false), _underrun(false),
+    _refilling(false)
+{
+  resetCounters();
+}
+
+void Si446xTXStream::resetCounters()
+{
+  memset(&_counters, 0, sizeof(_counters));
+}
+
+/**
+ * Preloads the FIFO and starts transmitting length bytes from data.
+ * Fails while a packet is still going out or if length does not fit the
+ * packet handler's length field.
+ */
+bool Si446xTXStream::begin(const uint8_t *data, uint16_t length, uint8_t channel)
+{
+  if (isBusy() || length == 0 || length > Si446x::kMaxPacketLength) return false;
+
+  Si446x::Transaction bus(_radio);
+
+  _data = data;
+  _length = length;
+  _queued = (length < Si446x::kFIFOSize) ? length : Si446x::kFIFOSize;
+  _underrun = false;
+  _busy = true;
+
+  _radio.flushTX();
+  _radio.setTXThreshold(_threshold);
+  _radio.writeTX(_data, _queued);
+  _radio.startTX(channel, _length);
+  return true;
+}
+
+void Si446xTXStream::handleEvents(Si446x::IRQStatus &status)
+{
+  if (!_busy) return;
+
+  if (status.isTXFIFOAlmostEmptyPending() && _queued < _length) {
+    refill();
+  }
+
+  // The chip handler runs after this one, so look at its FIFO error here
+  if (status.isPacketSentPending()) {
+    if (status.getChipPending() & Si446x::kIntFIFOError) _underrun = true;
+    if (_underrun) _counters.underruns++;
+    _counters.packets++;
+    _busy = false;
+  }
+}
+
+void Si446xTXStream::handleChipEvents(Si446x::IRQStatus &status)
+{
+  if (status.getChipPending() & Si446x::kIntFIFOError) {
+    _counters.fifoErrors++;
+    if (_busy) _underrun = true;
+  }
+}
+
+void Si446xTXStream::onEvent(Si446x::IRQStatus &status, void *context)
+{
+  ((Si446xTXStream *)context)->handleEvents(status);
+}
+
+void Si446xTXStream::onChipEvent(Si446x::IRQStatus &status, void *context)
+{
+  ((Si446xTXStream *)context)->handleChipEvents(status);
+}
+
+// Asks for the FIFO space; onFIFOInfo() writes what fits
+void Si446xTXStream::refill()
+{
+  if (_refilling) return;
+  _refilling = true;
+  _radio.getFIFOInfoAsync(_fifoInfo, onFIFOInfo, this);
+}
+
+void Si446xTXStream::onFIFOInfo(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Si446xTXStream &stream = *(Si446xTXStream *)context;
+  stream._refilling = false;
+  if (!success || !stream._busy) return;
+
+  uint8_t space = stream._fifoInfo.getTXSpace();
+  uint16_t left = stream._length - stream._queued;
+  uint8_t chunk = (left < space) ? left : space;
+  if (chunk == 0) return;
+
+  stream._radio.writeTXAsync(stream._data + stream._queued, chunk);
+  stream._queued += chunk;
+  stream._counters.refills++;
+}
+
+
+Si446xRXStream::Si446xRXStream(Si446x &radio, Si446xRing &ring, uint8_t threshold)
+  : _radio(radio), _ring(ring), _threshold(threshold), _active(false),
+    _draining(false), _drainAgain(false), _readFailed(false), _reading(0), _dropping(0), _readsLeft(0)
+{
+  resetCounters();
+}
+
+void Si446xRXStream::resetCounters()
+{
+  memset(&_counters, 0, sizeof(_counters));
+}
+
+/**
+ * Starts receiving. The radio goes back to RX after every frame, valid or
+ * not, so the stream runs until end(). A non-zero length overrides the
+ * packet handler's length configuration.
+ */
+void Si446xRXStream::begin(uint8_t channel, uint16_t length)
+{
+  Si446x::Transaction bus(_radio);
+
+  _radio.flushRX();
+  _radio.setRXThreshold(_threshold);
+  _radio.startRX(channel, length, Si446x::kStateNoChange, Si446x::kStateRX, Si446x::kStateRX);
+  _active = true;
+}
+
+void Si446xRXStream::end()
+{
+  _radio.changeState(Si446x::kStateReady);
+  _active = false;
+}
+
+/**
+ * Moves whatever the RX FIFO holds into the ring, waiting for CTS. Not for
+ * use while the stream's events are being serviced.
+ */
+void Si446xRXStream::drain()
+{
+  Si446x::Transaction bus(_radio);
+
+  uint8_t count = _radio.getAvailableRX();
+  if (count == 0) return;
+
+  uint16_t space = _ring.space();
+  uint8_t keep = (count < space) ? count : space;
+
+  uint16_t run;
+  uint8_t *dest = _ring.writeRun(run);
+  uint8_t first = (keep < run) ? keep : run;
+
+  _radio.readRX(dest, first, _ring.getStorage(), keep - first);
+  _ring.commit(keep);
+
+  if (keep < count) {
+    _radio.readRX(0, count - keep);
+    _counters.overflows += count - keep;
+  }
+  _counters.bytes += keep;
+  _counters.drains++;
+}
+
+// One drain at a time; an event during one asks for another once it is done
+void Si446xRXStream::requestDrain()
+{
+  if (_draining) {
+    _drainAgain = true;
+    return;
+  }
+  _draining = true;
+  _radio.getFIFOInfoAsync(_fifoInfo, onFIFOInfo, this);
+}
+
+// Reads into the ring's free space, both halves if it wraps, and drops the rest
+void Si446xRXStream::onFIFOInfo(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Si446xRXStream &stream = *(Si446xRXStream *)context;
+  uint8_t count = success ? stream._fifoInfo.getRXCount() : 0;
+  if (count == 0) {
+    onRead(handle, success, context);
+    return;
+  }
+
+  uint16_t space = stream._ring.space();
+  uint8_t keep = (count < space) ? count : space;
+
+  uint16_t run;
+  uint8_t *dest = stream._ring.writeRun(run);
+  uint8_t first = (keep < run) ? keep : run;
+
+  stream._reading = keep;
+  stream._dropping = count - keep;
+  stream._readsLeft = (first > 0) + (keep > first) + (count > keep);
+  stream._readFailed = false;
+  Si446x &radio = stream._radio;
+  if (first > 0) radio.readRXAsync(dest, first, onRead, context);
+  if (keep > first) radio.readRXAsync(stream._ring.getStorage(), keep - first, onRead, context);
+  if (count > keep) radio.readRXAsync(0, count - keep, onRead, context);
+}
+
+/**
+ * Called for every read of a drain, and once with FIFO_INFO's outcome if
+ * there was nothing to read. Commits the bytes once the last read is in.
+ * If any part failed, the ring keeps none of them and the drain is tried
+ * again: what is left in the FIFO is still there to read.
+ */
+void Si446xRXStream::onRead(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Si446xRXStream &stream = *(Si446xRXStream *)context;
+  if (!success) stream._readFailed = true;
+  if (stream._readsLeft > 1) {
+    stream._readsLeft--;
+    return;
+  }
+  stream._readsLeft = 0;
+
+  if (stream._readFailed) {
+    stream._counters.drainErrors++;
+    stream._reading = stream._dropping = 0;
+    stream._readFailed = false;
+    if (stream._active) stream._drainAgain = true;
+  }
+  else if (stream._reading + stream._dropping > 0) {
+    stream._ring.commit(stream._reading);
+    stream._counters.bytes += stream._reading;
+    stream._counters.overflows += stream._dropping;
+    stream._counters.drains++;
+    stream._reading = stream._dropping = 0;
+  }
+
+  stream._draining = false;
+  if (stream._drainAgain) {
+    stream._drainAgain = false;
+    stream.requestDrain();
+  }
+}
+
+void Si446xRXStream::handleEvents(Si446x::IRQStatus &status)
+{
+  if (!_active) return;
+
+  if (status.isRXFIFOAlmostFullPending() || status.isPacketRXPending() || status.isCRCErrorPending()) {
+    requestDrain();
+  }
+  if (status.isPacketRXPending()) _counters.frames++;
+  if (status.isCRCErrorPending()) _counters.crcErrors++;
+}
+
+void Si446xRXStream::handleChipEvents(Si446x::IRQStatus &status)
+{
+  if (status.getChipPending() & Si446x::kIntFIFOError) {
+    _counters.fifoErrors++;
+  }
+}
+
+void Si446xRXStream::onEvent(Si446x::IRQStatus &status, void *context)
+{
+  ((Si446xRXStream *)context)->handleEvents(status);
+}
+
+void Si446xRXStream::onChipEvent(Si446x::IRQStatus &status, void *context)
+{
+  ((Si446xRXStream *)context)->handleChipEvents(status);
+}
+
+
+Si446xTXQueue::Si446xTXQueue(Si446x &radio, Si446xRing &ring, uint8_t channel, const Si446xIRQ *irq)
+  : _radio(radio), _ring(ring), _channel(channel), _irq(irq), _onAir(false), _loadedCount(0), _fifoSpace(0),
+    _spaceStale(true), _querying(false), _writing(0), _chained(false), _sentTime(0), _burstStart(0)
+{
+  resetCounters();
+}
+
+void Si446xTXQueue::resetCounters()
+{
+  memset(&_counters, 0, sizeof(_counters));
+}
+
+/**
+ * Queues a packet and, if the radio is idle, starts sending. Fails for
+ * packets longer than the FIFO or when the ring is full.
+ */
+bool Si446xTXQueue::send(const uint8_t *data, uint8_t length)
+{
+  if (length == 0 || length > Si446x::kFIFOSize) return false;
+  if (_ring.space() < 1 + length) {
+    _counters.drops++;
+    return false;
+  }
+  _ring.write(&length, 1);
+  _ring.write(data, length);
+
+  if (!_onAir) {
+    if (_loadedCount == 0) _burstStart = micros();
+    pump();
+  }
+  return true;
+}
+
+void Si446xTXQueue::handleEvents(Si446x::IRQStatus &status)
+{
+  if (status.isPacketSentPending() && _onAir) {
+    _sentTime = _irq ? _irq->getEventTime() : micros();
+    _onAir = false;
+    _chained = true;
+    _counters.packets++;
+
+    // Drop the finished packet's length
+    _loadedCount--;
+    for (uint8_t idx = 0; idx < _loadedCount; idx++) _loaded[idx] = _loaded[idx + 1];
+    _spaceStale = true;
+    pump();
+
+    if (!_onAir) {
+      _counters.activeTime += _sentTime - _burstStart;
+      _chained = false;
+    }
+  }
+  else if (status.isTXFIFOAlmostEmptyPending()) {
+    _spaceStale = true;
+    pump();
+  }
+}
+
+void Si446xTXQueue::onEvent(Si446x::IRQStatus &status, void *context)
+{
+  ((Si446xTXQueue *)context)->handleEvents(status);
+}
+
+uint32_t Si446xTXQueue::getPacketsPerSecond() const
+{
+  if (_counters.activeTime == 0) return 0;
+  return (uint32_t)((uint64_t)_counters.packets * 1000000UL / _counters.activeTime);
+}
+
+uint32_t Si446xTXQueue::getMeanGap() const
+{
+  return (_counters.gapCount > 0) ? _counters.gapSum / _counters.gapCount : 0;
+}
+
+// Starts what is already in the FIFO first, then fills the FIFO behind it
+void Si446xTXQueue::pump()
+{
+  if (!_onAir && _loadedCount == 0) load();
+  if (!_onAir && _loadedCount > 0) start();
+  while (_loadedCount < kMaxLoaded && load()) {}
+}
+
+/**
+ * Queues the FIFO write of the next packet if it fits. The FIFO space is
+ * tracked while packets are written; when the next one does not fit, the
+ * radio is asked again, once per event that may have freed some, and
+ * onFIFOInfo() carries on.
+ */
+bool Si446xTXQueue::load()
+{
+  uint16_t run;
+  const uint8_t *header = _ring.readRun(run, _writing);
+  if (run == 0) return false;
+  uint8_t length = header[0];
+
+  if (_fifoSpace < length) {
+    requestSpace();
+    return false;
+  }
+
+  // The packet may wrap around the end of the ring
+  uint8_t done = 0;
+  while (done < length) {
+    const uint8_t *data = _ring.readRun(run, _writing + 1 + done);
+    if (run > length - done) run = length - done;
+    done += run;
+    _radio.writeTXAsync(data, run, (done == length) ? onWritten : 0, this);
+  }
+  _writing += 1 + length;
+
+  if (_onAir) _counters.preloaded++;
+  _fifoSpace -= length;
+  _loaded[_loadedCount++] = length;
+  return true;
+}
+
+void Si446xTXQueue::requestSpace()
+{
+  if (_querying || !_spaceStale) return;
+  _querying = true;
+  _spaceStale = false;
+  _radio.getFIFOInfoAsync(_fifoInfo, onFIFOInfo, this);
+}
+
+// Nothing was written since the request, so the reply is the space left
+void Si446xTXQueue::onFIFOInfo(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Si446xTXQueue &queue = *(Si446xTXQueue *)context;
+  queue._querying = false;
+  if (success) queue._fifoSpace = queue._fifoInfo.getTXSpace();
+  else queue._spaceStale = true;
+  queue.pump();
+}
+
+// The oldest packet still in the ring is the one whose write just went out
+void Si446xTXQueue::onWritten(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Si446xTXQueue &queue = *(Si446xTXQueue *)context;
+  uint16_t run;
+  uint16_t size = 1 + queue._ring.readRun(run)[0];
+  queue._ring.consume(size);
+  queue._writing -= size;
+}
+
+void Si446xTXQueue::start()
+{
+  // Stay tuned if another packet is already waiting
+  bool more = (_loadedCount > 1) || (_ring.available() > _writing);
+  _radio.startTXAsync(_channel, _loaded[0], more ? Si446x::kStateTXTune : Si446x::kStateReady,
+    _chained ? onStarted : 0, this);
+  _onAir = true;
+}
+
+// A gap closes when START_TX goes out, which may be after other queued commands
+void Si446xTXQueue::onStarted(Si446x::CommandHandle handle, bool success, void *context)
+{
+  Si446xTXQueue &queue = *(Si446xTXQueue *)context;
+  uint32_t gap = micros() - queue._sentTime;
+  queue._counters.gapSum += gap;
+  if (gap > queue._counters.gapMax) queue._counters.gapMax = gap;
+  queue._counters.gapCount++;
+}
@@ -0,0 +1,248 @@
+#ifndef SI4X6X_STREAM_H_
+#define SI4X6X_STREAM_H_
+
+#include "si4x6x.h"
+#include "si4x6x_irq.h"
+
+/**
+ * Byte ring over caller supplied storage. The size must be a power of two,
+ * at most 32768. Indices run freely and are masked on access, so all of the
+ * storage is usable. One writer and one reader; the writer fills the free
+ * space in place (writeRun/commit), the reader may do the same from the
+ * other end (readRun/consume) or copy out with read().
+ */
+class Si446xRing {
+public:
+  Si446xRing(uint8_t *storage, uint16_t size)
+    : _storage(storage), _mask(size - 1), _head(0), _tail(0) {}
+
+  uint16_t getSize() const { return _mask + 1; }
+  uint16_t available() const { return _head - _tail; }
+  uint16_t space() const { return getSize() - available(); }
+  void clear() { _tail = _head; }
+
+  uint8_t *getStorage() { return _storage; }
+
+  // Contiguous free space at the write end
+  uint8_t *writeRun(uint16_t &length) {
+    uint16_t pos = _head & _mask;
+    uint16_t free = space();
+    length = (free < getSize() - pos) ? free : getSize() - pos;
+    return _storage + pos;
+  }
+
+  void commit(uint16_t length) { _head += length; }
+
+  // Contiguous readable bytes at the read end, or skip bytes past it
+  const uint8_t *readRun(uint16_t &length, uint16_t skip = 0) const {
+    uint16_t pos = (_tail + skip) & _mask;
+    uint16_t used = available() - skip;
+    length = (used < getSize() - pos) ? used : getSize() - pos;
+    return _storage + pos;
+  }
+
+  void consume(uint16_t length) { _tail += length; }
+
+  uint16_t read(uint8_t *data, uint16_t length);
+  uint16_t write(const uint8_t *data, uint16_t length);
+
+private:
+  uint8_t   *_storage;
+  uint16_t  _mask;
+  volatile uint16_t _head;
+  volatile uint16_t _tail;
+};
+
+/**
+ * Sends one packet longer than the 64 byte TX FIFO. begin() preloads the
+ * FIFO and starts TX with the full length; every TX FIFO almost empty
+ * event then tops the FIFO up from the caller's buffer until all of it
+ * has been queued. Top-ups go through the radio's command queue, so the
+ * handler never waits for CTS. The buffer must stay valid until isBusy()
+ * goes false.
+ *
+ * Events come from Si446xIRQ: register onEvent() as the packet handler and
+ * enable kIntPacketSent and kIntTXFIFOAlmostEmpty. Underruns are the
+ * chip's TX FIFO underflows: to count them and FIFO errors, also register
+ * onChipEvent() and enable the chip kIntFIFOError.
+ */
+class Si446xTXStream {
+public:
+  struct Counters {
+    uint32_t  packets;      // completed packets
+    uint32_t  refills;      // FIFO top-ups after the preload
+    uint32_t  underruns;    // packets that saw a TX FIFO underflow
+    uint32_t  fifoErrors;   // chip FIFO underflow/overflow events
+  };
+
+  Si446xTXStream(Si446x &radio, uint8_t threshold = 48);
+
+  bool begin(const uint8_t *data, uint16_t length, uint8_t channel = 0);
+  bool isBusy() const { return _busy || _refilling; }
+
+  void handleEvents(Si446x::IRQStatus &status);
+  void handleChipEvents(Si446x::IRQStatus &status);
+  static void onEvent(Si446x::IRQStatus &status, void *context);
+  static void onChipEvent(Si446x::IRQStatus &status, void *context);
+
+  const Counters &getCounters() const { return _counters; }
+  void resetCounters();
+
+private:
+  void refill();
+  static void onFIFOInfo(Si446x::CommandHandle handle, bool success, void *context);
+
+  Si446x    &_radio;
+  uint8_t   _threshold;
+
+  const uint8_t *_data;
+  uint16_t  _length;
+  uint16_t  _queued;
+  bool      _busy;
+  bool      _underrun;
+  bool      _refilling;     // FIFO_INFO for a top-up in flight
+
+  Si446x::FIFOInfo  _fifoInfo;
+  Counters  _counters;
+};
+
+/**
+ * Receives into a Si446xRing. Every RX FIFO almost full event drains the
+ * FIFO straight into the ring's free space, so frames longer than the 64
+ * byte FIFO can be taken at full data rate as long as service() keeps up.
+ * Bytes that find the ring full are read out and dropped, and counted as
+ * overflows. The handler only queues the drain: FIFO_INFO, then a FIFO
+ * read per half of the free space, and the bytes show up in the ring when
+ * the reads are done. A drain with a failed command keeps none of its
+ * bytes and is queued again. drain() does the same in one go, waiting for
+ * CTS.
+ *
+ * Register onEvent() as the Si446xIRQ packet handler and enable
+ * kIntRXFIFOAlmostFull and kIntPacketRX (kIntCRCError too if the packet
+ * handler checks CRC). onChipEvent() counts chip FIFO errors, i.e. bytes
+ * the radio lost because the FIFO was not drained in time.
+ */
+class Si446xRXStream {
+public:
+  struct Counters {
+    uint32_t  frames;       // PACKET_RX events
+    uint32_t  crcErrors;    // CRC_ERROR events
+    uint32_t  bytes;        // bytes stored in the ring
+    uint32_t  drains;       // FIFO reads
+    uint32_t  overflows;    // bytes dropped because the ring was full
+    uint32_t  fifoErrors;   // chip FIFO underflow/overflow events
+    uint32_t  drainErrors;  // queued drains with a failed command, tried again
+  };
+
+  Si446xRXStream(Si446x &radio, Si446xRing &ring, uint8_t threshold = 48);
+
+  void begin(uint8_t channel = 0, uint16_t length = 0);
+  void end();
+  bool isActive() const { return _active; }
+
+  void drain();
+
+  void handleEvents(Si446x::IRQStatus &status);
+  void handleChipEvents(Si446x::IRQStatus &status);
+  static void onEvent(Si446x::IRQStatus &status, void *context);
+  static void onChipEvent(Si446x::IRQStatus &status, void *context);
+
+  const Counters &getCounters() const { return _counters; }
+  void resetCounters();
+
+private:
+  void requestDrain();
+  static void onFIFOInfo(Si446x::CommandHandle handle, bool success, void *context);
+  static void onRead(Si446x::CommandHandle handle, bool success, void *context);
+
+  Si446x      &_radio;
+  Si446xRing  &_ring;
+  uint8_t     _threshold;
+  bool        _active;
+
+  bool        _draining;      // queued drain in flight
+  bool        _drainAgain;    // event seen meanwhile
+  bool        _readFailed;    // a command of this drain failed
+  uint8_t     _reading;       // bytes on their way into the ring
+  uint8_t     _dropping;      // and read out for lack of room
+  uint8_t     _readsLeft;     // reads of this drain not yet called back
+
+  Si446x::FIFOInfo  _fifoInfo;
+  Counters    _counters;
+};
+
+/**
+ * Back-to-back transmission of queued packets of up to 64 bytes. While one
+ * packet is on air the following ones are written into the free part of
+ * the TX FIFO, and on PACKET_SENT the next START_TX goes out right away.
+ * Packets with more queued behind them end in TX_TUNE rather than READY,
+ * so the synthesizer stays locked and the gap between frames is the
+ * event latency plus one START_TX.
+ *
+ * Packets are copied into a caller supplied Si446xRing (one length byte
+ * plus the data each) and stay there until their FIFO write has gone out:
+ * FIFO space, writes and START_TX are all queued on the radio, so neither
+ * send() nor the handler waits for CTS. Register onEvent() as the
+ * Si446xIRQ packet handler and enable kIntPacketSent and
+ * kIntTXFIFOAlmostEmpty. Given the Si446xIRQ, gaps are measured from the
+ * PACKET_SENT nIRQ edge instead of from its dispatch.
+ */
+class Si446xTXQueue {
+public:
+  struct Counters {
+    uint32_t  packets;      // PACKET_SENT events
+    uint32_t  preloaded;    // packets written while another was on air
+    uint32_t  drops;        // send() calls refused for lack of ring space
+    uint32_t  gapSum;       // PACKET_SENT to next START_TX, us
+    uint32_t  gapMax;
+    uint32_t  gapCount;
+    uint32_t  activeTime;   // first START_TX to last PACKET_SENT of each burst, us
+  };
+
+  Si446xTXQueue(Si446x &radio, Si446xRing &ring, uint8_t channel = 0, const Si446xIRQ *irq = 0);
+
+  bool send(const uint8_t *data, uint8_t length);
+  bool isIdle() const { return !_onAir && _loadedCount == 0 && _ring.available() == 0; }
+
+  void handleEvents(Si446x::IRQStatus &status);
+  static void onEvent(Si446x::IRQStatus &status, void *context);
+
+  const Counters &getCounters() const { return _counters; }
+  void resetCounters();
+  uint32_t getPacketsPerSecond() const;
+  uint32_t getMeanGap() const;
+
+private:
+  enum { kMaxLoaded = 4 };
+
+  void pump();
+  bool load();
+  void start();
+  void requestSpace();
+  static void onFIFOInfo(Si446x::CommandHandle handle, bool success, void *context);
+  static void onWritten(Si446x::CommandHandle handle, bool success, void *context);
+  static void onStarted(Si446x::CommandHandle handle, bool success, void *context);
+
+  Si446x      &_radio;
+  Si446xRing  &_ring;
+  uint8_t     _channel;
+  const Si446xIRQ *_irq;
+
+  bool        _onAir;
+  uint8_t     _loaded[kMaxLoaded];    // lengths of the packets in the FIFO
+  uint8_t     _loadedCount;
+  uint8_t     _fifoSpace;     // at least this much, less what was written since
+  bool        _spaceStale;    // an event freed FIFO space since it was asked for
+  bool        _querying;      // FIFO_INFO in flight
+  uint16_t    _writing;       // ring bytes of packets whose writes are queued
+
+  Si446x::FIFOInfo  _fifoInfo;
+
+  bool        _chained;       // PACKET_SENT seen, next START_TX closes a gap
+  uint32_t    _sentTime;
+  uint32_t    _burstStart;
+
+  Counters    _counters;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "si4x6x_trace.h"
+
+
+SPITrace::SPITrace(uint8_t *buffer, uint16_t size)
+  : _buffer(buffer), _size(size)
+{
+  clear();
+}
+
+
+void SPITrace::clear()
+{
+  _head = 0;
+  _length = 0;
+  _frame = kNone;
+  _open = kNone;
+  _truncating = false;
+  memset(&_counters, 0, sizeof(_counters));
+}
+
+
+void SPITrace::put(uint8_t x)
+{
+  _buffer[index(_length)] = x;
+  _length++;
+}
+
+
+/**
+ * Makes room for up to n more bytes by dropping the oldest frames, but
+ * never the open one. Returns the room there is, at most n.
+ */
+uint16_t SPITrace::reserve(uint16_t n)
+{
+  while (_size - _length < n && _length > 0 && _head != _frame) {
+    dropFrame();
+  }
+  uint16_t room = _size - _length;
+  return (room < n) ? room : n;
+}
+
+
+void SPITrace::dropFrame()
+{
+  uint16_t pos = 0;
+  do {
+    uint8_t tag = _buffer[index(pos)];
+    switch (tag) {
+      case kSelect:   pos += 6; break;
+      case kRelease:  pos += 3; break;
+      default:        pos += 2 + _buffer[index(pos + 1)]; break;
+    }
+  } while (pos < _length && _buffer[index(pos)] != kSelect);
+
+  _head = index(pos);
+  _length -= pos;
+  _counters.dropped++;
+}
+
+
+void SPITrace::select(uint8_t pinCS, uint32_t time)
+{
+  _open = kNone;
+  _frame = kNone;
+  _selectTime = time;
+  _truncating = (reserve(6) < 6);
+  if (_truncating) return;
+
+  _frame = index(_length);
+  put(kSelect);
+  put(pinCS);
+  for (uint8_t idx = 0; idx < 4; idx++) put(time >> (8 * idx));
+  _counters.frames++;
+}
+
+
+/**
+ * Appends bus bytes to the open frame, extending its last record if it has
+ * the same direction. data is in program memory if progmem is set.
+ */
+void SPITrace::record(uint8_t tag, const uint8_t *data, size_t n, bool progmem)
+{
+  while (n > 0 && !_truncating) {
+    if (_open == kNone || _openTag != tag || _buffer[_open] == 0xFF) {
+      if (reserve(3) < 3) break;
+      put(tag);
+      _open = index(_length);
+      _openTag = tag;
+      put(0);
+    }
+
+    uint8_t room = 0xFF - _buffer[_open];
+    uint16_t chunk = reserve((n < room) ? n : room);
+    if (chunk == 0) break;
+    for (uint16_t idx = 0; idx < chunk; idx++) {
+      if (!data) put(0xFF);
+      else put(progmem ? pgm_read_byte(data + idx) : data[idx]);
+    }
+    _buffer[_open] += chunk;
+    if (data) data += chunk;
+    n -= chunk;
+  }
+
+  if (n > 0) {
+    _truncating = true;
+    _counters.truncated += n;
+  }
+}
+
+
+void SPITrace::release(uint32_t time)
+{
+  uint32_t duration = time - _selectTime;
+  if (duration > 0xFFFF) duration = 0xFFFF;
+
+  _open = kNone;
+  if (_frame != kNone && reserve(3) == 3) {
+    put(kRelease);
+    put(duration);
+    put(duration >> 8);
+  }
+  _frame = kNone;
+  _truncating = false;
+}
+
+
+uint16_t SPITrace::read(uint16_t offset, uint8_t *data, uint16_t length) const
+{
+  if (offset >= _length) return 0;
+  if (length > _length - offset) length = _length - offset;
+  for (uint16_t idx = 0; idx < length; idx++) {
+    data[idx] = _buffer[index(offset + idx)];
+  }
+  return length;
+}
@@ -0,0 +1,72 @@
+#ifndef SI4X6X_TRACE_H_
+#define SI4X6X_TRACE_H_
+
+#include "Arduino.h"
+
+/**
+ * Log of SPI traffic, one CS frame at a time, kept in a byte ring over
+ * caller supplied storage. SPIDevice feeds it when built with SI446X_TRACE
+ * and given one with setTrace(). When the ring is full the oldest frames
+ * are dropped whole, so what is left always starts at a frame.
+ *
+ * Records, multi-byte fields little endian:
+ *   kSelect   pin, micros() at CS low (4 bytes)
+ *   kOut      length, bytes the host sent
+ *   kIn       length, bytes the device answered while the host sent filler
+ *   kRelease  microseconds CS was low (2 bytes, saturating)
+ * A frame is a kSelect, its kOut/kIn records in bus order and a kRelease.
+ */
+class SPITrace {
+public:
+  enum Tag {
+    kSelect   = 0x01,
+    kOut      = 0x02,
+    kIn       = 0x03,
+    kRelease  = 0x04
+  };
+
+  struct Counters {
+    uint32_t  frames;       // frames recorded
+    uint32_t  dropped;      // oldest frames overwritten
+    uint32_t  truncated;    // data bytes lost because one frame filled the ring
+  };
+
+  SPITrace(uint8_t *buffer, uint16_t size);
+
+  void clear();
+
+  void select(uint8_t pinCS, uint32_t time);
+  // A null data records n filler bytes (0xFF)
+  void record(uint8_t tag, const uint8_t *data, size_t n, bool progmem = false);
+  void release(uint32_t time);
+
+  // Bytes held, read back oldest first from offset
+  uint16_t getLength() const { return _length; }
+  uint16_t read(uint16_t offset, uint8_t *data, uint16_t length) const;
+
+  const Counters &getCounters() const { return _counters; }
+
+private:
+  enum { kNone = 0xFFFF };
+
+  uint16_t index(uint16_t offset) const {
+    return (uint16_t)(((uint32_t)_head + offset) % _size);
+  }
+
+  uint16_t reserve(uint16_t n);
+  void dropFrame();
+  void put(uint8_t x);
+
+  uint8_t   *_buffer;
+  uint16_t  _size;
+  uint16_t  _head;          // index of the oldest byte
+  uint16_t  _length;
+  uint16_t  _frame;         // index of the open frame's kSelect
+  uint16_t  _open;          // index of the length byte of the last data record
+  uint8_t   _openTag;
+  bool      _truncating;
+  uint32_t  _selectTime;
+  Counters  _counters;
+};
+
+#endif